@@ -0,0 +1,176 @@
+#include "Bench.hpp"
+
+#include "ECS/Backtrack.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <sstream>
+
+namespace Bench
+{
+    namespace
+    {
+        std::atomic<uint64_t> sink(0);
+
+        struct Result
+        {
+            std::string name;
+            std::size_t ops;
+            int64_t min;
+            int64_t median;
+            double mean;
+        };
+
+        void writeJson(std::ostream& os, const Config& config, const std::vector<Result>& results)
+        {
+            os << "{\"suite\":\"archetype_bench\",\"format\":1,\"config\":{"
+               << "\"entities\":" << config.entities
+               << ",\"repetitions\":" << config.repetitions
+               << ",\"seed\":" << config.seed
+#ifdef ARCHETYPE_DEBUG
+               << ",\"debug\":true"
+#else
+               << ",\"debug\":false"
+#endif
+#ifdef ARCHETYPE_CHECKED
+               << ",\"checked\":true"
+#else
+               << ",\"checked\":false"
+#endif
+#ifdef ARCHETYPE_PROFILE
+               << ",\"profile\":true"
+#else
+               << ",\"profile\":false"
+#endif
+               << "},\"results\":[";
+            for (std::size_t i = 0; i < results.size(); ++i)
+            {
+                const Result& r = results[i];
+                os << (i == 0 ? "\n" : ",\n")
+                   << "{\"name\":\"" << r.name << "\",\"ops\":" << r.ops
+                   << ",\"min_ns\":" << r.min << ",\"median_ns\":" << r.median
+                   << ",\"mean_ns\":" << (int64_t)r.mean
+                   << ",\"ns_per_op\":" << (r.ops == 0 ? 0.0 : (double)r.median / r.ops) << '}';
+            }
+            os << "\n]}\n";
+        }
+
+        void writeCsv(std::ostream& os, const std::vector<Result>& results)
+        {
+            os << "name,ops,min_ns,median_ns,mean_ns,ns_per_op\n";
+            for (const Result& r : results)
+                os << r.name << ',' << r.ops << ',' << r.min << ',' << r.median << ','
+                   << (int64_t)r.mean << ',' << (r.ops == 0 ? 0.0 : (double)r.median / r.ops) << '\n';
+        }
+    }
+
+    void Timer::start()
+    {
+        mStart = Clock::now();
+    }
+
+    void Timer::stop()
+    {
+        mElapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStart).count();
+    }
+
+    int64_t Timer::getElapsed() const
+    {
+        return mElapsed;
+    }
+
+    void Suite::add(const std::string& name, Case benchCase)
+    {
+        mCases.push_back({ name, std::move(benchCase) });
+    }
+
+    void Suite::addCheck(const std::string& name, Check check)
+    {
+        mChecks.push_back({ name, std::move(check) });
+    }
+
+    std::size_t Suite::run(const Config& config, std::ostream& os) const
+    {
+        std::vector<Result> results;
+        for (const Entry& entry : mCases)
+        {
+            if (entry.name.find(config.filter) == std::string::npos)
+                continue;
+
+            std::vector<int64_t> samples;
+            std::size_t ops = 0;
+            for (std::size_t rep = 0; rep < std::max<std::size_t>(config.repetitions, 1); ++rep)
+            {
+                Timer timer;
+                ops = entry.benchCase(config, timer);
+                samples.push_back(timer.getElapsed());
+            }
+
+            std::sort(samples.begin(), samples.end());
+            double mean = (double)std::accumulate(samples.begin(), samples.end(), (int64_t)0) / samples.size();
+            results.push_back({ entry.name, ops, samples.front(), samples[samples.size() / 2], mean });
+        }
+
+        if (config.csv)
+            writeCsv(os, results);
+        else
+            writeJson(os, config, results);
+        return results.size();
+    }
+
+    std::size_t Suite::verify(const Config& config, std::ostream& os, std::size_t& failed) const
+    {
+        std::size_t res = 0;
+        failed = 0;
+        for (const CheckEntry& entry : mChecks)
+        {
+            if (entry.name.find(config.filter) == std::string::npos)
+                continue;
+
+            ++res;
+            std::ostringstream log;
+            bool passed = entry.check(config, log);
+            os << (passed ? "PASS " : "FAIL ") << entry.name << '\n' << log.str();
+            if (passed == false)
+                ++failed;
+        }
+        os << failed << " of " << res << " checks failed\n";
+        return res;
+    }
+
+    void doNotOptimize(uint64_t value)
+    {
+        sink.fetch_add(value, std::memory_order_relaxed);
+    }
+
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+    FailedChecks::FailedChecks()
+        : mStart(ECS::getCheckFailureCount())
+    {
+        ECS::setCheckHandler([](const std::string&, const char*, const char*, int) { });
+    }
+
+    FailedChecks::~FailedChecks()
+    {
+        ECS::setCheckHandler(nullptr);
+    }
+
+    uint64_t FailedChecks::getCount() const
+    {
+        return ECS::getCheckFailureCount() - mStart;
+    }
+#else
+    FailedChecks::FailedChecks()
+        : mStart(0)
+    { }
+
+    FailedChecks::~FailedChecks()
+    { }
+
+    uint64_t FailedChecks::getCount() const
+    {
+        return mStart;
+    }
+#endif
+}
@@ -0,0 +1,101 @@
+#ifndef ARCHETYPE_BENCH_BENCH_HPP
+#define ARCHETYPE_BENCH_BENCH_HPP
+
+/*
+* Minimal benchmark harness for archetype_bench.
+* Every case builds its own world, times its body
+* and reports how many operations the body did.
+* Results are written as JSON (default) or CSV so
+* runs can be compared over time. Checks build
+* worlds as well but only tell whether the engine
+* produced the expected state (see --verify).
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+    struct Config
+    {
+        std::size_t entities = 10000;
+        std::size_t repetitions = 5;
+        // Every case seeds its own generator from this value
+        uint32_t seed = 20240601;
+        // Only run cases whose name contains this string
+        std::string filter;
+        bool csv = false;
+        // Run the checks instead of the timed cases
+        bool verify = false;
+    };
+
+    // Measure the timed part of a case, may be started and stopped several times
+    class Timer
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void start();
+        void stop();
+        int64_t getElapsed() const;
+    private:
+        Clock::time_point mStart;
+        int64_t mElapsed = 0;
+    };
+
+    // Returns number of operations done while the timer was running
+    using Case = std::function<std::size_t(const Config& config, Timer& timer)>;
+    // Returns false if the engine misbehaved, explaining why in log
+    using Check = std::function<bool(const Config& config, std::ostream& log)>;
+
+    class Suite
+    {
+    public:
+        void add(const std::string& name, Case benchCase);
+        void addCheck(const std::string& name, Check check);
+        // Returns number of cases run
+        std::size_t run(const Config& config, std::ostream& os) const;
+        // Returns number of checks run, failed is set to the number of them that failed
+        std::size_t verify(const Config& config, std::ostream& os, std::size_t& failed) const;
+    private:
+        struct Entry
+        {
+            std::string name;
+            Case benchCase;
+        };
+        struct CheckEntry
+        {
+            std::string name;
+            Check check;
+        };
+        std::vector<Entry> mCases;
+        std::vector<CheckEntry> mChecks;
+    };
+
+    // Keep the compiler from dropping computations whose result is unused
+    void doNotOptimize(uint64_t value);
+
+    // Count the engine's failed checks during its lifetime, without the default report or
+    // exit, so checks may misuse the engine on purpose. Always 0 in release builds
+    class FailedChecks
+    {
+    public:
+        FailedChecks();
+        ~FailedChecks();
+        FailedChecks(const FailedChecks&) = delete;
+        FailedChecks& operator = (const FailedChecks&) = delete;
+        uint64_t getCount() const;
+    private:
+        uint64_t mStart;
+    };
+
+    // Registration of each benchmark group
+    void registerEntityBenchmarks(Suite& suite);
+    void registerIterationBenchmarks(Suite& suite);
+}
+
+#endif // ARCHETYPE_BENCH_BENCH_HPP
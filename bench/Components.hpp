@@ -0,0 +1,106 @@
+#ifndef ARCHETYPE_BENCH_COMPONENTS_HPP
+#define ARCHETYPE_BENCH_COMPONENTS_HPP
+
+/*
+* Component types shared by benchmark cases
+*/
+
+#include "ECS/Engine.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace Bench
+{
+    struct Position
+    {
+        float x, y, z;
+    };
+
+    struct Velocity
+    {
+        float x, y, z;
+    };
+
+    struct Health
+    {
+        float value;
+    };
+
+    struct NetworkId
+    {
+        uint32_t value;
+    };
+
+    // Component owning a heap allocation, costly to copy
+    struct Buffer
+    {
+        Buffer() = default;
+        explicit Buffer(std::size_t size)
+            : values(size, 0.f)
+        { }
+
+        std::vector<float> values;
+    };
+
+    // Empty-ish components used to split entities into many archetypes
+    template <int N>
+    struct Tag
+    {
+        uint8_t value;
+    };
+
+    constexpr int TAG_COUNT = 6;
+
+    // Engine is too large for the stack
+    inline std::unique_ptr<ECS::Engine> makeEngine()
+    {
+        auto engine = std::make_unique<ECS::Engine>();
+        engine->registerComponent<Position>();
+        engine->registerComponent<Velocity>();
+        engine->registerComponent<Health>();
+        engine->registerComponent<NetworkId>();
+        engine->registerComponent<Buffer>();
+        engine->registerComponent<Tag<0>>();
+        engine->registerComponent<Tag<1>>();
+        engine->registerComponent<Tag<2>>();
+        engine->registerComponent<Tag<3>>();
+        engine->registerComponent<Tag<4>>();
+        engine->registerComponent<Tag<5>>();
+        return engine;
+    }
+
+    // Add the tags whose bits are set in mask
+    inline void addTags(ECS::Engine& engine, ECS::Entity entity, uint32_t mask)
+    {
+        if (mask & 1u) engine.addComponent(entity, Tag<0>{ 0 });
+        if (mask & 2u) engine.addComponent(entity, Tag<1>{ 0 });
+        if (mask & 4u) engine.addComponent(entity, Tag<2>{ 0 });
+        if (mask & 8u) engine.addComponent(entity, Tag<3>{ 0 });
+        if (mask & 16u) engine.addComponent(entity, Tag<4>{ 0 });
+        if (mask & 32u) engine.addComponent(entity, Tag<5>{ 0 });
+    }
+
+    // Entities with Position and Velocity, optionally spread over 2^TAG_COUNT archetypes
+    inline std::vector<ECS::Entity> populate(ECS::Engine& engine, std::size_t count, std::mt19937& rng, bool fragmented)
+    {
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        std::uniform_int_distribution<uint32_t> tags(0, (1u << TAG_COUNT) - 1);
+        std::vector<ECS::Entity> res;
+        res.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ECS::Entity e = engine.createEntity();
+            engine.addComponent(e, Position{ dist(rng), dist(rng), dist(rng) });
+            engine.addComponent(e, Velocity{ dist(rng), dist(rng), dist(rng) });
+            if (fragmented)
+                addTags(engine, e, tags(rng));
+            res.push_back(e);
+        }
+        return res;
+    }
+}
+
+#endif // ARCHETYPE_BENCH_COMPONENTS_HPP
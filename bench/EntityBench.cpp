@@ -0,0 +1,1077 @@
+#include "Bench.hpp"
+#include "Components.hpp"
+
+#include "ECS/CommandBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace Bench
+{
+    namespace
+    {
+        std::size_t createDestroy(const Config& config, Timer& timer)
+        {
+            auto engine = makeEngine();
+            std::vector<ECS::Entity> entities(config.entities);
+
+            timer.start();
+            for (auto& e : entities)
+                e = engine->createEntity();
+            for (auto e : entities)
+                engine->destroyEntity(e);
+            timer.stop();
+            return config.entities * 2;
+        }
+
+        std::size_t createDestroyWithComponents(const Config& config, Timer& timer)
+        {
+            auto engine = makeEngine();
+            std::vector<ECS::Entity> entities(config.entities);
+
+            timer.start();
+            for (auto& e : entities)
+            {
+                e = engine->createEntity();
+                engine->addComponent(e, Position{ 0.f, 0.f, 0.f });
+                engine->addComponent(e, Velocity{ 1.f, 1.f, 1.f });
+            }
+            for (auto e : entities)
+                engine->destroyEntity(e);
+            timer.stop();
+            return config.entities * 2;
+        }
+
+        // Creation alone, with the final archetype's storage reserved beforehand or grown
+        // as entities join it
+        std::size_t spawnWithComponents(const Config& config, bool reserve, Timer& timer)
+        {
+            auto engine = makeEngine();
+            if (reserve)
+                engine->reserve<Position, Velocity>(config.entities);
+
+            timer.start();
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, Position{ 0.f, 0.f, 0.f });
+                engine->addComponent(e, Velocity{ 1.f, 1.f, 1.f });
+            }
+            timer.stop();
+            return config.entities;
+        }
+
+        // Put 9 in 10 entities to sleep with their columns compressed and wake them again
+        // Woken components must be the ones put to sleep, otherwise the case reports 0 ops
+        std::size_t sleepWakeCompressed(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            std::uniform_real_distribution<float> dist(-100.f, 100.f);
+            auto engine = makeEngine();
+            std::vector<ECS::Entity> sleepers;
+            std::vector<Position> positions;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                Position p{ dist(rng), 0.f, dist(rng) };
+                engine->addComponent(e, p);
+                engine->addComponent(e, Velocity{ 1.f, 0.f, 0.f });
+                if (i % 10 == 0)
+                    continue;
+                sleepers.push_back(e);
+                positions.push_back(p);
+            }
+
+            timer.start();
+            engine->sleepEntities(sleepers, true);
+            engine->wakeEntities(sleepers);
+            timer.stop();
+
+            for (std::size_t i = 0; i < sleepers.size(); ++i)
+            {
+                const Position& p = engine->getComponent<Position>(sleepers[i]);
+                if (p.x != positions[i].x || p.y != positions[i].y || p.z != positions[i].z)
+                    return 0;
+            }
+            return sleepers.size() * 2;
+        }
+
+        // Woken components must be the ones put to sleep with their columns compressed
+        bool checkSleepWake(const Config& config, std::ostream& log)
+        {
+            std::mt19937 rng(config.seed);
+            std::uniform_real_distribution<float> dist(-100.f, 100.f);
+            auto engine = makeEngine();
+            std::vector<ECS::Entity> entities;
+            std::vector<Position> positions;
+            std::vector<Velocity> velocities;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                positions.push_back(Position{ dist(rng), dist(rng), dist(rng) });
+                velocities.push_back(Velocity{ dist(rng), dist(rng), dist(rng) });
+                engine->addComponent(e, positions.back());
+                engine->addComponent(e, velocities.back());
+                entities.push_back(e);
+            }
+
+            engine->sleepEntities(entities, true);
+            engine->wakeEntities(entities);
+            for (std::size_t i = 0; i < entities.size(); ++i)
+            {
+                if (std::memcmp(&engine->getComponent<Position>(entities[i]), &positions[i], sizeof(Position)) == 0
+                    && std::memcmp(&engine->getComponent<Velocity>(entities[i]), &velocities[i], sizeof(Velocity)) == 0)
+                    continue;
+                log << "  entity " << entities[i] << " woke with other components\n";
+                return false;
+            }
+            return true;
+        }
+
+        // Sleepers are edited while their archetypes are packed: Velocity is removed or added,
+        // which moves them into another packed archetype, Health is added and some are
+        // destroyed. Once woken every survivor must hold its own components and no check
+        // may have failed
+        bool checkPackedSleepers(const Config& config, std::ostream& log)
+        {
+            struct Expected
+            {
+                bool alive = true;
+                bool velocity = false;
+                bool health = false;
+            };
+            auto engine = makeEngine();
+            std::vector<ECS::Entity> entities;
+            std::vector<Expected> expected(config.entities);
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, Position{ (float)i, 1.f, 2.f });
+                expected[i].velocity = i % 2 == 0;
+                if (expected[i].velocity)
+                    engine->addComponent(e, Velocity{ (float)i, 0.f, 0.f });
+                entities.push_back(e);
+            }
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            uint64_t failures = ECS::getCheckFailureCount();
+#endif
+
+            auto toggleVelocity = [&](std::size_t i)
+            {
+                if (expected[i].velocity)
+                    engine->removeComponent<Velocity>(entities[i]);
+                else
+                    engine->addComponent(entities[i], Velocity{ (float)i, 0.f, 0.f });
+                expected[i].velocity = !expected[i].velocity;
+            };
+            const char* steps[] = { "moving Velocity in and out", "adding Health", "destroying", "moving Velocity again" };
+            for (std::size_t step = 0; step < 4; ++step)
+            {
+                std::vector<ECS::Entity> sleepers;
+                for (std::size_t i = 0; i < entities.size(); ++i)
+                    if (expected[i].alive)
+                        sleepers.push_back(entities[i]);
+                engine->sleepEntities(sleepers, true);
+                for (std::size_t i = 0; i < entities.size(); ++i)
+                {
+                    if (expected[i].alive == false)
+                        continue;
+                    if (step == 0 && i % 4 == 0)
+                        toggleVelocity(i);
+                    else if (step == 1 && i % 5 == 1 && expected[i].health == false)
+                    {
+                        engine->addComponent(entities[i], Health{ (float)i });
+                        expected[i].health = true;
+                    }
+                    else if (step == 2 && i % 7 == 2)
+                    {
+                        engine->destroyEntity(entities[i]);
+                        expected[i].alive = false;
+                    }
+                    else if (step == 3 && i % 3 == 0)
+                        toggleVelocity(i);
+                }
+                sleepers.clear();
+                for (std::size_t i = 0; i < entities.size(); ++i)
+                    if (expected[i].alive)
+                        sleepers.push_back(entities[i]);
+                engine->wakeEntities(sleepers);
+
+                for (std::size_t i = 0; i < entities.size(); ++i)
+                {
+                    ECS::Entity e = entities[i];
+                    if (expected[i].alive == false)
+                        continue;
+                    const Position& pos = engine->getComponent<Position>(e);
+                    bool res = pos.x == (float)i && pos.y == 1.f && pos.z == 2.f
+                        && engine->haveComponent<Velocity>(e) == expected[i].velocity
+                        && (expected[i].velocity == false || engine->getComponent<Velocity>(e).x == (float)i)
+                        && engine->haveComponent<Health>(e) == expected[i].health
+                        && (expected[i].health == false || engine->getComponent<Health>(e).value == (float)i);
+                    if (res)
+                        continue;
+                    log << "  entity " << e << " woke with other components after " << steps[step] << '\n';
+                    return false;
+                }
+            }
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            if (ECS::getCheckFailureCount() != failures)
+            {
+                log << "  " << ECS::getCheckFailureCount() - failures << " checks failed\n";
+                return false;
+            }
+#endif
+            return true;
+        }
+
+        // Same entities as createDestroyWithComponents, copied from a prefab in one call
+        std::size_t instantiateDestroy(const Config& config, Timer& timer)
+        {
+            auto engine = makeEngine();
+            ECS::Entity prefab = engine->createPrefab();
+            engine->addComponent(prefab, Position{ 0.f, 0.f, 0.f });
+            engine->addComponent(prefab, Velocity{ 1.f, 1.f, 1.f });
+
+            // The prefab itself takes one entity
+            std::size_t count = std::min<std::size_t>(config.entities, ECS::MAX_ENTITY - 1);
+
+            timer.start();
+            auto entities = engine->instantiate(prefab, count);
+            for (auto e : entities)
+                engine->destroyEntity(e);
+            timer.stop();
+            return count * 2;
+        }
+
+        std::size_t addRemoveChurn(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populate(*engine, config.entities, rng, false);
+            std::shuffle(entities.begin(), entities.end(), rng);
+
+            timer.start();
+            for (auto e : entities)
+                engine->addComponent(e, Health{ 1.f });
+            for (auto e : entities)
+                engine->removeComponent<Health>(e);
+            timer.stop();
+            return config.entities * 2;
+        }
+
+        // Components holding 64 floats on the heap are added, carried through an archetype
+        // change and removed, either copied from a prototype or constructed in place
+        std::size_t heapComponentChurn(const Config& config, bool emplace, Timer& timer)
+        {
+            constexpr std::size_t BUFFER_SIZE = 64;
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populate(*engine, config.entities, rng, false);
+            std::shuffle(entities.begin(), entities.end(), rng);
+            const Buffer prototype(BUFFER_SIZE);
+
+            timer.start();
+            for (auto e : entities)
+            {
+                if (emplace)
+                    engine->emplaceComponent<Buffer>(e, BUFFER_SIZE);
+                else
+                    engine->addComponent(e, prototype);
+            }
+            for (auto e : entities)
+                engine->addComponent(e, Health{ 1.f });
+            for (auto e : entities)
+                engine->removeComponent<Buffer>(e);
+            timer.stop();
+            return config.entities * 3;
+        }
+
+        std::size_t randomGetComponent(const Config& config, Timer& timer)
+        {
+            constexpr std::size_t PASSES = 10;
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populate(*engine, config.entities, rng, true);
+            std::shuffle(entities.begin(), entities.end(), rng);
+
+            float sum = 0.f;
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                for (auto e : entities)
+                    sum += engine->getComponent<Position>(e).x;
+            timer.stop();
+            doNotOptimize((uint64_t)sum);
+            return config.entities * PASSES;
+        }
+
+        // Same entities as randomGetComponent, read through one batched call per pass
+        std::size_t randomGetComponentsBatched(const Config& config, Timer& timer)
+        {
+            constexpr std::size_t PASSES = 10;
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populate(*engine, config.entities, rng, true);
+            std::shuffle(entities.begin(), entities.end(), rng);
+
+            float sum = 0.f;
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                engine->getComponents<Position>(entities.data(), entities.size(), [&](ECS::Entity, const Position& pos)
+                {
+                    sum += pos.x;
+                });
+            timer.stop();
+            doNotOptimize((uint64_t)sum);
+            return config.entities * PASSES;
+        }
+
+        // Global state read once per entity, stored as a resource or as a component of a
+        // dummy entity
+        std::size_t globalStateRead(const Config& config, bool resource, Timer& timer)
+        {
+            auto engine = makeEngine();
+            engine->setResource<Health>(Health{ 1.f });
+            ECS::Entity singleton = engine->createEntity();
+            engine->addComponent(singleton, Health{ 1.f });
+
+            float sum = 0.f;
+            timer.start();
+            for (std::size_t i = 0; i < config.entities; ++i)
+                sum += resource ? engine->getResource<Health>().value : engine->getComponent<Health>(singleton).value;
+            timer.stop();
+            doNotOptimize((uint64_t)sum);
+            return config.entities;
+        }
+
+        std::size_t indexLookup(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populate(*engine, config.entities, rng, true);
+            for (std::size_t i = 0; i < entities.size(); ++i)
+                engine->addComponent(entities[i], NetworkId{ (uint32_t)i * 7 });
+            engine->addHashIndex<NetworkId>([](const NetworkId& id) { return id.value; });
+
+            std::vector<uint32_t> keys(config.entities);
+            std::uniform_int_distribution<uint32_t> dist(0, (uint32_t)config.entities - 1);
+            for (auto& key : keys)
+                key = dist(rng) * 7;
+
+            uint64_t sum = 0;
+            timer.start();
+            for (auto key : keys)
+                sum += engine->findEntity<NetworkId>(key);
+            timer.stop();
+            doNotOptimize(sum);
+            return config.entities;
+        }
+
+        struct Level
+        {
+            uint8_t value;
+        };
+
+        // Entities found by the indexes must be those a scan finds, after setComponent(),
+        // removals and destruction. Lookup keys of another type than the index's convert
+        // without changing value (or match nothing), range bounds are clamped to the key
+        // type, and numeric keys never pick a bool index
+        bool checkIndexLookups(const Config& config, std::ostream& log)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            engine->registerComponent<Level>();
+            FailedChecks failed;
+            std::vector<ECS::Entity> entities;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, NetworkId{ (uint32_t)i * 7 });
+                engine->addComponent(e, Level{ (uint8_t)(i % 256) });
+                engine->addComponent(e, Health{ (float)(i % 3) });
+                entities.push_back(e);
+            }
+            engine->addHashIndex<NetworkId>([](const NetworkId& id) { return id.value; });
+            engine->addSortedIndex<Level>([](const Level& level) { return level.value; });
+            engine->addHashIndex<Health>([](const Health& health) { return health.value > 1.5f; });
+            engine->addHashIndex<Health>([](const Health& health) { return (uint32_t)health.value; });
+
+            // Moved to other keys, other archetypes or out of the indexes
+            std::uniform_int_distribution<std::size_t> pick(0, entities.size() - 1);
+            for (std::size_t n = 0; n < entities.size() / 4; ++n)
+            {
+                std::size_t i = pick(rng);
+                if (engine->haveComponent<NetworkId>(entities[i]) == false)
+                    continue;
+                if (n % 4 == 0)
+                    engine->setComponent(entities[i], NetworkId{ (uint32_t)(config.entities + i) * 7 });
+                else if (n % 4 == 1)
+                    engine->setComponent(entities[i], Level{ (uint8_t)(255 - i % 256) });
+                else if (n % 4 == 2 && engine->haveComponent<Velocity>(entities[i]) == false)
+                    engine->addComponent(entities[i], Velocity{ 0.f, 0.f, 0.f });
+                else if (engine->haveComponent<Velocity>(entities[i]) == false)
+                {
+                    engine->removeComponent<NetworkId>(entities[i]);
+                    engine->removeComponent<Level>(entities[i]);
+                    engine->removeComponent<Health>(entities[i]);
+                }
+            }
+            for (std::size_t i = 0; i < entities.size(); i += 13)
+                engine->destroyEntity(entities[i]);
+
+            // What the indexes must answer, from a scan
+            std::vector<std::pair<uint32_t, ECS::Entity>> ids;
+            std::vector<std::pair<uint8_t, ECS::Entity>> levels;
+            std::vector<std::pair<float, ECS::Entity>> healths;
+            for (std::size_t i = 0; i < entities.size(); ++i)
+            {
+                if (i % 13 == 0 || engine->haveComponent<NetworkId>(entities[i]) == false)
+                    continue;
+                ids.emplace_back(engine->getComponent<NetworkId>(entities[i]).value, entities[i]);
+                levels.emplace_back(engine->getComponent<Level>(entities[i]).value, entities[i]);
+                healths.emplace_back(engine->getComponent<Health>(entities[i]).value, entities[i]);
+            }
+            auto levelsIn = [&levels](int low, int high)
+            {
+                std::vector<ECS::Entity> res;
+                for (const auto& pr : levels)
+                    if (pr.first >= low && pr.first <= high)
+                        res.push_back(pr.second);
+                std::sort(res.begin(), res.end());
+                return res;
+            };
+            auto healthsOf = [&healths](float value)
+            {
+                std::vector<ECS::Entity> res;
+                for (const auto& pr : healths)
+                    if (pr.first == value)
+                        res.push_back(pr.second);
+                return res;
+            };
+            auto sorted = [](std::vector<ECS::Entity> entities)
+            {
+                std::sort(entities.begin(), entities.end());
+                return entities;
+            };
+
+            for (const auto& pr : ids)
+                if (engine->findEntity<NetworkId>(pr.first) != pr.second || engine->findEntity<NetworkId>((int)pr.first) != pr.second
+                    || engine->findEntity<NetworkId>((double)pr.first) != pr.second)
+                {
+                    log << "  NetworkId " << pr.first << " not found as uint32_t, int or double\n";
+                    return false;
+                }
+            if (engine->findEntity<NetworkId>(-7) != ECS::NULL_ENTITY || engine->findEntity<NetworkId>(7.5) != ECS::NULL_ENTITY
+                || engine->findEntity<NetworkId>(1e30) != ECS::NULL_ENTITY || engine->findEntity<NetworkId>(std::nan("")) != ECS::NULL_ENTITY)
+            {
+                log << "  NetworkId found by a key uint32_t cannot hold\n";
+                return false;
+            }
+
+            struct Range
+            {
+                double low, high;
+                // Levels expected, bounds clamped to [0, 255] and rounded inward
+                int first, last;
+            };
+            const Range ranges[] = { { 0, 300, 0, 255 }, { -5, 250, 0, 250 }, { 100.5, 200.5, 101, 200 }, { 300, 400, 1, 0 }, { -9, -1, 1, 0 }, { 7, 7, 7, 7 } };
+            for (const Range& range : ranges)
+            {
+                bool same = sorted(engine->findEntitiesInRange<Level>((int)range.low, (int)range.high)) == levelsIn((int)range.low, (int)range.high)
+                    && sorted(engine->findEntitiesInRange<Level>(range.low, range.high)) == levelsIn(range.first, range.last);
+                if (same)
+                    continue;
+                log << "  levels in [" << range.low << ", " << range.high << "] differ from a scan\n";
+                return false;
+            }
+            if (sorted(engine->findEntities<Level>(200)) != levelsIn(200, 200) || engine->findEntities<Level>(456).empty() == false)
+            {
+                log << "  levels equal to 200 or 456 differ from a scan\n";
+                return false;
+            }
+
+            // 0 is a number, not false: the uint32_t index answers it
+            if (sorted(engine->findEntities<Health>(0)) != sorted(healthsOf(0.f)) || sorted(engine->findEntities<Health>(true)) != sorted(healthsOf(2.f)))
+            {
+                log << "  Health lookups by 0 or true used the wrong index\n";
+                return false;
+            }
+            if (failed.getCount() != 0)
+            {
+                log << "  " << failed.getCount() << " checks failed\n";
+                return false;
+            }
+            return true;
+        }
+
+        struct Tint
+        {
+            uint32_t color;
+
+            bool operator == (const Tint& other) const
+            {
+                return color == other.color;
+            }
+        };
+
+        struct TintHash
+        {
+            std::size_t operator()(const Tint& tint) const
+            {
+                return std::hash<uint32_t>()(tint.color);
+            }
+        };
+
+        // Shared values must follow their entities through archetype moves, sorting, prefab
+        // copies, value changes and destruction. forEachSharedGroup() must hand out every row
+        // once, ascending, under its entity's value, and a shared column must cost one
+        // handle per entity
+        bool checkSharedComponents(const Config& config, std::ostream& log)
+        {
+            auto engine = makeEngine();
+            engine->registerSharedComponent<Tint, TintHash>();
+            FailedChecks failed;
+            // [entity] = color of its Tint, entities without one are left out
+            std::unordered_map<ECS::Entity, uint32_t> expected;
+            std::vector<ECS::Entity> entities;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, Position{ (float)(config.entities - i), 0.f, 0.f });
+                engine->addSharedComponent(e, Tint{ (uint32_t)(i % 7) });
+                expected[e] = (uint32_t)(i % 7);
+                entities.push_back(e);
+            }
+            ECS::Entity prefab = engine->createPrefab();
+            engine->addComponent(prefab, Position{ 0.5f, 0.f, 0.f });
+            engine->addSharedComponent(prefab, Tint{ 3 });
+            for (ECS::Entity e : engine->instantiate(prefab, config.entities / 10))
+            {
+                expected[e] = 3;
+                entities.push_back(e);
+            }
+
+            for (std::size_t i = 0; i < entities.size(); ++i)
+            {
+                ECS::Entity e = entities[i];
+                if (i % 5 == 0)
+                {
+                    engine->setSharedComponent(e, Tint{ (uint32_t)(100 + i % 3) });
+                    expected[e] = (uint32_t)(100 + i % 3);
+                }
+                else if (i % 6 == 1)
+                    engine->addComponent(e, Velocity{ 0.f, 0.f, 0.f });
+                else if (i % 11 == 2)
+                {
+                    engine->removeComponent<Tint>(e);
+                    expected.erase(e);
+                }
+                else if (i % 13 == 3)
+                {
+                    engine->destroyEntity(e);
+                    expected.erase(e);
+                }
+            }
+            engine->sortArchetypes<Position>([](const Position& position) { return position.x; });
+
+            for (const auto& pr : expected)
+                if (engine->getSharedComponent<Tint>(pr.first).color != pr.second)
+                {
+                    log << "  entity " << pr.first << " lost its shared value\n";
+                    return false;
+                }
+            std::size_t grouped = 0;
+            for (ECS::Archetype* arch : engine->getArchetypeRefs(engine->generateIdentifier<Tint>()))
+            {
+                bool same = true;
+                const auto& archEntities = arch->getEntities();
+                std::vector<bool> seen(archEntities.size(), false);
+                arch->forEachSharedGroup<Tint>([&](const Tint& tint, const uint32_t* rows, std::size_t count)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        auto found = expected.find(archEntities[rows[i]]);
+                        same = same && (i == 0 || rows[i - 1] < rows[i]) && seen[rows[i]] == false
+                            && found != expected.end() && found->second == tint.color;
+                        seen[rows[i]] = true;
+                    }
+                    grouped += count;
+                });
+                const ECS::IComponentVector& column = *arch->getVectors().at(typeid(Tint).name());
+                if (same == false || column.getByteSize() - column.getWastedBytes() != archEntities.size() * sizeof(uint32_t))
+                {
+                    log << "  groups of an archetype differ from its entities' values, or take more than a handle per entity\n";
+                    return false;
+                }
+            }
+            if (grouped != expected.size())
+            {
+                log << "  " << grouped << " rows grouped for " << expected.size() << " entities with a shared value\n";
+                return false;
+            }
+            if (failed.getCount() != 0)
+            {
+                log << "  " << failed.getCount() << " checks failed\n";
+                return false;
+            }
+            return true;
+        }
+
+        // The depth order must list every related entity once, each after its parent and one
+        // depth below it, after reparenting and destruction of subtrees, which must take the
+        // descendants along. Relationships of dead entities must be refused
+        bool checkHierarchy(const Config& config, std::ostream& log)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            FailedChecks failed;
+            std::vector<ECS::Entity> entities;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                entities.push_back(engine->createEntity());
+                // Parents are older entities, so no cycle can form
+                if (i > 0 && i % 4 != 0)
+                    engine->setParent(entities[i], entities[std::uniform_int_distribution<std::size_t>(0, i - 1)(rng)]);
+            }
+            for (std::size_t i = 5; i < entities.size(); i += 9)
+                engine->setParent(entities[i], entities[i / 3]);
+            for (std::size_t i = 1; i < entities.size(); i += 17)
+                engine->removeParent(entities[i]);
+            // Subtrees of destroyed entities, known before destruction
+            std::unordered_map<ECS::Entity, bool> alive;
+            for (ECS::Entity e : entities)
+                alive[e] = true;
+            std::vector<ECS::Entity> destroyed;
+            for (std::size_t i = 2; i < entities.size(); i += 23)
+            {
+                if (alive[entities[i]] == false)
+                    continue;
+                std::vector<ECS::Entity> subtree(1, entities[i]);
+                for (std::size_t k = 0; k < subtree.size(); ++k)
+                    for (ECS::Entity child : engine->getChildren(subtree[k]))
+                        subtree.push_back(child);
+                for (ECS::Entity e : subtree)
+                {
+                    alive[e] = false;
+                    destroyed.push_back(e);
+                }
+                engine->destroyEntity(entities[i]);
+            }
+            auto& hierarchy = engine->getHierarchy();
+            for (ECS::Entity e : destroyed)
+                if (hierarchy.contain(e))
+                {
+                    log << "  destroyed entity " << e << " is still in the hierarchy\n";
+                    return false;
+                }
+
+            // Refused, they would come back attached with the recycled ID. Release builds
+            // compile the checks out
+            uint64_t expectedFailures = 0;
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            expectedFailures = 2;
+            ECS::Entity root = entities[0];
+            std::size_t children = engine->getChildren(root).size();
+            engine->setParent(destroyed.front(), root);
+            engine->setParent(root, destroyed.front());
+            if (engine->getChildren(root).size() != children || engine->getParent(root) != ECS::NULL_ENTITY
+                || hierarchy.contain(destroyed.front()))
+            {
+                log << "  relationship with a dead entity accepted\n";
+                return false;
+            }
+#endif
+
+            const auto& order = hierarchy.getDepthOrder();
+            const auto& parents = hierarchy.getDepthParents();
+            const auto& offsets = hierarchy.getDepthOffsets();
+            std::size_t related = 0;
+            for (ECS::Entity e : entities)
+                if (alive[e] && (engine->getParent(e) != ECS::NULL_ENTITY || engine->getChildren(e).empty() == false))
+                    related++;
+            if (order.size() != related || parents.size() != order.size() || offsets.back() != order.size())
+            {
+                log << "  depth order holds " << order.size() << " entities, " << related << " have a relationship\n";
+                return false;
+            }
+            for (std::size_t depth = 0; depth + 1 < offsets.size(); ++depth)
+                for (uint32_t i = offsets[depth]; i < offsets[depth + 1]; ++i)
+                {
+                    ECS::Entity parent = engine->getParent(order[i]);
+                    bool placed = depth == 0 ? parents[i] == ECS::Hierarchy::NO_PARENT && parent == ECS::NULL_ENTITY
+                        : parents[i] >= offsets[depth - 1] && parents[i] < offsets[depth] && order[parents[i]] == parent;
+                    if (placed && alive[order[i]])
+                        continue;
+                    log << "  entity " << order[i] << " at depth " << depth << " is not one depth below its parent\n";
+                    return false;
+                }
+            std::vector<ECS::Entity> sortedOrder(order.begin(), order.end());
+            std::sort(sortedOrder.begin(), sortedOrder.end());
+            if (std::adjacent_find(sortedOrder.begin(), sortedOrder.end()) != sortedOrder.end())
+            {
+                log << "  an entity is listed twice in the depth order\n";
+                return false;
+            }
+            if (failed.getCount() != expectedFailures)
+            {
+                log << "  " << failed.getCount() << " checks failed, " << expectedFailures << " expected\n";
+                return false;
+            }
+            return true;
+        }
+
+        // Instances must hold the prefab's components, reach indexes and observers and leave
+        // the prefab as it was. Instantiating an entity that is not a prefab, or more instances
+        // than IDs are left, must create nothing
+        bool checkPrefabInstances(const Config& config, std::ostream& log)
+        {
+            auto engine = makeEngine();
+            FailedChecks failed;
+            std::size_t added = 0;
+            engine->onAdd<Health>([&added](ECS::Entity, const Health&) { added++; });
+            engine->addHashIndex<NetworkId>([](const NetworkId& id) { return id.value; });
+            ECS::Entity prefab = engine->createPrefab();
+            engine->addComponent(prefab, Position{ 1.f, 2.f, 3.f });
+            engine->addComponent(prefab, Health{ 42.f });
+            engine->addComponent(prefab, NetworkId{ 7 });
+            std::size_t count = config.entities;
+            std::vector<ECS::Entity> instances = engine->instantiate(prefab, count);
+            if (instances.size() != count || added != count || engine->findEntities<NetworkId>(7u).size() != count)
+            {
+                log << "  " << instances.size() << " instances, " << added << " seen by observers, "
+                    << engine->findEntities<NetworkId>(7u).size() << " indexed, " << count << " expected\n";
+                return false;
+            }
+            for (ECS::Entity e : instances)
+            {
+                const Position& position = engine->getComponent<Position>(e);
+                if (engine->isPrefab(e) == false && position.x == 1.f && position.z == 3.f && engine->getComponent<Health>(e).value == 42.f)
+                    continue;
+                log << "  instance " << e << " differs from its prefab\n";
+                return false;
+            }
+            engine->getComponent<Health>(instances.front()).value = 0.f;
+            if (engine->isPrefab(prefab) == false || engine->getComponent<Health>(prefab).value != 42.f)
+            {
+                log << "  prefab changed by its instances\n";
+                return false;
+            }
+
+            // Refused without creating anything, in release builds as well
+            uint64_t expectedFailures = 0;
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            expectedFailures = 2;
+#endif
+            if (engine->instantiate(instances.front(), 3).empty() == false)
+            {
+                log << "  an entity that is not a prefab was instantiated\n";
+                return false;
+            }
+            std::vector<ECS::Entity> filler;
+            while (count + filler.size() + 1 + 5 < ECS::MAX_ENTITY)
+                filler.push_back(engine->createEntity());
+            if (engine->instantiate(prefab, 6).empty() == false || engine->instantiate(prefab, 5).size() != 5)
+            {
+                log << "  instances beyond the entity limit were not refused at once\n";
+                return false;
+            }
+            if (failed.getCount() != expectedFailures)
+            {
+                log << "  " << failed.getCount() << " checks failed, " << expectedFailures << " expected\n";
+                return false;
+            }
+            return true;
+        }
+
+        struct Heat
+        {
+            float value;
+        };
+
+        struct Charge
+        {
+            float value;
+        };
+
+        // A merged world must keep its components, shared values, indexes and relationships,
+        // with columns stored the way the target registered them: Heat is buffered in the
+        // target only and Charge in staging only, so swapBuffers() must publish every merged
+        // Heat. Staging worlds sharing a type the target does not, or holding more entities
+        // than IDs are left, must be refused with staging untouched
+        bool checkMerge(const Config& config, std::ostream& log)
+        {
+            auto engine = makeEngine();
+            engine->registerBufferedComponent<Heat>();
+            engine->registerComponent<Charge>();
+            engine->registerSharedComponent<Tint, TintHash>();
+            engine->addHashIndex<NetworkId>([](const NetworkId& id) { return id.value; });
+            FailedChecks failed;
+            auto makeStaging = [&config](bool sharedTint)
+            {
+                auto staging = makeEngine();
+                staging->registerComponent<Heat>();
+                staging->registerBufferedComponent<Charge>();
+                if (sharedTint)
+                    staging->registerSharedComponent<Tint, TintHash>();
+                else
+                    staging->registerComponent<Tint>();
+                std::vector<ECS::Entity> entities;
+                for (std::size_t i = 0; i < config.entities; ++i)
+                {
+                    ECS::Entity e = staging->createEntity();
+                    staging->addComponent(e, Heat{ (float)i });
+                    staging->addComponent(e, Charge{ (float)i * 2.f });
+                    staging->addComponent(e, NetworkId{ (uint32_t)i });
+                    if (sharedTint && i % 2 == 0)
+                        staging->addSharedComponent(e, Tint{ (uint32_t)(i % 5) });
+                    else if (sharedTint == false)
+                        staging->addComponent(e, Tint{ 1 });
+                    if (i > 0 && i % 3 == 0)
+                        staging->setParent(e, entities[i / 3]);
+                    entities.push_back(e);
+                }
+                return std::make_pair(std::move(staging), entities);
+            };
+
+            auto [staging, stagingEntities] = makeStaging(true);
+            std::vector<ECS::Entity> res = engine->merge(*staging);
+            for (std::size_t i = 0; i < stagingEntities.size(); ++i)
+            {
+                ECS::Entity e = stagingEntities[i] < res.size() ? res[stagingEntities[i]] : ECS::NULL_ENTITY;
+                bool same = e != ECS::NULL_ENTITY && engine->getComponent<Heat>(e).value == (float)i
+                    && engine->getComponent<Charge>(e).value == (float)i * 2.f && engine->findEntity<NetworkId>((uint32_t)i) == e
+                    && (i % 2 != 0 || engine->getSharedComponent<Tint>(e).color == i % 5)
+                    && (i == 0 || i % 3 != 0 || engine->getParent(e) == res[stagingEntities[i / 3]]);
+                if (same)
+                    continue;
+                log << "  staging entity " << stagingEntities[i] << " merged as " << e << " with other components or relationships\n";
+                return false;
+            }
+            engine->swapBuffers();
+            std::size_t published = 0;
+            engine->forEachPrevious<Heat>([&published](std::size_t count, const ECS::Entity*, const Heat*) { published += count; });
+            std::size_t left = 0;
+            for (ECS::Archetype* arch : staging->getArchetypeRefs(staging->generateIdentifier<Heat>()))
+                left += arch->getEntities().size();
+            if (published != stagingEntities.size() || left != 0)
+            {
+                log << "  " << published << " merged Heat published, " << stagingEntities.size() << " expected, or staging not emptied\n";
+                return false;
+            }
+
+            uint64_t expectedFailures = 0;
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            expectedFailures = 2;
+#endif
+            auto refused = [&](const char* what, ECS::Engine& from, const std::vector<ECS::Entity>& entities)
+            {
+                if (engine->merge(from).empty() && from.getComponent<Heat>(entities.back()).value == (float)(entities.size() - 1))
+                    return true;
+                log << "  merge of " << what << " not refused, or staging touched\n";
+                return false;
+            };
+            auto [plainTint, plainEntities] = makeStaging(false);
+            if (refused("a world not sharing Tint", *plainTint, plainEntities) == false)
+                return false;
+            // Room for all but one of staging's entities
+            auto [tooMany, tooManyEntities] = makeStaging(true);
+            std::vector<ECS::Entity> filler;
+            while (ECS::MAX_ENTITY - stagingEntities.size() - filler.size() >= tooManyEntities.size())
+                filler.push_back(engine->createEntity());
+            if (refused("more entities than IDs left", *tooMany, tooManyEntities) == false)
+                return false;
+            engine->destroyEntity(filler.back());
+            if (engine->merge(*tooMany).empty())
+            {
+                log << "  merge refused with room for every entity\n";
+                return false;
+            }
+            if (failed.getCount() != expectedFailures)
+            {
+                log << "  " << failed.getCount() << " checks failed, " << expectedFailures << " expected\n";
+                return false;
+            }
+            return true;
+        }
+
+        // getComponent() and getComponents() must give each entity its own components after
+        // moves between archetypes and sorting, skipping dead and out of range IDs (whose rows
+        // must not be prefetched), including when fn batches over another engine meanwhile
+        bool checkRowAccess(const Config& config, std::ostream& log)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto other = makeEngine();
+            FailedChecks failed;
+            std::vector<ECS::Entity> entities = populate(*engine, config.entities, rng, true);
+            std::vector<ECS::Entity> others = populate(*other, config.entities / 2, rng, true);
+            std::unordered_map<ECS::Entity, float> expected;
+            for (std::size_t i = 0; i < entities.size(); ++i)
+            {
+                engine->setComponent(entities[i], Position{ (float)i, 0.f, 0.f });
+                if (i % 3 == 0)
+                    engine->addComponent(entities[i], Health{ 1.f });
+                expected[entities[i]] = (float)i;
+            }
+            for (std::size_t i = 0; i < others.size(); ++i)
+                other->setComponent(others[i], Position{ -(float)i, 0.f, 0.f });
+            engine->sortArchetypes<Position>([](const Position& position) { return -position.x; });
+            for (std::size_t i = 0; i < entities.size(); i += 7)
+            {
+                engine->destroyEntity(entities[i]);
+                expected.erase(entities[i]);
+            }
+
+            for (const auto& pr : expected)
+                if (engine->getComponent<Position>(pr.first).x != pr.second)
+                {
+                    log << "  entity " << pr.first << " read another entity's Position\n";
+                    return false;
+                }
+            // Dead and out of range IDs among the live ones, where they are prefetched
+            std::vector<ECS::Entity> batch(entities);
+            std::shuffle(batch.begin(), batch.end(), rng);
+            for (std::size_t i = 0; i < batch.size(); i += 50)
+                batch.insert(batch.begin() + (std::ptrdiff_t)i, i % 100 == 0 ? ECS::NULL_ENTITY : ECS::MAX_ENTITY + (ECS::Entity)i);
+            std::size_t visited = 0;
+            std::size_t otherVisited = 0;
+            bool same = true;
+            engine->getComponents<const Position>(batch.data(), batch.size(), [&](ECS::Entity e, const Position& position)
+            {
+                auto found = expected.find(e);
+                same = same && found != expected.end() && found->second == position.x;
+                visited++;
+                if (visited % 100 == 0)
+                    other->getComponents<const Position>(others.data(), 10, [&](ECS::Entity, const Position& p)
+                    {
+                        same = same && p.x <= 0.f;
+                        otherVisited++;
+                    });
+            });
+            if (same == false || visited != expected.size() || otherVisited != visited / 100 * 10)
+            {
+                log << "  batched reads gave " << visited << " entities for " << expected.size() << " alive, or other components\n";
+                return false;
+            }
+            uint64_t expectedFailures = 0;
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            expectedFailures = batch.size() - entities.size() + (entities.size() + 6) / 7;
+#endif
+            if (failed.getCount() != expectedFailures)
+            {
+                log << "  " << failed.getCount() << " checks failed, " << expectedFailures << " expected\n";
+                return false;
+            }
+            return true;
+        }
+
+        struct Clock
+        {
+            float time;
+        };
+
+        // Misuse reported by a failed check must leave the engine usable. Parent cycles are
+        // refused in release builds as well. In checked builds, queries of a missing resource,
+        // of a plain component as a shared one and of another buffer's pending ID get
+        // placeholders instead of reading out of memory
+        bool checkFallbacks(const Config&, std::ostream& log)
+        {
+            auto engine = makeEngine();
+            FailedChecks failed;
+            ECS::Entity root = engine->createEntity();
+            ECS::Entity middle = engine->createEntity();
+            ECS::Entity leaf = engine->createEntity();
+            engine->setParent(middle, root);
+            engine->setParent(leaf, middle);
+
+            uint64_t expectedFailures = 0;
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            expectedFailures = 2;
+#endif
+            engine->setParent(root, leaf);
+            engine->setParent(middle, middle);
+            if (engine->getParent(root) != ECS::NULL_ENTITY || engine->getParent(middle) != root)
+            {
+                log << "  a parent cycle was installed\n";
+                return false;
+            }
+            // Walks the subtree, endless on a cycle
+            engine->destroyEntity(root);
+
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+            engine->registerComponent<Tint>();
+            ECS::Entity plain = engine->createEntity();
+            engine->addComponent(plain, Tint{ 1 });
+            engine->getSharedComponent<Tint>(plain);
+            engine->setSharedComponent<Tint>(plain, Tint{ 2 });
+            engine->getResource<Clock>();
+            ECS::CommandBuffer other;
+            ECS::Entity foreign = other.createEntity();
+            ECS::CommandBuffer buffer;
+            buffer.addComponent(foreign, Health{ 1.f });
+            buffer.apply(*engine);
+            // The shared getter and setter fail once each, the resource once, the command
+            // twice as the engine refuses the entity too
+            expectedFailures += 5;
+            if (engine->getComponent<Tint>(plain).color != 1)
+            {
+                log << "  a plain component was written as a shared one\n";
+                return false;
+            }
+#endif
+            if (failed.getCount() != expectedFailures)
+            {
+                log << "  " << failed.getCount() << " checks failed, " << expectedFailures << " expected\n";
+                return false;
+            }
+            return true;
+        }
+    }
+
+    void registerEntityBenchmarks(Suite& suite)
+    {
+        suite.add("entity_create_destroy", createDestroy);
+        suite.add("entity_create_destroy_with_components", createDestroyWithComponents);
+        suite.add("entity_spawn", [](const Config& config, Timer& timer)
+        {
+            return spawnWithComponents(config, false, timer);
+        });
+        suite.add("entity_spawn_reserved", [](const Config& config, Timer& timer)
+        {
+            return spawnWithComponents(config, true, timer);
+        });
+        suite.add("prefab_instantiate_destroy", instantiateDestroy);
+        suite.add("sleep_wake_compressed", sleepWakeCompressed);
+        suite.add("component_add_remove_churn", addRemoveChurn);
+        suite.add("heap_component_copy", [](const Config& config, Timer& timer)
+        {
+            return heapComponentChurn(config, false, timer);
+        });
+        suite.add("heap_component_emplace", [](const Config& config, Timer& timer)
+        {
+            return heapComponentChurn(config, true, timer);
+        });
+        suite.add("random_get_component", randomGetComponent);
+        suite.add("random_get_components_batched", randomGetComponentsBatched);
+        suite.add("resource_get", [](const Config& config, Timer& timer)
+        {
+            return globalStateRead(config, true, timer);
+        });
+        suite.add("singleton_component_get", [](const Config& config, Timer& timer)
+        {
+            return globalStateRead(config, false, timer);
+        });
+        suite.add("index_hash_lookup", indexLookup);
+
+        suite.addCheck("index_lookup_conversions", checkIndexLookups);
+        suite.addCheck("sleep_wake_compressed_roundtrip", checkSleepWake);
+        suite.addCheck("sleep_packed_edits", checkPackedSleepers);
+        suite.addCheck("shared_components", checkSharedComponents);
+        suite.addCheck("hierarchy_depth_order", checkHierarchy);
+        suite.addCheck("prefab_instances", checkPrefabInstances);
+        suite.addCheck("merge_worlds", checkMerge);
+        suite.addCheck("row_table_access", checkRowAccess);
+        suite.addCheck("failed_check_fallbacks", checkFallbacks);
+    }
+}
@@ -0,0 +1,1004 @@
+#include "Bench.hpp"
+#include "Components.hpp"
+
+#include "ECS/Parallel.hpp"
+#include "ECS/Replication.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace Bench
+{
+    namespace
+    {
+        constexpr std::size_t PASSES = 10;
+        constexpr float DT = 1.f / 60.f;
+
+        class SumProcessor : public ECS::Processor
+        {
+        public:
+            SumProcessor(ECS::Engine& engine)
+                : ECS::Processor(engine)
+            { }
+
+            float run()
+            {
+                float sum = 0.f;
+                for (auto arch : getData())
+                for (auto entity : arch->getEntities())
+                    sum += arch->getComponent<Position>(entity).x;
+                return sum;
+            }
+        };
+
+        class MoveProcessor : public ECS::Processor
+        {
+        public:
+            MoveProcessor(ECS::Engine& engine)
+                : ECS::Processor(engine)
+            { }
+
+            void run()
+            {
+                for (auto arch : getData())
+                for (auto entity : arch->getEntities())
+                {
+                    auto& pos = arch->getComponent<Position>(entity);
+                    const auto& vel = arch->getComponent<Velocity>(entity);
+                    pos.x += vel.x * DT;
+                    pos.y += vel.y * DT;
+                    pos.z += vel.z * DT;
+                }
+            }
+
+            // Same work as run() over the rows the budget allows
+            bool runSlice()
+            {
+                return forEachSlice([](ECS::Archetype& arch, std::size_t begin, std::size_t end)
+                {
+                    auto columns = arch.getColumns<Position, Velocity>();
+                    Position* positions = std::get<Position*>(columns);
+                    const Velocity* velocities = std::get<Velocity*>(columns);
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        positions[i].x += velocities[i].x * DT;
+                        positions[i].y += velocities[i].y * DT;
+                        positions[i].z += velocities[i].z * DT;
+                    }
+                });
+            }
+        };
+
+        // Position += Velocity * DT over one chunk, both treated as flat float arrays.
+        // Columns are padded to ECS::COMPONENT_ALIGNMENT, so the last partial vector is
+        // processed whole instead of running a scalar tail
+        void integrateChunk(std::size_t count, Position* positions, Velocity* velocities)
+        {
+            static_assert(sizeof(Position) == 3 * sizeof(float) && sizeof(Velocity) == 3 * sizeof(float),
+                "integrateChunk expects tightly packed float components");
+            float* pos = &positions->x;
+            const float* vel = &velocities->x;
+            std::size_t floats = count * 3;
+        #ifdef __AVX2__
+            const __m256 dt = _mm256_set1_ps(DT);
+            for (std::size_t i = 0; i < floats; i += 8)
+            {
+                __m256 p = _mm256_load_ps(pos + i);
+                __m256 v = _mm256_load_ps(vel + i);
+                _mm256_store_ps(pos + i, _mm256_add_ps(p, _mm256_mul_ps(v, dt)));
+            }
+        #else
+            for (std::size_t i = 0; i < floats; ++i)
+                pos[i] += vel[i] * DT;
+        #endif
+        }
+
+        std::size_t iterateSingle(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, false);
+            auto proc = engine->registerProcessor<SumProcessor>();
+            engine->setProcessorIdentifier<SumProcessor, Position>();
+
+            float sum = 0.f;
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                sum += proc->run();
+            timer.stop();
+            doNotOptimize((uint64_t)sum);
+            return config.entities * PASSES;
+        }
+
+        std::size_t iterateMulti(const Config& config, bool fragmented, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, fragmented);
+            auto proc = engine->registerProcessor<MoveProcessor>();
+            engine->setProcessorIdentifier<MoveProcessor, Position, Velocity>();
+
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                proc->run();
+            timer.stop();
+            return config.entities * PASSES;
+        }
+
+        // Same work as iterateMulti, a tenth of the entities per call over fragmented archetypes
+        std::size_t iterateTimeSliced(const Config& config, Timer& timer)
+        {
+            constexpr std::size_t SLICES = 10;
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, true);
+            auto proc = engine->registerProcessor<MoveProcessor>();
+            engine->setProcessorIdentifier<MoveProcessor, Position, Velocity>();
+            ECS::SliceBudget budget;
+            budget.entities = (config.entities + SLICES - 1) / SLICES;
+            proc->setBudget(budget);
+
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                for (std::size_t slice = 0; slice < SLICES; ++slice)
+                    proc->runSlice();
+            timer.stop();
+            return config.entities * PASSES;
+        }
+
+        // Same work as iterateMulti, on whole columns instead of per-entity lookups
+        std::size_t iterateChunks(const Config& config, bool fragmented, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, fragmented);
+
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                engine->forEachChunk<Position, Velocity>(integrateChunk);
+            timer.stop();
+            return config.entities * PASSES;
+        }
+
+        // Same work as iterateChunks on runtime components laid out like Position and Velocity
+        std::size_t iterateRawChunks(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            std::uniform_real_distribution<float> dist(-1.f, 1.f);
+            auto engine = makeEngine();
+            ECS::RawComponentInfo info;
+            info.size = sizeof(Position);
+            info.alignment = alignof(Position);
+            std::vector<ECS::ComponentType> types = {
+                engine->registerRawComponent("RawPosition", info),
+                engine->registerRawComponent("RawVelocity", info),
+            };
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                for (ECS::ComponentType type : types)
+                    *static_cast<Position*>(engine->addRawComponent(e, type)) = Position{ dist(rng), dist(rng), dist(rng) };
+            }
+
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                engine->forEachRawChunk(types, [](std::size_t count, void* const* columns)
+                {
+                    integrateChunk(count, static_cast<Position*>(columns[0]), static_cast<Velocity*>(columns[1]));
+                });
+            timer.stop();
+            return config.entities * PASSES;
+        }
+
+        // Entities with Position, Velocity and a random NetworkId
+        std::vector<ECS::Entity> populateKeyed(ECS::Engine& engine, const Config& config, std::mt19937& rng)
+        {
+            auto entities = populate(engine, config.entities, rng, false);
+            for (auto e : entities)
+                engine.addComponent(e, NetworkId{ (uint32_t)rng() });
+            return entities;
+        }
+
+        uint32_t networkKey(const NetworkId& id)
+        {
+            return id.value;
+        }
+
+        // Full radix sort of shuffled keys
+        std::size_t sortArchetypes(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populateKeyed(*engine, config, rng);
+
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+            {
+                for (auto e : entities)
+                    engine->getComponent<NetworkId>(e).value = (uint32_t)rng();
+                timer.start();
+                engine->sortArchetypes<NetworkId>(networkKey);
+                timer.stop();
+            }
+            return config.entities * PASSES;
+        }
+
+        // Order restored incrementally after 1% of the entities left and rejoined the archetype
+        std::size_t sortArchetypesIncremental(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            auto entities = populateKeyed(*engine, config, rng);
+            engine->sortArchetypes<NetworkId>(networkKey, true);
+
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+            {
+                for (std::size_t i = 0; i < config.entities / 100; ++i)
+                {
+                    ECS::Entity e = entities[rng() % entities.size()];
+                    engine->removeComponent<NetworkId>(e);
+                    engine->addComponent(e, NetworkId{ (uint32_t)rng() });
+                }
+                timer.start();
+                engine->restoreOrders();
+                timer.stop();
+            }
+            return config.entities * PASSES;
+        }
+
+        // Columnar dump of fragmented archetypes to a temporary file
+        std::size_t exportColumns(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, true);
+            std::FILE* file = std::tmpfile();
+            if (file == nullptr)
+                return 0;
+
+            bool written = true;
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+                written = engine->exportColumns(fileno(file)) && written;
+            timer.stop();
+            std::fclose(file);
+            return written ? config.entities * PASSES : 0;
+        }
+
+        // Dump the sleepers of a world, packed and compressed, and read them back: every sleeper
+        // must be in one batch with its own Position, and must still be packed and wake with
+        // its components
+        bool checkExport(const Config& config, std::ostream& log)
+        {
+            auto engine = makeEngine();
+            std::unordered_map<ECS::Entity, Position> positions;
+            std::vector<ECS::Entity> sleepers;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                Position p{ (float)i, 2.f * (float)i, -(float)i };
+                engine->addComponent(e, p);
+                if (i % 3 != 0)
+                    engine->addComponent(e, Velocity{ 1.f, 0.f, 0.f });
+                if (i % 2 != 0)
+                    continue;
+                sleepers.push_back(e);
+                positions.emplace(e, p);
+            }
+            engine->sleepEntities(sleepers, true);
+
+            std::FILE* file = std::tmpfile();
+            if (file == nullptr)
+            {
+                log << "  no temporary file\n";
+                return false;
+            }
+            // Sleepers are only exported when named
+            bool written = engine->exportColumns(fileno(file), engine->generateIdentifier<ECS::Sleeping>());
+            std::vector<char> dump;
+            if (std::fseek(file, 0, SEEK_END) == 0)
+            {
+                dump.resize((std::size_t)std::ftell(file));
+                std::rewind(file);
+                dump.resize(std::fread(dump.data(), 1, dump.size(), file));
+            }
+            std::fclose(file);
+            if (written == false)
+            {
+                log << "  export failed\n";
+                return false;
+            }
+
+            std::size_t offset = 0;
+            auto read = [&](void* out, std::size_t size)
+            {
+                if (offset + size > dump.size())
+                    return false;
+                std::memcpy(out, dump.data() + offset, size);
+                offset += size;
+                return true;
+            };
+            auto align = [&]()
+            {
+                constexpr std::size_t alignment = ECS::ColumnWriter::BLOCK_ALIGNMENT;
+                offset = (offset + alignment - 1) / alignment * alignment;
+            };
+            char magic[4];
+            uint32_t version = 0;
+            uint32_t typeCount = 0;
+            if (read(magic, 4) == false || std::memcmp(magic, "ECSC", 4) != 0
+                || read(&version, sizeof(version)) == false || version != ECS::COLUMN_EXPORT_VERSION
+                || read(&typeCount, sizeof(typeCount)) == false)
+            {
+                log << "  bad header\n";
+                return false;
+            }
+            uint32_t positionType = typeCount;
+            for (uint32_t t = 0; t < typeCount; ++t)
+            {
+                uint32_t elementSize = 0;
+                uint32_t length = 0;
+                if (read(&elementSize, sizeof(elementSize)) == false || read(&length, sizeof(length)) == false
+                    || offset + length > dump.size())
+                {
+                    log << "  truncated schema\n";
+                    return false;
+                }
+                if (std::string(dump.data() + offset, length) == typeid(Position).name() && elementSize == sizeof(Position))
+                    positionType = t;
+                offset += length;
+            }
+
+            std::unordered_map<ECS::Entity, bool> seen;
+            std::vector<ECS::Entity> entities;
+            std::vector<Position> columnPositions;
+            while (true)
+            {
+                uint32_t rowCount = 0;
+                uint32_t columnCount = 0;
+                if (read(&rowCount, sizeof(rowCount)) == false)
+                {
+                    log << "  missing end of dump\n";
+                    return false;
+                }
+                if (rowCount == ECS::COLUMN_EXPORT_END)
+                    break;
+                entities.resize(rowCount);
+                columnPositions.clear();
+                bool valid = read(&columnCount, sizeof(columnCount));
+                align();
+                valid = valid && read(entities.data(), rowCount * sizeof(ECS::Entity));
+                for (uint32_t c = 0; valid && c < columnCount; ++c)
+                {
+                    uint32_t type = 0;
+                    uint64_t length = 0;
+                    valid = read(&type, sizeof(type)) && read(&length, sizeof(length));
+                    align();
+                    if (valid && type == positionType && length == rowCount * sizeof(Position))
+                    {
+                        columnPositions.resize(rowCount);
+                        valid = read(columnPositions.data(), length);
+                    }
+                    else if (valid && offset + length <= dump.size())
+                        offset += length;
+                    else
+                        valid = false;
+                }
+                if (valid == false || columnPositions.size() != rowCount)
+                {
+                    log << "  batch of " << rowCount << " rows truncated or without Position\n";
+                    return false;
+                }
+                for (uint32_t r = 0; r < rowCount; ++r)
+                {
+                    auto found = positions.find(entities[r]);
+                    if (found == positions.end() || seen[entities[r]])
+                    {
+                        log << "  entity " << entities[r] << " unknown or exported twice\n";
+                        return false;
+                    }
+                    seen[entities[r]] = true;
+                    if (std::memcmp(&found->second, &columnPositions[r], sizeof(Position)) != 0)
+                    {
+                        log << "  entity " << entities[r] << " exported with another Position\n";
+                        return false;
+                    }
+                }
+            }
+            if (seen.size() != positions.size())
+            {
+                log << "  " << positions.size() - seen.size() << " entities not exported\n";
+                return false;
+            }
+
+            for (ECS::Archetype* arch : engine->getArchetypeRefs(engine->generateIdentifier<ECS::Sleeping>()))
+                if (arch->getEntities().empty() == false && arch->isPacked() == false)
+                {
+                    log << "  export unpacked a sleeping archetype\n";
+                    return false;
+                }
+            engine->wakeEntities(sleepers);
+            for (ECS::Entity e : sleepers)
+                if (std::memcmp(&engine->getComponent<Position>(e), &positions[e], sizeof(Position)) != 0)
+                {
+                    log << "  entity " << e << " woke with another Position\n";
+                    return false;
+                }
+            return true;
+        }
+
+        // Server and client engines joined by a byte vector, a tenth of the entities move
+        // every tick and the client acknowledges each message
+        std::size_t replicateDelta(const Config& config, Timer& timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto serverEngine = makeEngine();
+            auto clientEngine = makeEngine();
+            std::vector<ECS::Entity> entities = populate(*serverEngine, config.entities, rng, true);
+            ECS::ReplicationServer server(*serverEngine);
+            ECS::ReplicationClient client(*clientEngine);
+            server.addType<Position>();
+            server.addType<Velocity>();
+            client.addType<Position>();
+            client.addType<Velocity>();
+            uint32_t id = server.addClient();
+
+            std::vector<uint8_t> pipe;
+            bool applied = true;
+            auto tick = [&]()
+            {
+                server.capture();
+                server.encode(id, pipe);
+                applied = client.apply(pipe.data(), pipe.size()) && applied;
+                server.acknowledge(id, client.getSequence());
+            };
+            tick();
+
+            std::uniform_int_distribution<std::size_t> pick(0, entities.size() - 1);
+            timer.start();
+            for (std::size_t pass = 0; pass < PASSES; ++pass)
+            {
+                for (std::size_t i = 0; i < entities.size() / 10; ++i)
+                    serverEngine->getComponent<Position>(entities[pick(rng)]).x += DT;
+                tick();
+            }
+            timer.stop();
+            doNotOptimize(pipe.size());
+            return applied ? config.entities * PASSES : 0;
+        }
+
+        // Entities of engine having T
+        template <typename T>
+        std::size_t countHaving(ECS::Engine& engine)
+        {
+            std::size_t res = 0;
+            for (ECS::Archetype* arch : engine.getArchetypeRefs(engine.generateIdentifier<T>()))
+                res += arch->getEntities().size();
+            return res;
+        }
+
+        // The client copy of T of every server entity must hold the same bytes, and the client
+        // must have no other entity with T
+        template <typename T>
+        bool mirrorsType(ECS::Engine& serverEngine, ECS::Engine& clientEngine, const ECS::ReplicationClient& client,
+            const std::vector<ECS::Entity>& alive, const char* name, std::ostream& log)
+        {
+            std::size_t expected = 0;
+            for (ECS::Entity e : alive)
+            {
+                if (serverEngine.haveComponent<T>(e) == false)
+                    continue;
+                ++expected;
+                ECS::Entity mirror = client.getEntity(e);
+                if (mirror == ECS::NULL_ENTITY || clientEngine.haveComponent<T>(mirror) == false)
+                {
+                    log << "  server entity " << e << " has no client " << name << '\n';
+                    return false;
+                }
+                if (std::memcmp(&serverEngine.getComponent<T>(e), &clientEngine.getComponent<T>(mirror), sizeof(T)) != 0)
+                {
+                    log << "  " << name << " of server entity " << e << " differs on the client\n";
+                    return false;
+                }
+            }
+            if (countHaving<T>(clientEngine) != expected)
+            {
+                log << "  client has " << countHaving<T>(clientEngine) << " entities with " << name << ", server has " << expected << '\n';
+                return false;
+            }
+            return true;
+        }
+
+        // The client must mirror the server after full and delta messages, component
+        // removal, destruction, re-adding a type and acknowledgements or messages being lost
+        bool checkReplication(const Config& config, std::ostream& log)
+        {
+            std::mt19937 rng(config.seed);
+            auto serverEngine = makeEngine();
+            auto clientEngine = makeEngine();
+            std::vector<ECS::Entity> alive = populate(*serverEngine, config.entities, rng, true);
+            ECS::ReplicationServer server(*serverEngine);
+            ECS::ReplicationClient client(*clientEngine);
+            server.addType<Position>();
+            server.addType<Velocity>();
+            client.addType<Position>();
+            client.addType<Velocity>();
+            uint32_t id = server.addClient();
+
+            std::vector<uint8_t> pipe;
+            std::vector<ECS::Entity> destroyed;
+            auto tick = [&](bool delivered, bool acknowledged, const char* step)
+            {
+                server.capture();
+                server.encode(id, pipe);
+                if (delivered == false)
+                    return true;
+                if (client.apply(pipe.data(), pipe.size()) == false)
+                {
+                    log << "  " << step << ": message rejected\n";
+                    return false;
+                }
+                if (acknowledged)
+                    server.acknowledge(id, client.getSequence());
+                bool res = mirrorsType<Position>(*serverEngine, *clientEngine, client, alive, "Position", log)
+                    && mirrorsType<Velocity>(*serverEngine, *clientEngine, client, alive, "Velocity", log);
+                for (ECS::Entity e : destroyed)
+                {
+                    if (client.getEntity(e) == ECS::NULL_ENTITY)
+                        continue;
+                    log << "  destroyed server entity " << e << " still has a client entity\n";
+                    res = false;
+                    break;
+                }
+                if (res == false)
+                    log << "  after " << step << '\n';
+                return res;
+            };
+            auto move = [&]()
+            {
+                std::uniform_int_distribution<std::size_t> pick(0, alive.size() - 1);
+                for (std::size_t i = 0; i < alive.size() / 10; ++i)
+                {
+                    ECS::Entity e = alive[pick(rng)];
+                    if (serverEngine->haveComponent<Position>(e))
+                        serverEngine->getComponent<Position>(e).x += DT;
+                }
+            };
+
+            if (tick(true, true, "full snapshot") == false)
+                return false;
+            move();
+            if (tick(true, true, "delta") == false)
+                return false;
+
+            // Every 7th entity loses Velocity, every 11th loses both types then gets Position
+            // back, every 13th is destroyed
+            std::vector<ECS::Entity> withoutVelocity;
+            std::vector<ECS::Entity> kept;
+            for (std::size_t i = 0; i < alive.size(); ++i)
+            {
+                ECS::Entity e = alive[i];
+                if (i % 13 == 0)
+                {
+                    serverEngine->destroyEntity(e);
+                    destroyed.push_back(e);
+                    continue;
+                }
+                kept.push_back(e);
+                if (i % 7 == 0 || i % 11 == 0)
+                {
+                    serverEngine->removeComponent<Velocity>(e);
+                    withoutVelocity.push_back(e);
+                }
+                if (i % 11 == 0)
+                    serverEngine->removeComponent<Position>(e);
+            }
+            alive = kept;
+            if (tick(true, true, "removal and destruction") == false)
+                return false;
+
+            for (ECS::Entity e : withoutVelocity)
+            {
+                if (serverEngine->haveComponent<Position>(e) == false)
+                    serverEngine->addComponent(e, Position{ 0.5f, 0.25f, 0.125f });
+                serverEngine->addComponent(e, Velocity{ 1.f, 2.f, 3.f });
+            }
+            if (tick(true, true, "re-adding types") == false)
+                return false;
+
+            // Acknowledgements are lost for a few ticks, then a message: deltas keep coming
+            // from the last acknowledged baseline
+            for (std::size_t i = 0; i < 3; ++i)
+            {
+                move();
+                if (tick(true, false, "lost acknowledgement") == false)
+                    return false;
+            }
+            move();
+            if (tick(false, false, "lost message") == false)
+                return false;
+            move();
+            return tick(true, true, "delta from an old baseline");
+        }
+
+        constexpr std::size_t LOCKSTEP_TICKS = 1000;
+        constexpr std::size_t LOCKSTEP_PARTITION = 256;
+
+        uint64_t hashBytes(uint64_t hash, const void* data, std::size_t size)
+        {
+            // FNV-1a
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+
+        // Hash of the world after LOCKSTEP_TICKS ticks of a simulation run on threads threads:
+        // entities bounce in a box, some are replaced every tick through command buffers and
+        // the kinetic energy is summed per partition then folded in partition order
+        uint64_t simulateLockstep(const Config& config, unsigned threads, Timer* timer)
+        {
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, true);
+            ECS::ParallelExecutor executor(*engine, threads, LOCKSTEP_PARTITION);
+            uint64_t hash = 14695981039346656037ull;
+            std::vector<float> energies;
+
+            if (timer != nullptr)
+                timer->start();
+            for (std::size_t tick = 0; tick < LOCKSTEP_TICKS; ++tick)
+            {
+                energies.assign(executor.getPartitionCount<Position, Velocity>(), 0.f);
+                executor.forEach<Position, Velocity>([&energies, tick](const ECS::ParallelPartition& partition, Position* pos, Velocity* vel)
+                {
+                    float energy = 0.f;
+                    for (std::size_t i = 0; i < partition.count; ++i)
+                    {
+                        pos[i].x += vel[i].x * DT;
+                        pos[i].y += vel[i].y * DT;
+                        pos[i].z += vel[i].z * DT;
+                        if (std::fabs(pos[i].x) > 1.f)
+                            vel[i].x = -vel[i].x;
+                        if (std::fabs(pos[i].y) > 1.f)
+                            vel[i].y = -vel[i].y;
+                        energy += vel[i].x * vel[i].x + vel[i].y * vel[i].y + vel[i].z * vel[i].z;
+
+                        ECS::Entity entity = partition.entities[i];
+                        if ((entity * 2654435761u + (uint32_t)tick) % 509 != 0)
+                            continue;
+                        // The replacement's ID depends on the order commands are applied in
+                        partition.commands.destroyEntity(entity);
+                        ECS::Entity spawned = partition.commands.createEntity();
+                        partition.commands.addComponent(spawned, Position{ 0.f, 0.f, 0.f });
+                        partition.commands.addComponent(spawned, Velocity{ vel[i].y, vel[i].z, vel[i].x });
+                        if (tick % 2 == 0)
+                            partition.commands.addComponent(spawned, Tag<0>{ 0 });
+                    }
+                    energies[partition.index] = energy;
+                });
+                float total = 0.f;
+                for (float energy : energies)
+                    total += energy;
+                hash = hashBytes(hash, &total, sizeof(total));
+            }
+            if (timer != nullptr)
+                timer->stop();
+
+            for (ECS::Archetype* arch : engine->getArchetypeRefs(engine->generateIdentifier<Position, Velocity>()))
+            {
+                const auto& entities = arch->getEntities();
+                auto columns = arch->getColumns<Position, Velocity>();
+                hash = hashBytes(hash, entities.data(), entities.size() * sizeof(ECS::Entity));
+                hash = hashBytes(hash, std::get<0>(columns), entities.size() * sizeof(Position));
+                hash = hashBytes(hash, std::get<1>(columns), entities.size() * sizeof(Velocity));
+            }
+            return hash;
+        }
+
+        // Timed on 4 threads, the world must hash the same as an untimed single-threaded run
+        std::size_t parallelLockstep(const Config& config, Timer& timer)
+        {
+            uint64_t expected = simulateLockstep(config, 1, nullptr);
+            uint64_t hash = simulateLockstep(config, 4, &timer);
+            doNotOptimize(hash);
+            return hash == expected ? config.entities * LOCKSTEP_TICKS : 0;
+        }
+
+        // The world must hash the same whatever the number of threads, uneven counts included
+        bool checkLockstep(const Config& config, std::ostream& log)
+        {
+            uint64_t expected = simulateLockstep(config, 1, nullptr);
+            bool res = true;
+            for (unsigned threads : { 2u, 3u, 4u, 8u })
+            {
+                if (simulateLockstep(config, threads, nullptr) == expected)
+                    continue;
+                log << "  world hash on " << threads << " threads differs from the single-threaded run\n";
+                res = false;
+            }
+            return res;
+        }
+
+        constexpr std::size_t PUBLISH_FRAMES = 100;
+
+        // Position handed to a render thread every frame while 1 in 16 entities move, the first
+        // spawned ones so their rows share chunks. Either the whole column is copied to a
+        // separate buffer, or Position is buffered and the frame published by swapBuffers()
+        // Both must publish the final positions, otherwise the case reports 0 ops
+        std::size_t publishPreviousFrame(const Config& config, bool buffered, Timer& timer)
+        {
+            auto engine = std::make_unique<ECS::Engine>();
+            if (buffered)
+                engine->registerBufferedComponent<Position>();
+            else
+                engine->registerComponent<Position>();
+            std::vector<ECS::Entity> moving;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, Position{ (float)i, 0.f, 0.f });
+                if (i < config.entities / 16)
+                    moving.push_back(e);
+            }
+            std::vector<Position> copy;
+            std::vector<ECS::Entity> copyEntities;
+
+            timer.start();
+            for (std::size_t frame = 0; frame < PUBLISH_FRAMES; ++frame)
+            {
+                for (ECS::Entity e : moving)
+                {
+                    Position pos = engine->getComponent<Position>(e);
+                    pos.y += 1.f;
+                    engine->setComponent(e, pos);
+                }
+                if (buffered)
+                {
+                    engine->swapBuffers();
+                    continue;
+                }
+                copy.clear();
+                copyEntities.clear();
+                for (const ECS::Archetype* arch : engine->getArchetypeRefs(engine->generateIdentifier<Position>()))
+                {
+                    const Position* column = std::get<0>(arch->getColumns<Position>());
+                    copy.insert(copy.end(), column, column + arch->getEntities().size());
+                    copyEntities.insert(copyEntities.end(), arch->getEntities().begin(), arch->getEntities().end());
+                }
+            }
+            timer.stop();
+
+            double published = 0.0;
+            if (buffered)
+                engine->forEachPrevious<Position>([&](std::size_t count, const ECS::Entity*, const Position* column)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                        published += column[i].x + column[i].y;
+                });
+            else
+                for (const Position& pos : copy)
+                    published += pos.x + pos.y;
+            double expected = 0.0;
+            engine->forEachChunk<Position>([&](std::size_t count, Position* column)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                    expected += column[i].x + column[i].y;
+            });
+            doNotOptimize(copyEntities.size());
+            return published == expected ? config.entities * PUBLISH_FRAMES : 0;
+        }
+
+        // Positions of engine's entities sorted by entity, from the current columns or the
+        // previous frame
+        std::vector<std::pair<ECS::Entity, Position>> listPositions(ECS::Engine& engine, bool previous)
+        {
+            std::vector<std::pair<ECS::Entity, Position>> res;
+            if (previous)
+                engine.forEachPrevious<Position>([&res](std::size_t count, const ECS::Entity* entities, const Position* column)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                        res.emplace_back(entities[i], column[i]);
+                });
+            else
+                for (const ECS::Archetype* arch : engine.getArchetypeRefs(engine.generateIdentifier<Position>()))
+                {
+                    const Position* column = std::get<0>(arch->getColumns<Position>());
+                    for (std::size_t i = 0; i < arch->getEntities().size(); ++i)
+                        res.emplace_back(arch->getEntities()[i], column[i]);
+                }
+            std::sort(res.begin(), res.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            return res;
+        }
+
+        // The frame published by swapBuffers() must be the state at the call, whatever wrote
+        // it: setComponent(), chunk iteration, getComponents(), a parallel forEach() or
+        // structural changes. Frames that only read must copy nothing
+        bool checkPublishFrame(const Config& config, std::ostream& log)
+        {
+            constexpr std::size_t FRAMES = 24;
+            std::mt19937 rng(config.seed);
+            auto engine = std::make_unique<ECS::Engine>();
+            engine->registerBufferedComponent<Position>();
+            engine->registerComponent<Velocity>();
+            engine->registerComponent<Health>();
+            std::vector<ECS::Entity> entities;
+            for (std::size_t i = 0; i < config.entities; ++i)
+            {
+                ECS::Entity e = engine->createEntity();
+                engine->addComponent(e, Position{ (float)i, 0.f, 0.f });
+                engine->addComponent(e, Velocity{ 0.f, 1.f, 0.f });
+                entities.push_back(e);
+            }
+            ECS::ParallelExecutor executor(*engine, 4, LOCKSTEP_PARTITION);
+            engine->swapBuffers();
+
+            const char* steps[] = { "setComponent", "chunk iteration", "getComponents", "parallel forEach", "structural changes", "reads" };
+            for (std::size_t frame = 0; frame < FRAMES; ++frame)
+            {
+                std::size_t step = frame % 6;
+                if (step == 0)
+                    for (std::size_t i = frame % 16; i < entities.size(); i += 16)
+                    {
+                        Position pos = engine->getComponent<Position>(entities[i]);
+                        pos.z += 1.f;
+                        engine->setComponent(entities[i], pos);
+                    }
+                else if (step == 1)
+                    engine->forEachChunk<Position, const Velocity>([](std::size_t count, Position* pos, const Velocity* vel)
+                    {
+                        for (std::size_t i = 0; i < count; ++i)
+                            pos[i].y += vel[i].y;
+                    });
+                else if (step == 2)
+                {
+                    std::vector<ECS::Entity> picked;
+                    for (std::size_t i = frame % 7; i < entities.size(); i += 7)
+                        picked.push_back(entities[i]);
+                    std::shuffle(picked.begin(), picked.end(), rng);
+                    engine->getComponents<Position>(picked.data(), picked.size(), [](ECS::Entity, Position& pos)
+                    {
+                        pos.x += 1.f;
+                    });
+                }
+                else if (step == 3)
+                    executor.forEach<Position, const Velocity>([](const ECS::ParallelPartition& partition, Position* pos, const Velocity* vel)
+                    {
+                        for (std::size_t i = 0; i < partition.count; ++i)
+                            pos[i].y -= vel[i].y;
+                    });
+                else if (step == 4)
+                {
+                    // Rows move within and across archetypes
+                    for (std::size_t i = frame % 11; i < entities.size(); i += 11)
+                    {
+                        engine->destroyEntity(entities[i]);
+                        entities[i] = engine->createEntity();
+                        engine->addComponent(entities[i], Position{ -(float)i, 0.f, 0.f });
+                        engine->addComponent(entities[i], Velocity{ 0.f, 1.f, 0.f });
+                    }
+                    for (std::size_t i = frame % 13; i < entities.size(); i += 13)
+                        if (engine->haveComponent<Health>(entities[i]))
+                            engine->removeComponent<Health>(entities[i]);
+                        else
+                            engine->addComponent(entities[i], Health{ 1.f });
+                }
+                else
+                {
+                    float sum = 0.f;
+                    engine->forEachChunk<const Position>([&sum](std::size_t count, const Position* pos)
+                    {
+                        for (std::size_t i = 0; i < count; ++i)
+                            sum += pos[i].x;
+                    });
+                    engine->getComponents<const Position, const Velocity>(entities.data(), entities.size(), [&sum](ECS::Entity, const Position& pos, const Velocity&)
+                    {
+                        sum += pos.y;
+                    });
+                    executor.forEach<const Position>([](const ECS::ParallelPartition&, const Position*) { });
+                    listPositions(*engine, false);
+                    doNotOptimize((uint64_t)sum);
+                }
+
+                std::vector<std::pair<ECS::Entity, Position>> expected = listPositions(*engine, false);
+                std::size_t copied = engine->swapBuffers();
+                // An unreported write still reaches the published frame, it is the current
+                // buffer that goes stale
+                for (bool previous : { true, false })
+                {
+                    std::vector<std::pair<ECS::Entity, Position>> found = listPositions(*engine, previous);
+                    bool same = expected.size() == found.size();
+                    for (std::size_t i = 0; same && i < expected.size(); ++i)
+                        same = expected[i].first == found[i].first
+                            && std::memcmp(&expected[i].second, &found[i].second, sizeof(Position)) == 0;
+                    if (same == false)
+                    {
+                        log << "  " << (previous ? "previous" : "current") << " frame differs from the state at swapBuffers() after " << steps[step] << '\n';
+                        return false;
+                    }
+                }
+                if (step == 5 && copied != 0)
+                {
+                    log << "  " << copied << " rows copied after a frame of reads\n";
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::size_t queryMatch(const Config& config, Timer& timer)
+        {
+            constexpr std::size_t QUERIES = 1000;
+            std::mt19937 rng(config.seed);
+            auto engine = makeEngine();
+            populate(*engine, config.entities, rng, true);
+            ECS::Identifier ids[] = {
+                engine->generateIdentifier<Position>(),
+                engine->generateIdentifier<Position, Velocity>(),
+                engine->generateIdentifier<Position, Tag<0>>(),
+                engine->generateIdentifier<Tag<1>, Tag<3>, Tag<5>>(),
+            };
+
+            std::size_t matched = 0;
+            timer.start();
+            for (std::size_t i = 0; i < QUERIES; ++i)
+                matched += engine->getArchetypeRefs(ids[i % 4]).size();
+            timer.stop();
+            doNotOptimize(matched);
+            return QUERIES;
+        }
+    }
+
+    void registerIterationBenchmarks(Suite& suite)
+    {
+        suite.add("iterate_single_component", iterateSingle);
+        suite.add("iterate_multi_component", [](const Config& config, Timer& timer)
+        {
+            return iterateMulti(config, false, timer);
+        });
+        suite.add("iterate_fragmented_archetypes", [](const Config& config, Timer& timer)
+        {
+            return iterateMulti(config, true, timer);
+        });
+        suite.add("iterate_time_sliced", iterateTimeSliced);
+        suite.add("iterate_chunk_simd", [](const Config& config, Timer& timer)
+        {
+            return iterateChunks(config, false, timer);
+        });
+        suite.add("iterate_chunk_simd_fragmented", [](const Config& config, Timer& timer)
+        {
+            return iterateChunks(config, true, timer);
+        });
+        suite.add("iterate_chunk_raw", iterateRawChunks);
+        suite.add("sort_archetypes_radix", sortArchetypes);
+        suite.add("sort_archetypes_incremental", sortArchetypesIncremental);
+        suite.add("export_columns", exportColumns);
+        suite.add("replicate_delta", replicateDelta);
+        suite.add("parallel_lockstep", parallelLockstep);
+        suite.add("publish_frame_copy", [](const Config& config, Timer& timer)
+        {
+            return publishPreviousFrame(config, false, timer);
+        });
+        suite.add("publish_frame_buffered", [](const Config& config, Timer& timer)
+        {
+            return publishPreviousFrame(config, true, timer);
+        });
+        suite.add("query_match_archetypes", queryMatch);
+
+        suite.addCheck("replicate_delta_mirror", checkReplication);
+        suite.addCheck("publish_frame_previous", checkPublishFrame);
+        suite.addCheck("parallel_lockstep_threads", checkLockstep);
+        suite.addCheck("export_columns_packed", checkExport);
+    }
+}
@@ -0,0 +1,65 @@
+#include "Bench.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    void printUsage(const char* program)
+    {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "  --entities N      entities per case (default 10000)\n"
+                  << "  --repetitions N   timed repetitions per case (default 5)\n"
+                  << "  --seed N          seed of every random generator\n"
+                  << "  --filter STR      only run cases whose name contains STR\n"
+                  << "  --csv             write CSV instead of JSON\n"
+                  << "  --verify          run the correctness checks instead, exit code is 1 if any fails\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Bench::Config config;
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--entities") == 0 && hasValue)
+            config.entities = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue)
+            config.repetitions = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+            config.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+            config.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--csv") == 0)
+            config.csv = true;
+        else if (std::strcmp(argv[i], "--verify") == 0)
+            config.verify = true;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    Bench::Suite suite;
+    Bench::registerEntityBenchmarks(suite);
+    Bench::registerIterationBenchmarks(suite);
+    if (config.verify)
+    {
+        std::size_t failed = 0;
+        if (suite.verify(config, std::cout, failed) == 0)
+        {
+            std::cerr << "No check matches filter \"" << config.filter << "\"\n";
+            return 1;
+        }
+        return failed == 0 ? 0 : 1;
+    }
+    if (suite.run(config, std::cout) == 0)
+    {
+        std::cerr << "No benchmark matches filter \"" << config.filter << "\"\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef ARCHETYPE_ALIGNEDALLOCATOR_HPP
+#define ARCHETYPE_ALIGNEDALLOCATOR_HPP
+
+/*
+* Allocator of component columns. Blocks are
+* aligned to COMPONENT_ALIGNMENT and their size
+* is rounded up to a multiple of it, so SIMD
+* kernels can use aligned loads and process the
+* last partial vector without a scalar tail
+*/
+
+#include "Properties.hpp"
+
+#include <cstddef>
+#include <new>
+
+namespace ECS
+{
+    template <typename T>
+    class AlignedAllocator
+    {
+    public:
+        using value_type = T;
+        static constexpr std::size_t ALIGNMENT = alignof(T) > COMPONENT_ALIGNMENT ? alignof(T) : COMPONENT_ALIGNMENT;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U>;
+        };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U>&) { }
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>(::operator new(getPaddedSize(n), std::align_val_t(ALIGNMENT)));
+        }
+
+        void deallocate(T* p, std::size_t)
+        {
+            ::operator delete(p, std::align_val_t(ALIGNMENT));
+        }
+
+        // Bytes actually allocated for n elements
+        static std::size_t getPaddedSize(std::size_t n)
+        {
+            return (n * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+    };
+
+    template <typename T, typename U>
+    bool operator == (const AlignedAllocator<T>&, const AlignedAllocator<U>&)
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator != (const AlignedAllocator<T>&, const AlignedAllocator<U>&)
+    {
+        return false;
+    }
+}
+
+#endif // ARCHETYPE_ALIGNEDALLOCATOR_HPP
@@ -5,30 +5,57 @@
 * Archetype consists of ComponentVectors of
 * multiple component types. An entity's data
 * is stored inside an archetype if its ID is
-* the same with that of the archetype
+* the same with that of the archetype.
+* Component vectors share their element order,
+* so forEachChunk() can hand out raw columns
+* split into chunks of CHUNK_SIZE entities, and
+* the engine's row table locates an entity in
+* all of them without hashing.
+* Rows may be reordered by a key with sortBy(),
+* entities joining or leaving afterwards mark the
+* archetype as no longer ordered.
+* An archetype nobody iterates (sleeping entities)
+* may be packed: its trivially copyable columns
+* are shuffled and compressed into one buffer
+* (see Compression.hpp) and their vectors freed.
+* Entities are kept, but their packed components
+* cannot be reached until unpack()
 */
 
 #include "Macros.hpp"
 #include "ComponentVector.hpp"
+#include "SharedComponent.hpp"
+#include "BufferedComponent.hpp"
+#include "RawComponent.hpp"
 #include "Properties.hpp"
 #include "Identifier.hpp"
 #include "IDGenerator.hpp"
+#include "RowSort.hpp"
+#include "Compression.hpp"
 
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 namespace ECS
 {
     class ARCHETYPE_API Archetype
     {
     public:
+        // Multiple of COMPONENT_ALIGNMENT so every chunk starts aligned
+        static constexpr std::size_t CHUNK_SIZE = 1024;
+
         Archetype();
         Archetype(const Archetype& copyObject);
         Archetype& operator = (Archetype&& obj);
         void clear();
 
-        // Transfer entity's data to new Archetype by only copying valid data
-        void transferEntity(Entity entity, Archetype& newArch);
+        // Transfer entity's data to new Archetype by moving the types both have. Other types
+        // of newArch get default data, except constructed which the caller emplaces itself
+        void transferEntity(Entity entity, Archetype& newArch, const char* constructed = nullptr);
 
         // Archetype's manipulation itself
 
@@ -37,8 +64,42 @@ namespace ECS
         template <typename T>
         void removeType(const IDGenerator& generator);
         template <typename T>
+        void addSharedType(const IDGenerator& generator, std::shared_ptr<SharedPool<T>> pool);
+        // Add T stored with a previous-frame copy (see BufferedComponent.hpp)
+        template <typename T>
+        void addBufferedType(const IDGenerator& generator);
+        template <typename T>
         bool haveType() const;
-        Identifier getIdentifier() const;
+        // Runtime component types (see RawComponent.hpp), known by their interned name
+        void addRawType(const char* name, ComponentType type, const RawComponentInfo& info);
+        void removeRawType(const char* name, ComponentType type);
+        bool haveRawType(const char* name) const;
+        // Column of runtime type name, element i belongs to getEntities()[i]
+        RawComponentVector& getRawVector(const char* name);
+        const Identifier& getIdentifier() const;
+        // Approximate heap memory owned by the archetype
+        std::size_t getByteSize() const;
+        // Memory allocated in component vectors for elements that do not exist yet
+        std::size_t getWastedBytes() const;
+        // Shrink component vectors wasting at least minWastedBytes
+        void shrinkToFit(std::size_t minWastedBytes);
+        // Make room for capacity entities in the entity list and every component vector
+        void reserve(std::size_t capacity);
+
+        // Cold storage
+
+        // Move the trivially copyable columns to one buffer, LZ compressed if compress
+        // and the result is smaller, and free their vectors. Entities must not join,
+        // leave or be accessed until unpack()
+        void pack(bool compress);
+        // Restore the packed columns, rows keep their order
+        void unpack();
+        bool isPacked() const;
+        // Bytes of the packed buffer, 0 if not packed
+        std::size_t getPackedSize() const;
+        // Decompress the packed column of type name into out, laid out as getRawColumn() gives
+        // it, leaving the archetype packed. False if the column is not packed
+        bool readPackedColumn(const char* name, std::vector<uint8_t, AlignedAllocator<uint8_t>>& out) const;
 
         // Entities' data manupulation
 
@@ -46,25 +107,123 @@ namespace ECS
         T& getComponent(Entity entity);
         template <typename T>
         const T& getComponent(Entity entity) const;
+        // Return the stored value, nullptr if the archetype has no T column
         template <typename T>
-        void setComponent(Entity entity, const T&& component);
+        T* setComponent(Entity entity, T&& component);
         template <typename T>
-        void setComponent(Entity entity, const T& component);
+        T* setComponent(Entity entity, const T& component);
+        // Construct entity's T from args, the entity must be the only one without T data
+        // (see transferEntity)
+        template <typename T, typename... Args>
+        T& emplaceComponent(Entity entity, Args&&... args);
+        template <typename T>
+        const T& getSharedComponent(Entity entity) const;
+        template <typename T>
+        void setSharedComponent(Entity entity, const T& component);
+        // Call fn(const T& value, const uint32_t* rows, std::size_t count) once per distinct
+        // shared value, rows ascending and indexing getEntities() and getColumns()
+        template <typename T, typename Fn>
+        void forEachSharedGroup(Fn fn) const;
+        // Call fn(std::size_t count, Ts*... columns) for every chunk of at most CHUNK_SIZE entities
+        // Columns are aligned to COMPONENT_ALIGNMENT and readable/writable up to the next multiple of it
+        // Rows are reported written (see markRowsDirty) except in columns of const types
+        template <typename... Ts, typename Fn>
+        void forEachChunk(Fn fn);
+        // Start of the component vectors of Ts, element i belongs to getEntities()[i]. Ts may be
+        // const. Nothing is reported written, writes to buffered columns must be reported with
+        // markRowsDirty(). All nullptr if a column cannot be given
+        template <typename... Ts>
+        std::tuple<Ts*...> getColumns();
+        template <typename... Ts>
+        std::tuple<const Ts*...> getColumns() const;
+        // Report a write to entity's T through a reference, for buffered columns
+        template <typename T>
+        void markDirty(Entity entity);
+        // Report writes to rows [begin, begin + count) of the columns of Ts, for buffered
+        // columns. Const types are skipped
+        template <typename... Ts>
+        void markRowsDirty(std::size_t begin, std::size_t count);
 
         // Also keep track of inside entities
 
         void removeEntity(Entity entity);
-        void addEntity(Entity entity);
-        const std::unordered_set<Entity>& getEntities() const;
+        // False, adding nothing, if a component type is not default constructible
+        bool addEntity(Entity entity);
+        // Add entities with a copy of every component of sourceEntity in source,
+        // source must have all component types of this archetype
+        // False, adding nothing, if a component type is not copyable or missing from source
+        bool addEntities(const std::vector<Entity>& entities, const Archetype& source, Entity sourceEntity);
+        // Whether every component vector can be copied by addEntities()
+        bool isCopyable() const;
+        // Entities in the order of their data in component vectors
+        const std::vector<Entity>& getEntities() const;
+        // Table the archetype keeps up to date with [entity] = position in getEntities(),
+        // shared by every archetype of an engine
+        void setRowTable(uint32_t* rows);
+        // Move every entity of source, an archetype with the same component types, to this one
+        // Entity e of source becomes remap[e], source is left empty
+        void appendFrom(Archetype& source, const std::vector<Entity>& remap);
+        // Add the column of type-erased type name, vec being an empty vector storing it
+        void addVector(const char* name, ComponentType type, std::shared_ptr<IComponentVector> vec);
+        // [type name] = component vector, for type-erased access
+        const std::unordered_map<const char*, std::shared_ptr<IComponentVector>>& getVectors() const;
+
+        // Row order
+
+        // Reorder rows by keyFn(const T&) ascending, T must not be shared. Integer keys are radix
+        // sorted, other keys need operator <. If incremental, only rows out of place are sorted
+        // and merged back, which is cheaper when there are few of them (see RowSort.hpp)
+        template <typename T, typename KeyFn>
+        void sortBy(KeyFn keyFn, bool incremental = false);
+        // Move row order[i] to row i in every component vector
+        void permute(const std::vector<uint32_t>& order);
+        // False from the time entities join or leave the archetype, or invalidateOrder()
+        // is called, until the next sortBy() or permute()
+        bool isOrdered() const;
+        void invalidateOrder();
     private:
+        // row is entity's position in mEntities
+        void removeEntity(Entity entity, uint32_t row);
+        // Vector of T, nullptr once a check failed if T was not added or is shared, or if
+        // the archetype is packed
         template <typename T>
-        ComponentVector<T>& getComponentVector();
+        ComponentVector<T>* getComponentVector();
         template <typename T>
-        const ComponentVector<T>& getComponentVector() const;
+        const ComponentVector<T>* getComponentVector() const;
+        // entity's element of vec found through the row table, nullptr once a check failed if
+        // the row is not entity's
+        template <typename T>
+        const T* getElement(const ComponentVector<T>& vec, Entity entity) const;
+        // nullptr once a check failed if T was not added or is not shared
+        template <typename T>
+        SharedComponentVector<T>* getSharedVector() const;
+        template <typename T>
+        void markColumnDirty(std::size_t begin, std::size_t count);
+        // Failure of getComponentVector(), out of line so the query stays small enough to inline
+        ECS_COLD void reportVectorQuery(const char* name, bool added) const;
     private:
+        // Place of a column in mPacked
+        struct PackedColumn
+        {
+            const char* name;
+            std::size_t elementSize;
+            std::size_t offset;
+            // Bytes in mPacked, elementSize * entity count if not compressed
+            std::size_t size;
+            bool compressed;
+        };
+        // Restore packed's elements to out, sized for them. shuffled is scratch
+        void readPackedColumn(const PackedColumn& packed, std::vector<uint8_t, AlignedAllocator<uint8_t>>& out, std::vector<uint8_t>& shuffled) const;
+
         std::unordered_map<const char*, std::shared_ptr<IComponentVector>> mVectors;
         Identifier mID;
-        std::unordered_set<Entity> mEntities;
+        std::vector<Entity> mEntities;
+        uint32_t* mRows;
+        bool mOrdered;
+        bool mIsPacked;
+        // Columns in the order of their names, so the buffer is the same on every run
+        std::vector<PackedColumn> mPackedColumns;
+        std::vector<uint8_t> mPacked;
     };
 
     template <typename T>
@@ -83,6 +242,28 @@ namespace ECS
         mID.setType(generator.getType<T>());
     }
 
+    template <typename T>
+    void Archetype::addSharedType(const IDGenerator& generator, std::shared_ptr<SharedPool<T>> pool)
+    {
+        ECS_ASSERT(haveType<T>() == false, ((std::string)"Component type " + (typeid(T).name()) + " added twice in archetype"));
+
+        const char* name = typeid(T).name();
+        auto vec = std::make_shared<SharedComponentVector<T>>(std::move(pool));
+        vec->setRowTable(mRows);
+        mVectors.emplace(name, std::move(vec));
+        mID.setType(generator.getType<T>());
+    }
+
+    template <typename T>
+    void Archetype::addBufferedType(const IDGenerator& generator)
+    {
+        ECS_ASSERT(haveType<T>() == false, ((std::string)"Component type " + (typeid(T).name()) + " added twice in archetype"));
+
+        const char* name = typeid(T).name();
+        mVectors.emplace(name, std::make_shared<BufferedComponentVector<T>>());
+        mID.setType(generator.getType<T>());
+    }
+
     template <typename T>
     void Archetype::removeType(const IDGenerator& generator)
     {
@@ -94,49 +275,186 @@ namespace ECS
     }
 
     template <typename T>
-    ComponentVector<T>& Archetype::getComponentVector()
+    ComponentVector<T>* Archetype::getComponentVector()
     {
-        return *std::dynamic_pointer_cast<ComponentVector<T>>(mVectors[typeid(T).name()]);
+        return const_cast<ComponentVector<T>*>(static_cast<const Archetype*>(this)->getComponentVector<T>());
     }
 
     template <typename T>
-    const ComponentVector<T>& Archetype::getComponentVector() const
+    const ComponentVector<T>* Archetype::getComponentVector() const
     {
-        const char* name = typeid(T).name();
-        ECS_ASSERT(mVectors.find(name) != mVectors.end(), ((std::string)"Component type " + (typeid(T).name()) + " was not added in archetype but query vector reference"));
-        return *std::dynamic_pointer_cast<ComponentVector<T>>(mVectors.at(name));
+        // One lookup serves the checks and the access. A shared vector must not be cast and
+        // a packed one has no elements, so these checks stay in release builds
+        auto found = mVectors.find(typeid(T).name());
+        if (ECS_LIKELY(found != mVectors.end() && found->second->isShared() == false && mIsPacked == false))
+            return static_cast<const ComponentVector<T>*>(found->second.get());
+        reportVectorQuery(typeid(T).name(), found != mVectors.end());
+        return nullptr;
+    }
+
+    template <typename T>
+    const T* Archetype::getElement(const ComponentVector<T>& vec, Entity entity) const
+    {
+        uint32_t row = mRows[entity];
+        ECS_ASSERT_OR_RETURN(row < vec.getSize() && mEntities[row] == entity, ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name())), nullptr);
+        return vec.data() + row;
     }
 
     template <typename T>
     T& Archetype::getComponent(Entity entity)
     {
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not added to archetype but query component data of entity " + std::to_string(entity)));
-        return getComponentVector<T>()[entity];
+        return const_cast<T&>(static_cast<const Archetype*>(this)->getComponent<T>(entity));
     }
 
     template <typename T>
     const T& Archetype::getComponent(Entity entity) const
     {
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not added to archetype but query component data of entity " + std::to_string(entity)));
-        return getComponentVector<T>()[entity];
+        const ComponentVector<T>* vec = getComponentVector<T>();
+        const T* element = vec != nullptr ? getElement(*vec, entity) : nullptr;
+        return element != nullptr ? *element : getFallbackElement<T>();
+    }
+
+    template <typename T>
+    T* Archetype::setComponent(Entity entity, const T& component)
+    {
+        ComponentVector<T>* vec = getComponentVector<T>();
+        T* stored = vec != nullptr ? const_cast<T*>(getElement(*vec, entity)) : nullptr;
+        if (stored == nullptr)
+            return nullptr;
+        *stored = component;
+        vec->markDirty(mRows[entity], 1);
+        return stored;
     }
 
     template <typename T>
-    void Archetype::setComponent(Entity entity, const T& component)
+    T* Archetype::setComponent(Entity entity, T&& component)
     {
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not added to archetype but query assignment of entity " + std::to_string(entity)));
-        auto& vec = getComponentVector<T>();
-        vec.removeData(entity);
-        vec.addData(entity, component);
+        ComponentVector<T>* vec = getComponentVector<T>();
+        T* stored = vec != nullptr ? const_cast<T*>(getElement(*vec, entity)) : nullptr;
+        if (stored == nullptr)
+            return nullptr;
+        *stored = std::move(component);
+        vec->markDirty(mRows[entity], 1);
+        return stored;
     }
 
     template <typename T>
-    void Archetype::setComponent(Entity entity, const T&& component)
+    void Archetype::markDirty(Entity entity)
     {
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not added to archetype but query assignment of entity " + std::to_string(entity)));
-        auto& vec = getComponentVector<T>();
-        vec.removeData(entity);
-        vec.addData(entity, component);
+        if (ComponentVector<T>* vec = getComponentVector<T>())
+            vec->markDirty(mRows[entity], 1);
+    }
+
+    template <typename T, typename... Args>
+    T& Archetype::emplaceComponent(Entity entity, Args&&... args)
+    {
+        // getComponentVector checks that T was added
+        ComponentVector<T>* vec = getComponentVector<T>();
+        if (vec == nullptr)
+            return getFallbackElement<T>();
+        ECS_ASSERT(vec->getSize() + 1 == mEntities.size() && mEntities[mRows[entity]] == entity, ((std::string)"Component type " + (typeid(T).name()) + " emplaced for entity " + std::to_string(entity) + " out of its row"));
+        return vec->emplaceData(entity, std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    SharedComponentVector<T>* Archetype::getSharedVector() const
+    {
+        auto found = mVectors.find(typeid(T).name());
+        ECS_ASSERT_OR_RETURN(found != mVectors.end(), ((std::string)"Shared component type " + (typeid(T).name()) + " was not added in archetype but query vector reference"), nullptr);
+        auto res = dynamic_cast<SharedComponentVector<T>*>(found->second.get());
+        ECS_ASSERT_OR_RETURN(res != nullptr, ((std::string)"Component type " + (typeid(T).name()) + " is not shared"), nullptr);
+        return res;
+    }
+
+    template <typename T>
+    const T& Archetype::getSharedComponent(Entity entity) const
+    {
+        const SharedComponentVector<T>* vec = getSharedVector<T>();
+        return vec != nullptr ? vec->getValue(entity) : getFallbackElement<T>();
+    }
+
+    template <typename T>
+    void Archetype::setSharedComponent(Entity entity, const T& component)
+    {
+        if (SharedComponentVector<T>* vec = getSharedVector<T>())
+            vec->setValue(entity, component);
+    }
+
+    template <typename T, typename Fn>
+    void Archetype::forEachSharedGroup(Fn fn) const
+    {
+        if (const SharedComponentVector<T>* vec = getSharedVector<T>())
+            vec->forEachGroup(fn);
+    }
+
+    template <typename... Ts, typename Fn>
+    void Archetype::forEachChunk(Fn fn)
+    {
+        static_assert(sizeof...(Ts) > 0, "forEachChunk needs at least one component type");
+        ECS_ASSERT((haveType<Ts>() && ...), "Chunk iteration over component types not all added to archetype");
+        std::tuple<Ts*...> columns = getColumns<Ts...>();
+        if (std::get<0>(columns) == nullptr)
+            return;
+        std::size_t size = mEntities.size();
+        markRowsDirty<Ts...>(0, size);
+        for (std::size_t begin = 0; begin < size; begin += CHUNK_SIZE)
+            fn(std::min(CHUNK_SIZE, size - begin), (std::get<Ts*>(columns) + begin)...);
+    }
+
+    template <typename... Ts>
+    std::tuple<Ts*...> Archetype::getColumns()
+    {
+        std::tuple<const Ts*...> columns = static_cast<const Archetype*>(this)->getColumns<Ts...>();
+        return std::tuple<Ts*...>(const_cast<Ts*>(std::get<const Ts*>(columns))...);
+    }
+
+    template <typename... Ts>
+    std::tuple<const Ts*...> Archetype::getColumns() const
+    {
+        ECS_ASSERT((haveType<std::remove_const_t<Ts>>() && ...), "Columns of component types not all added to archetype queried");
+        std::tuple<const ComponentVector<std::remove_const_t<Ts>>*...> vectors(getComponentVector<std::remove_const_t<Ts>>()...);
+        if (((std::get<const ComponentVector<std::remove_const_t<Ts>>*>(vectors) == nullptr) || ...))
+            return std::tuple<const Ts*...>();
+        return std::tuple<const Ts*...>(std::get<const ComponentVector<std::remove_const_t<Ts>>*>(vectors)->data()...);
+    }
+
+    template <typename... Ts>
+    void Archetype::markRowsDirty(std::size_t begin, std::size_t count)
+    {
+        (markColumnDirty<Ts>(begin, count), ...);
+    }
+
+    template <typename T>
+    void Archetype::markColumnDirty(std::size_t begin, std::size_t count)
+    {
+        if constexpr (std::is_const_v<T> == false)
+            if (ComponentVector<T>* vec = getComponentVector<T>())
+                vec->markDirty(begin, count);
+    }
+
+    template <typename T, typename KeyFn>
+    void Archetype::sortBy(KeyFn keyFn, bool incremental)
+    {
+        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not added to archetype but used as sort key"));
+        // Shared types have no column to sort by
+        const ComponentVector<T>* vec = getComponentVector<T>();
+        if (vec == nullptr)
+            return;
+        using Key = std::decay_t<decltype(keyFn(std::declval<const T&>()))>;
+        const T* column = vec->data();
+        std::vector<Key> keys;
+        keys.reserve(mEntities.size());
+        for (std::size_t i = 0; i < mEntities.size(); ++i)
+            keys.push_back(keyFn(column[i]));
+
+        std::vector<uint32_t> order = incremental ? resortRows(keys) : sortRows(keys);
+        for (uint32_t i = 0; i < order.size(); ++i)
+            if (order[i] != i)
+            {
+                permute(order);
+                return;
+            }
+        mOrdered = true;
     }
 }
 
@@ -1,13 +1,38 @@
 #ifndef ARCHETYPE_BACKTRACK_HPP
 #define ARCHETYPE_BACKTRACK_HPP
 
+/*
+* What happens when an ECS_ASSERT check fails.
+* Every failure is counted, then handed to the
+* check handler. The default one prints the
+* message and the call stack, then exits in
+* debug mode; in checked mode it reports the
+* first CHECK_REPORT_LIMIT failures and lets
+* the program go on
+*/
+
 #include "Macros.hpp"
 
+#include <cstdint>
+#include <string>
+
 namespace ECS
 {
-    #ifdef ARCHETYPE_DEBUG
-    // Print the explanation and collective data in case the library intrusively calls "exit(-1)"
+    #if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+    // Failures the default handler of checked mode prints, later ones are only counted
+    constexpr uint64_t CHECK_REPORT_LIMIT = 16;
+
+    using CheckHandler = void (*)(const std::string& message, const char* function, const char* file, int line);
+
+    // Print the call stack of the caller
     void ARCHETYPE_API printStackTrace();
+    // nullptr restores the default handler, the handler may be called from any thread
+    void ARCHETYPE_API setCheckHandler(CheckHandler handler);
+    // Failed checks since the start of the program or the last reset, thread-safe
+    uint64_t ARCHETYPE_API getCheckFailureCount();
+    void ARCHETYPE_API resetCheckFailureCount();
+    // Count the failure and call the handler, used by ECS_ASSERT
+    void ARCHETYPE_API reportCheckFailure(const std::string& message, const char* function, const char* file, int line);
     #endif
 }
 
@@ -0,0 +1,193 @@
+#ifndef ARCHETYPE_BUFFEREDCOMPONENT_HPP
+#define ARCHETYPE_BUFFEREDCOMPONENT_HPP
+
+/*
+* Double-buffered component storage, for threads
+* reading the state of the previous frame (render,
+* audio, networking) while the simulation writes
+* the current one.
+* A buffered vector keeps a second copy of its
+* elements and entities as of the last frame
+* boundary. At the boundary the two are flipped,
+* then the new current buffer is brought up to date
+* by copying only the chunks of BUFFERED_CHUNK_SIZE
+* rows that changed during the frame:
+*
+*   frame N     :   writers -> current      readers -> previous
+*   boundary    :   swap(current, previous)
+*                   current[dirty chunks] = previous[dirty chunks]
+*
+* Rows are dirty when entities join, leave or move
+* within the vector, and when markDirty() reports
+* a write. The previous buffer is never touched
+* between two boundaries
+*/
+
+#include "ComponentVector.hpp"
+
+#include <algorithm>
+
+namespace ECS
+{
+    // Rows sharing one dirty flag
+    constexpr std::size_t BUFFERED_CHUNK_SIZE = 1024;
+
+    // Type-erased side of BufferedComponentVector
+    class IBufferedVector
+    {
+    public:
+        virtual ~IBufferedVector() = default;
+        // Make the current elements the previous ones, then bring the current buffer up to
+        // date. Returns the number of elements copied
+        virtual std::size_t swapBuffers() = 0;
+        // Elements as of the last swapBuffers(), element i belonging to getPreviousEntities()[i]
+        virtual std::size_t getPreviousSize() const = 0;
+        virtual const Entity* getPreviousEntities() const = 0;
+        virtual const void* getPreviousData() const = 0;
+    };
+
+    // A component vector with a previous-frame copy of its elements, T must be copyable
+    template <typename T>
+    class BufferedComponentVector : public ComponentVector<T>, public IBufferedVector
+    {
+    public:
+        BufferedComponentVector();
+        std::shared_ptr<IComponentVector> createClone() const override;
+        void removeEntity(Entity entity) override;
+        void appendFrom(IComponentVector& source, const std::vector<Entity>& remap) override;
+        void permute(const std::vector<uint32_t>& order) override;
+        void assignRawColumn(const std::vector<Entity>& entities, const void* data) override;
+        void markDirty(std::size_t begin, std::size_t count) override;
+        std::size_t getByteSize() const override;
+
+        std::size_t swapBuffers() override;
+        std::size_t getPreviousSize() const override;
+        const Entity* getPreviousEntities() const override;
+        const void* getPreviousData() const override;
+    private:
+        std::vector<T, AlignedAllocator<T>> mPrevious;
+        std::vector<Entity> mPreviousEntities;
+        // [chunk] = rows of the chunk written or moved since the last swap
+        std::vector<bool> mDirty;
+        // Rows from this one on may all differ from the other buffer
+        std::size_t mMinSize;
+    };
+
+    template <typename T>
+    BufferedComponentVector<T>::BufferedComponentVector()
+        : mMinSize(0)
+    { }
+
+    template <typename T>
+    std::shared_ptr<IComponentVector> BufferedComponentVector<T>::createClone() const
+    {
+        return std::make_shared<BufferedComponentVector<T>>();
+    }
+
+    template <typename T>
+    void BufferedComponentVector<T>::removeEntity(Entity entity)
+    {
+        const void* data = this->getRawData(entity);
+        if (data == nullptr)
+            return;
+        // The last element takes the removed one's row
+        markDirty(static_cast<const T*>(data) - this->mContainer.data(), 1);
+        ComponentVector<T>::removeEntity(entity);
+        mMinSize = std::min(mMinSize, this->mContainer.size());
+    }
+
+    template <typename T>
+    void BufferedComponentVector<T>::appendFrom(IComponentVector& source, const std::vector<Entity>& remap)
+    {
+        ComponentVector<T>::appendFrom(source, remap);
+        // source comes from another engine, which may store T without buffering
+        if (auto* buffered = dynamic_cast<BufferedComponentVector<T>*>(&source))
+            buffered->mMinSize = 0;
+    }
+
+    template <typename T>
+    void BufferedComponentVector<T>::permute(const std::vector<uint32_t>& order)
+    {
+        ComponentVector<T>::permute(order);
+        mMinSize = 0;
+    }
+
+    template <typename T>
+    void BufferedComponentVector<T>::assignRawColumn(const std::vector<Entity>& entities, const void* data)
+    {
+        ComponentVector<T>::assignRawColumn(entities, data);
+        mMinSize = 0;
+    }
+
+    template <typename T>
+    void BufferedComponentVector<T>::markDirty(std::size_t begin, std::size_t count)
+    {
+        if (count == 0)
+            return;
+        std::size_t last = (begin + count - 1) / BUFFERED_CHUNK_SIZE;
+        if (mDirty.size() <= last)
+            mDirty.resize(last + 1, false);
+        for (std::size_t chunk = begin / BUFFERED_CHUNK_SIZE; chunk <= last; ++chunk)
+            mDirty[chunk] = true;
+    }
+
+    template <typename T>
+    std::size_t BufferedComponentVector<T>::getByteSize() const
+    {
+        return ComponentVector<T>::getByteSize() + AlignedAllocator<T>::getPaddedSize(mPrevious.capacity())
+            + mPreviousEntities.capacity() * sizeof(Entity) + mDirty.capacity() / 8;
+    }
+
+    template <typename T>
+    std::size_t BufferedComponentVector<T>::swapBuffers()
+    {
+        auto& current = this->mContainer;
+        auto& entities = this->mInOut;
+        current.swap(mPrevious);
+        entities.swap(mPreviousEntities);
+
+        // current now holds the elements of two boundaries ago, stale past the stable rows
+        // and in the chunks dirtied since the last boundary
+        std::size_t size = mPrevious.size();
+        std::size_t stable = std::min({ mMinSize, current.size(), size });
+        current.erase(current.begin() + stable, current.end());
+        entities.erase(entities.begin() + stable, entities.end());
+        current.insert(current.end(), mPrevious.begin() + stable, mPrevious.end());
+        entities.insert(entities.end(), mPreviousEntities.begin() + stable, mPreviousEntities.end());
+        std::size_t res = size - stable;
+        for (std::size_t chunk = 0; chunk < mDirty.size() && chunk * BUFFERED_CHUNK_SIZE < stable; ++chunk)
+        {
+            if (mDirty[chunk] == false)
+                continue;
+            std::size_t begin = chunk * BUFFERED_CHUNK_SIZE;
+            std::size_t end = std::min(stable, begin + BUFFERED_CHUNK_SIZE);
+            std::copy(mPrevious.begin() + begin, mPrevious.begin() + end, current.begin() + begin);
+            std::copy(mPreviousEntities.begin() + begin, mPreviousEntities.begin() + end, entities.begin() + begin);
+            res += end - begin;
+        }
+        // Both buffers hold the same rows, so the entity mapping is still right
+        mDirty.assign(mDirty.size(), false);
+        mMinSize = size;
+        return res;
+    }
+
+    template <typename T>
+    std::size_t BufferedComponentVector<T>::getPreviousSize() const
+    {
+        return mPrevious.size();
+    }
+
+    template <typename T>
+    const Entity* BufferedComponentVector<T>::getPreviousEntities() const
+    {
+        return mPreviousEntities.data();
+    }
+
+    template <typename T>
+    const void* BufferedComponentVector<T>::getPreviousData() const
+    {
+        return mPrevious.data();
+    }
+}
+
+#endif // ARCHETYPE_BUFFEREDCOMPONENT_HPP
@@ -0,0 +1,68 @@
+#ifndef ARCHETYPE_COLUMNEXPORT_HPP
+#define ARCHETYPE_COLUMNEXPORT_HPP
+
+/*
+* Columnar dump of component data, written by
+* Engine::exportColumns() straight from the
+* component vectors: one batch per archetype, one
+* contiguous block per column. All numbers are in
+* the machine's byte order:
+*
+*   header  :   "ECSC" | version u32 | type count u32
+*   schema  :   per type: element size u32 | name length u32 | name
+*   batch   :   row count u32 | column count u32 | entities (row count x u32)
+*               then per column: type position in schema u32 | byte length u64 | bytes
+*   end     :   row count 0xFFFFFFFF
+*
+* Entity and column blocks start at offsets that
+* are multiples of BLOCK_ALIGNMENT (zero padding),
+* so a reader can map the file and cast them.
+* Type names are those of typeid(T).name(), only
+* trivially copyable, non-shared components are
+* exported
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+
+#include <vector>
+
+namespace ECS
+{
+    constexpr uint32_t COLUMN_EXPORT_VERSION = 1;
+    // Batch row count marking the end of a dump
+    constexpr uint32_t COLUMN_EXPORT_END = UINT32_MAX;
+
+    // Buffered writer of small values to a file descriptor, large blocks are written
+    // directly from their memory
+    class ARCHETYPE_API ColumnWriter
+    {
+    public:
+        static constexpr std::size_t BLOCK_ALIGNMENT = 8;
+
+        explicit ColumnWriter(int fd);
+        template <typename T>
+        void writeValue(const T& value);
+        void writeBytes(const void* data, std::size_t size);
+        // Pad the stream to BLOCK_ALIGNMENT then write data without copying it
+        void writeBlock(const void* data, std::size_t size);
+        // Write what is buffered, returns false if any write failed
+        bool flush();
+    private:
+        bool writeRaw(const void* data, std::size_t size);
+    private:
+        int mFd;
+        std::vector<char> mBuffer;
+        // Bytes written or buffered so far
+        uint64_t mOffset;
+        bool mFailed;
+    };
+
+    template <typename T>
+    void ColumnWriter::writeValue(const T& value)
+    {
+        writeBytes(&value, sizeof(T));
+    }
+}
+
+#endif // ARCHETYPE_COLUMNEXPORT_HPP
@@ -0,0 +1,84 @@
+#ifndef ARCHETYPE_COMMANDBUFFER_HPP
+#define ARCHETYPE_COMMANDBUFFER_HPP
+
+/*
+* Structural changes recorded while iterating and
+* applied to an Engine later, in the order they
+* were recorded. Entities created through a buffer
+* get a pending ID usable by the later commands of
+* the same buffer; their engine IDs are assigned
+* when the buffer is applied, so they only depend
+* on the order buffers are applied in:
+*
+*   record  :   p = createEntity(); addComponent(p, v)
+*   apply   :   e = engine.createEntity(); engine.addComponent(e, v)
+*/
+
+#include "Engine.hpp"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ECS
+{
+    // Set in the IDs returned by CommandBuffer::createEntity()
+    constexpr Entity PENDING_ENTITY_BIT = 0x80000000u;
+
+    class ARCHETYPE_API CommandBuffer
+    {
+    public:
+        CommandBuffer();
+        // Pending ID of an entity created when the buffer is applied
+        Entity createEntity();
+        void destroyEntity(Entity entity);
+        template <typename T>
+        void addComponent(Entity entity, T component);
+        template <typename T>
+        void setComponent(Entity entity, T component);
+        template <typename T>
+        void removeComponent(Entity entity);
+        // Run the commands in record order and clear the buffer. Returns the entities
+        // created, [i] being the one of the i-th createEntity() call
+        std::vector<Entity> apply(Engine& engine);
+        bool empty() const;
+        void clear();
+        static bool isPending(Entity entity);
+    private:
+        // Engine ID of entity, created holding the entities created so far
+        static Entity resolve(Entity entity, const std::vector<Entity>& created);
+    private:
+        std::vector<std::function<void(Engine&, std::vector<Entity>&)>> mCommands;
+        // Number of createEntity() calls since the last apply() or clear()
+        uint32_t mCreated;
+    };
+
+    template <typename T>
+    void CommandBuffer::addComponent(Entity entity, T component)
+    {
+        mCommands.push_back([entity, component = std::move(component)](Engine& engine, std::vector<Entity>& created)
+        {
+            engine.addComponent<T>(resolve(entity, created), component);
+        });
+    }
+
+    template <typename T>
+    void CommandBuffer::setComponent(Entity entity, T component)
+    {
+        mCommands.push_back([entity, component = std::move(component)](Engine& engine, std::vector<Entity>& created)
+        {
+            engine.setComponent<T>(resolve(entity, created), component);
+        });
+    }
+
+    template <typename T>
+    void CommandBuffer::removeComponent(Entity entity)
+    {
+        mCommands.push_back([entity](Engine& engine, std::vector<Entity>& created)
+        {
+            engine.removeComponent<T>(resolve(entity, created));
+        });
+    }
+}
+
+#endif // ARCHETYPE_COMMANDBUFFER_HPP
@@ -5,32 +5,106 @@
 * A component vector consists of 2 parts:
 * an inner dense vector and a mapping from 
 * entities to inner vector's indices.
-* Will be used by Archetypes
+* Will be used by Archetypes.
+* Elements of every vector of an archetype are
+* kept in the same order, so index i refers to
+* the same entity in all of them.
+* Values are moved rather than copied whenever
+* possible, so move-only types can be stored;
+* only default construction (addDefaultData) and
+* bulk copies (fillData) need more
 */
 
 #include "Macros.hpp"
 #include "Properties.hpp"
+#include "AlignedAllocator.hpp"
 
+#include <iterator>
 #include <vector>
 #include <unordered_map>
 #include <cassert>
+#include <cstdlib>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 namespace ECS
 {
+    // Element handed out in place of one that does not exist, once the check reporting it
+    // failed, so checked builds carry on without touching memory out of any vector. Its value
+    // is meaningless. Types that cannot be default constructed end the program instead
+    template <typename T>
+    T& getFallbackElement()
+    {
+        if constexpr (std::is_default_constructible_v<T>)
+        {
+            static thread_local T fallback{};
+            return fallback;
+        }
+        else
+            std::abort();
+    }
+
     // Base class for template ComponentVector
     class ARCHETYPE_API IComponentVector
     {
     public:
         IComponentVector();
+        // shared for vectors holding handles to shared values (see SharedComponent.hpp)
+        explicit IComponentVector(bool shared);
         virtual ~IComponentVector();
+        // Not a vector of T even though it stores T, for accessors to reject it
+        bool isShared() const;
         virtual void removeEntity(Entity entity) = 0;
         virtual void addDefaultData(Entity entity) = 0;
         virtual std::shared_ptr<IComponentVector> createClone() const = 0;
-        virtual void overwriteData(Entity entity, std::shared_ptr<IComponentVector> newVec) = 0;
+        // Append entity's data to newVec, a vector of the same type. What is left here
+        // is moved-from and must be removed afterwards
+        virtual void moveData(Entity entity, IComponentVector& newVec) = 0;
+        // Append count entities all holding a copy of sourceEntity's data in source, a vector of the same type
+        virtual void fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity) = 0;
+        // Address of entity's data, nullptr if there is none
+        virtual const void* getRawData(Entity entity) const = 0;
+        // Move every element of source, a vector of the same type, to the end of this one
+        // Entity e of source becomes remap[e], source is left empty
+        virtual void appendFrom(IComponentVector& source, const std::vector<Entity>& remap) = 0;
+        // Engine's [entity] = row table, for shared component vectors which store their
+        // handles by row. Ignored by other vectors
+        virtual void setRowTable(const uint32_t* rows) = 0;
+        // Move element order[i] to position i, order being a permutation of the positions
+        virtual void permute(const std::vector<uint32_t>& order) = 0;
+        // Dense elements as raw bytes, false if they cannot be copied as such
+        // (types that are not trivially copyable, shared vectors)
+        virtual bool getRawColumn(const void*& data, std::size_t& elementSize) const = 0;
+        // Approximate heap memory owned by the vector
+        virtual std::size_t getByteSize() const = 0;
+        // Memory allocated for elements that do not exist yet
+        virtual std::size_t getWastedBytes() const = 0;
+        // Release memory not used by current elements
+        virtual void shrinkToFit() = 0;
+        // Make room for capacity elements so they are added without reallocation
+        virtual void reserve(std::size_t capacity) = 0;
+        // Replace every element by entities.size() elements copied from data, laid out as
+        // getRawColumn() gives them and aligned to COMPONENT_ALIGNMENT, entities[i] owning
+        // element i. Only for vectors whose getRawColumn() succeeds
+        virtual void assignRawColumn(const std::vector<Entity>& entities, const void* data) = 0;
+        // Elements [begin, begin + count) may have been written through a pointer or reference,
+        // for vectors tracking changes (see BufferedComponent.hpp)
+        virtual void markDirty(std::size_t begin, std::size_t count) = 0;
+        // Whether fillData() and addDefaultData() can create elements. They add nothing
+        // otherwise, so callers check every vector before adding an entity to any
+        virtual bool isCopyable() const = 0;
+        virtual bool isDefaultConstructible() const = 0;
+    private:
+        bool mShared;
     };
 
+    inline bool IComponentVector::isShared() const
+    {
+        return mShared;
+    }
+
     // A Component vector can store data tightly packed data and allow query by entity ID
     template<typename T>
     class ComponentVector : public IComponentVector
@@ -41,20 +115,42 @@ namespace ECS
         std::shared_ptr<IComponentVector> createClone() const override;
         void removeEntity(Entity entity) override;
         void addDefaultData(Entity entity) override;
-        // Overwrite entity's data in another ComponentVector<T>
-        void overwriteData(Entity entity, std::shared_ptr<IComponentVector> newVec) override;
+        void moveData(Entity entity, IComponentVector& newVec) override;
+        void fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity) override;
+        const void* getRawData(Entity entity) const override;
+        void appendFrom(IComponentVector& source, const std::vector<Entity>& remap) override;
+        void setRowTable(const uint32_t* rows) override;
+        void permute(const std::vector<uint32_t>& order) override;
+        bool getRawColumn(const void*& data, std::size_t& elementSize) const override;
+        std::size_t getByteSize() const override;
+        std::size_t getWastedBytes() const override;
+        void shrinkToFit() override;
+        void reserve(std::size_t capacity) override;
+        void assignRawColumn(const std::vector<Entity>& entities, const void* data) override;
+        void markDirty(std::size_t begin, std::size_t count) override;
+        bool isCopyable() const override;
+        bool isDefaultConstructible() const override;
 
         // Data accesses and manipulations
 
         T& operator [](Entity);
+        const T& operator [](Entity) const;
         bool haveData(Entity entity) const;
         void addData(Entity entity, const T& data);
-        void addData(Entity entity, const T&& data);
+        void addData(Entity entity, T&& data);
+        // Construct entity's data from args in its final place
+        template <typename... Args>
+        T& emplaceData(Entity entity, Args&&... args);
         void removeData(Entity entity);
-    private:
-        std::unordered_map<Entity, Entity> mInOut;
+        // Dense elements, aligned to COMPONENT_ALIGNMENT (see AlignedAllocator)
+        T* data();
+        const T* data() const;
+        std::size_t getSize() const;
+    protected:
+        // [index] = entity, dense like mContainer
+        std::vector<Entity> mInOut;
         std::unordered_map<Entity, Entity> mOutIn;
-        std::vector<T> mContainer;
+        std::vector<T, AlignedAllocator<T>> mContainer;
     };
 
     template <typename T>
@@ -64,20 +160,201 @@ namespace ECS
     }
 
     template <typename T>
-    void ComponentVector<T>::overwriteData(Entity entity, std::shared_ptr<IComponentVector> newVec)
+    void ComponentVector<T>::moveData(Entity entity, IComponentVector& newVec)
+    {
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT_OR_RETURN(found != mOutIn.end(), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name()) + " to transfer"));
+        static_cast<ComponentVector<T>&>(newVec).emplaceData(entity, std::move(mContainer[found->second]));
+    }
+
+    template <typename T>
+    void ComponentVector<T>::fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity)
+    {
+        const auto& casted = static_cast<const ComponentVector<T>&>(source);
+        ECS_ASSERT(casted.haveData(sourceEntity), ((std::string)"No data of entity " + std::to_string(sourceEntity) + " in vector of type " + (typeid(T).name()) + " to copy"));
+        Entity first = (Entity)mContainer.size();
+        // One bulk copy-construction, a memcpy for trivially copyable types
+        if constexpr (std::is_copy_constructible_v<T>)
+            mContainer.insert(mContainer.end(), count, casted.mContainer[casted.mOutIn.at(sourceEntity)]);
+        else
+        {
+            // No element, so no mapping either
+            ECS_ASSERT(false, ((std::string)"Component type " + (typeid(T).name()) + " is not copyable but copied in bulk"));
+            return;
+        }
+        mOutIn.reserve(mOutIn.size() + count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ECS_ASSERT(haveData(entities[i]) == false, ((std::string)"Data of entity " + std::to_string(entities[i]) + " added twice in vector of type " + (typeid(T).name())));
+            mOutIn[entities[i]] = first + (Entity)i;
+        }
+        mInOut.insert(mInOut.end(), entities, entities + count);
+    }
+
+    template <typename T>
+    const void* ComponentVector<T>::getRawData(Entity entity) const
+    {
+        auto found = mOutIn.find(entity);
+        return found == mOutIn.end() ? nullptr : &mContainer[found->second];
+    }
+
+    template <typename T>
+    void ComponentVector<T>::appendFrom(IComponentVector& source, const std::vector<Entity>& remap)
+    {
+        auto& casted = static_cast<ComponentVector<T>&>(source);
+        Entity first = (Entity)mContainer.size();
+        mContainer.insert(mContainer.end(), std::make_move_iterator(casted.mContainer.begin()), std::make_move_iterator(casted.mContainer.end()));
+        mOutIn.reserve(mOutIn.size() + casted.mInOut.size());
+        mInOut.reserve(mInOut.size() + casted.mInOut.size());
+        for (std::size_t i = 0; i < casted.mInOut.size(); ++i)
+        {
+            Entity entity = remap[casted.mInOut[i]];
+            ECS_ASSERT(haveData(entity) == false, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + (typeid(T).name())));
+            mOutIn[entity] = first + (Entity)i;
+            mInOut.push_back(entity);
+        }
+        casted.mContainer.clear();
+        casted.mInOut.clear();
+        casted.mOutIn.clear();
+    }
+
+    template <typename T>
+    void ComponentVector<T>::setRowTable(const uint32_t*)
+    { }
+
+    template <typename T>
+    void ComponentVector<T>::permute(const std::vector<uint32_t>& order)
+    {
+        ECS_ASSERT(order.size() == mContainer.size(), ((std::string)"Permutation of " + std::to_string(order.size()) + " elements applied to vector of type " + (typeid(T).name()) + " holding " + std::to_string(mContainer.size())));
+        std::vector<T, AlignedAllocator<T>> sorted;
+        sorted.reserve(mContainer.capacity());
+        std::vector<Entity> entities(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            sorted.push_back(std::move(mContainer[order[i]]));
+            entities[i] = mInOut[order[i]];
+        }
+        mContainer.swap(sorted);
+        mInOut.swap(entities);
+        // Only entities whose position changed need their mapping updated
+        for (std::size_t i = 0; i < order.size(); ++i)
+            if (order[i] != i)
+                mOutIn[mInOut[i]] = (Entity)i;
+    }
+
+    template <typename T>
+    bool ComponentVector<T>::getRawColumn(const void*& data, std::size_t& elementSize) const
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            data = mContainer.data();
+            elementSize = sizeof(T);
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    std::size_t ComponentVector<T>::getByteSize() const
+    {
+        // A map node holds the pair and a next pointer, buckets are one pointer each
+        constexpr std::size_t nodeSize = sizeof(std::pair<const Entity, Entity>) + sizeof(void*);
+        return AlignedAllocator<T>::getPaddedSize(mContainer.capacity())
+            + mInOut.capacity() * sizeof(Entity)
+            + mOutIn.size() * nodeSize + mOutIn.bucket_count() * sizeof(void*);
+    }
+
+    template <typename T>
+    std::size_t ComponentVector<T>::getWastedBytes() const
+    {
+        return (mContainer.capacity() - mContainer.size()) * sizeof(T);
+    }
+
+    template <typename T>
+    void ComponentVector<T>::shrinkToFit()
+    {
+        mContainer.shrink_to_fit();
+        mInOut.shrink_to_fit();
+        mOutIn.rehash(0);
+    }
+
+    template <typename T>
+    void ComponentVector<T>::reserve(std::size_t capacity)
     {
-        ECS_ASSERT(haveData(entity), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name()) + " to transfer"));
-        std::shared_ptr<ComponentVector<T>> casted = std::dynamic_pointer_cast<ComponentVector<T>>(newVec);
-        ECS_ASSERT(casted->haveData(entity), ((std::string)"No place to overwrite entity " + std::to_string(entity) + " to new vector of type ") + (typeid(T).name()));
-        casted->removeData(entity);
-        casted->addData(entity, mContainer[mOutIn[entity]]);
+        mContainer.reserve(capacity);
+        mInOut.reserve(capacity);
+        mOutIn.reserve(capacity);
+    }
+
+    template <typename T>
+    void ComponentVector<T>::assignRawColumn(const std::vector<Entity>& entities, const void* data)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            mContainer.clear();
+            mInOut.clear();
+            mOutIn.clear();
+            if (entities.empty())
+                return;
+            const T* first = static_cast<const T*>(data);
+            mContainer.assign(first, first + entities.size());
+            mInOut = entities;
+            mOutIn.reserve(entities.size());
+            for (std::size_t i = 0; i < entities.size(); ++i)
+                mOutIn.emplace(entities[i], (Entity)i);
+        }
+        else
+            ECS_ASSERT(false, ((std::string)"Component type " + (typeid(T).name()) + " is not trivially copyable but assigned raw bytes"));
+    }
+
+    template <typename T>
+    void ComponentVector<T>::markDirty(std::size_t, std::size_t)
+    { }
+
+    template <typename T>
+    bool ComponentVector<T>::isCopyable() const
+    {
+        return std::is_copy_constructible_v<T>;
+    }
+
+    template <typename T>
+    bool ComponentVector<T>::isDefaultConstructible() const
+    {
+        return std::is_default_constructible_v<T>;
     }
 
     template<typename T>
     T& ComponentVector<T>::operator [](Entity entity)
     {
-        ECS_ASSERT(haveData(entity), ((std::string)((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name()))));
-        return mContainer[mOutIn[entity]];
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT_OR_RETURN(found != mOutIn.end(), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name())), getFallbackElement<T>());
+        return mContainer[found->second];
+    }
+
+    template<typename T>
+    const T& ComponentVector<T>::operator [](Entity entity) const
+    {
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT_OR_RETURN(found != mOutIn.end(), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name())), getFallbackElement<T>());
+        return mContainer[found->second];
+    }
+
+    template <typename T>
+    T* ComponentVector<T>::data()
+    {
+        return mContainer.data();
+    }
+
+    template <typename T>
+    const T* ComponentVector<T>::data() const
+    {
+        return mContainer.data();
+    }
+
+    template <typename T>
+    std::size_t ComponentVector<T>::getSize() const
+    {
+        return mContainer.size();
     }
 
     template<typename T>
@@ -89,35 +366,50 @@ namespace ECS
     template<typename T>
     void ComponentVector<T>::addData(Entity entity, const T& data)
     {
-        ECS_ASSERT(haveData(entity) == false, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + (std::string)(typeid(T).name())));
+        // One lookup both checks and maps entity
+        [[maybe_unused]] bool inserted = mOutIn.emplace(entity, (Entity)mContainer.size()).second;
+        ECS_ASSERT(inserted, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + (std::string)(typeid(T).name())));
         mContainer.push_back(data);
-        mOutIn[entity] = mContainer.size() - 1;
-        mInOut[mContainer.size() - 1] = entity;
+        mInOut.push_back(entity);
     }
 
     template<typename T>
-    void ComponentVector<T>::addData(Entity entity, const T&& data)
+    void ComponentVector<T>::addData(Entity entity, T&& data)
     {
-        ECS_ASSERT(haveData(entity) == false, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + (typeid(T).name())));
-        mContainer.push_back(data);
-        mOutIn[entity] = mContainer.size() - 1;
-        mInOut[mContainer.size() - 1] = entity;
+        emplaceData(entity, std::move(data));
+    }
+
+    template <typename T>
+    template <typename... Args>
+    T& ComponentVector<T>::emplaceData(Entity entity, Args&&... args)
+    {
+        [[maybe_unused]] bool inserted = mOutIn.emplace(entity, (Entity)mContainer.size()).second;
+        ECS_ASSERT(inserted, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + (typeid(T).name())));
+        // Aggregates have no constructor taking their members before C++20
+        if constexpr (std::is_constructible_v<T, Args&&...>)
+            mContainer.emplace_back(std::forward<Args>(args)...);
+        else
+            mContainer.push_back(T{ std::forward<Args>(args)... });
+        mInOut.push_back(entity);
+        return mContainer.back();
     }
 
     template<typename T>
     void ComponentVector<T>::removeData(Entity entity)
     {
-        ECS_ASSERT(haveData(entity), ((std::string)"Data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name()) + " not added yet but query removal"));
-        Entity rmIndex = mOutIn[entity], sze = mContainer.size(),
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT_OR_RETURN(found != mOutIn.end(), ((std::string)"Data of entity " + std::to_string(entity) + " in vector of type " + (typeid(T).name()) + " not added yet but query removal"));
+        Entity rmIndex = found->second, sze = mContainer.size(),
                swappedEntity = mInOut[sze - 1];
 
-        mContainer[rmIndex] = mContainer[sze - 1];
+        if (rmIndex != sze - 1)
+            mContainer[rmIndex] = std::move(mContainer[sze - 1]);
         mContainer.pop_back();
 
         mOutIn[swappedEntity] = rmIndex;
         mInOut[rmIndex] = swappedEntity;
 
-        mInOut.erase(sze - 1);
+        mInOut.pop_back();
         mOutIn.erase(entity);
     }
 
@@ -131,7 +423,10 @@ namespace ECS
     template<typename T>
     void ComponentVector<T>::addDefaultData(Entity entity)
     {
-        addData(entity, T());
+        if constexpr (std::is_default_constructible_v<T>)
+            emplaceData(entity);
+        else
+            ECS_ASSERT(false, ((std::string)"Component type " + (typeid(T).name()) + " is not default constructible but default data of entity " + std::to_string(entity) + " added"));
     }
 }
 
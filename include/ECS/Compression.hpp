@@ -0,0 +1,40 @@
+#ifndef ARCHETYPE_COMPRESSION_HPP
+#define ARCHETYPE_COMPRESSION_HPP
+
+/*
+* Byte-oriented LZ compression of component
+* columns, in the spirit of LZ4. A block is a
+* stream of sequences, each made of literals
+* copied as is and a match copied from up to
+* 64 KiB back in the output:
+*
+*   token   :   literal length (4 bits) | match length - 4 (4 bits)
+*   then    :   extra literal length | literals | offset u16 | extra match length
+*
+* A 4-bit length of 15 is followed by bytes added
+* to it, continued while they are 255. The last
+* sequence only has literals. Columns are
+* shuffled first: byte k of every element is
+* stored together, so fields changing slowly
+* across rows (float exponents, high bytes of
+* IDs) turn into long runs
+*/
+
+#include "Macros.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ECS
+{
+    // dst[k * count + i] = byte k of element i of src
+    ARCHETYPE_API void shuffleBytes(const uint8_t* src, std::size_t count, std::size_t elementSize, uint8_t* dst);
+    ARCHETYPE_API void unshuffleBytes(const uint8_t* src, std::size_t count, std::size_t elementSize, uint8_t* dst);
+    // Append the compressed block of src to out
+    ARCHETYPE_API void compressBytes(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out);
+    // Decompress a block into exactly dstSize bytes, returns false if it is malformed
+    ARCHETYPE_API bool decompressBytes(const uint8_t* src, std::size_t srcSize, uint8_t* dst, std::size_t dstSize);
+}
+
+#endif // ARCHETYPE_COMPRESSION_HPP
@@ -11,9 +11,111 @@
 #include "Archetype.hpp"
 #include "EntityManager.hpp"
 #include  "Record.hpp"
+#include "Profiler.hpp"
+#include "IndexManager.hpp"
+#include "Hierarchy.hpp"
+#include "Observer.hpp"
+#include "Resource.hpp"
+#include "ColumnExport.hpp"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <utility>
 
 namespace ECS
 {
+    // How many entities ahead Engine::getComponents() prefetches
+    constexpr std::size_t PREFETCH_DISTANCE = 8;
+
+    // How much work Engine::compact() does per call
+    struct CompactionPolicy
+    {
+        // Archetypes visited per call
+        uint32_t archetypesPerStep = 4;
+        // Consecutive visits an archetype must be found empty before it is freed
+        uint32_t emptyVisits = 2;
+        // Component vectors wasting less memory than this are not shrunk
+        std::size_t minWastedBytes = 16 * 1024;
+    };
+
+    // Tag of prefab entities, archetypes having it are left out of
+    // processors, chunk iteration, indexes and observers
+    struct Prefab
+    {
+        uint8_t value;
+    };
+
+    // Tag of sleeping entities (see Engine::sleepEntities), left out like prefabs
+    struct Sleeping
+    {
+        uint8_t value;
+    };
+
+    // Memory use of the archetype registry
+    struct RegistryStats
+    {
+        // Live archetypes, the empty entity archetype included
+        uint32_t archetypes = 0;
+        // Live archetypes without entity
+        uint32_t emptyArchetypes = 0;
+        // Slots of freed archetypes waiting for reuse
+        uint32_t freeSlots = 0;
+        // Heap memory of live archetypes
+        std::size_t archetypeBytes = 0;
+        // Part of archetypeBytes allocated for elements that do not exist yet
+        std::size_t wastedBytes = 0;
+        // Heap memory of the archetype/component table
+        std::size_t recordBytes = 0;
+    };
+
+    // Memory of one component vector
+    struct ColumnMemory
+    {
+        // typeid(T).name(), or the name of a runtime component type
+        const char* type = nullptr;
+        std::size_t bytes = 0;
+        std::size_t wastedBytes = 0;
+    };
+
+    // Memory of one live archetype
+    struct ArchetypeMemory
+    {
+        uint32_t index = 0;
+        Identifier identifier;
+        uint32_t entities = 0;
+        // Entity list and columns
+        std::size_t bytes = 0;
+        std::size_t wastedBytes = 0;
+        // Ordered by type name
+        std::vector<ColumnMemory> columns;
+    };
+
+    // Memory use of the whole engine, see Engine::memoryStats(). Sizes are approximate:
+    // hash nodes are estimated, memory owned by component values and index keys
+    // (strings, heap members) and resources are left out
+    struct MemoryStats
+    {
+        RegistryStats registry;
+        // Ordered by index
+        std::vector<ArchetypeMemory> archetypes;
+        // Archetype objects and the identifier to archetype map
+        std::size_t archetypeSlotBytes = 0;
+        // Per-entity tables, alive set and free list, allocated for MAX_ENTITY at once
+        std::size_t entityBytes = 0;
+        std::size_t indexBytes = 0;
+        std::size_t hierarchyBytes = 0;
+        std::size_t sharedPoolBytes = 0;
+        // Every field above, registry included
+        std::size_t totalBytes = 0;
+        // Share of registry.archetypeBytes allocated for elements that do not exist yet
+        float wastedRatio = 0.0f;
+        // Entities per archetype holding any, low when entities are spread over many archetypes
+        float entitiesPerArchetype = 0.0f;
+    };
+
     // Coordinate entities creation and removal, components and processors registration
     class ARCHETYPE_API Engine
     {
@@ -22,7 +124,29 @@ namespace ECS
         // Entities
 
         Entity createEntity();
+        // Also destroy every descendant of entity
         void destroyEntity(Entity entity);
+        // Thread-safe, the entity is usable after the next flushReserved()
+        // Returns NULL_ENTITY if no ID is left
+        Entity reserveEntity();
+        // Thread-safe, reserve a block of count IDs at once
+        // Returns an empty vector if not enough IDs are left
+        std::vector<Entity> reserveEntities(std::size_t count);
+        // Sync point: turn reserved IDs into empty entities
+        // Must not run concurrently with any other method
+        void flushReserved();
+
+        // Hierarchy
+
+        // Dead entities are refused (a check fails, nothing changes)
+        void setParent(Entity child, Entity parent);
+        void removeParent(Entity child);
+        // Returns NULL_ENTITY if entity has no parent or is dead
+        Entity getParent(Entity entity) const;
+        // Empty for dead entities
+        const std::vector<Entity>& getChildren(Entity entity) const;
+        // Depth-ordered list of every entity with a parent or a child, see Hierarchy.hpp
+        Hierarchy& getHierarchy();
 
         // Components
 
@@ -35,23 +159,277 @@ namespace ECS
         template <typename T>
         void removeComponent(Entity entity);
         template <typename T>
-        void addComponent(Entity entity, const T&& component);
-        template <typename T>
         void addComponent(Entity entity, const T& component);
+        // Move component into place, T is deduced as a reference for lvalues
+        template <typename T>
+        void addComponent(Entity entity, T&& component);
+        // Add a T constructed from args directly in its final place, T may be move-only
+        template <typename T, typename... Args>
+        void emplaceComponent(Entity entity, Args&&... args);
+        // Overwrite entity's component, keeping indexes of T up to date
+        // Writes through references returned by getComponent() are not tracked
+        template <typename T>
+        void setComponent(Entity entity, const T& component);
+        template <typename T>
+        void setComponent(Entity entity, T&& component);
+        // Identifier of registered component types, to be used with getArchetypeRefs()
+        template <typename T1, typename... Ts>
+        Identifier generateIdentifier() const;
+
+        // Shared components, stored once per distinct value. removeComponent() and
+        // haveComponent() work on them as well
+
+        // Values are looked up in the pool by Hash()(value) then compared with operator ==
+        template <typename T, typename Hash = std::hash<T>>
+        void registerSharedComponent();
+        template <typename T>
+        void addSharedComponent(Entity entity, const T& component);
+        template <typename T>
+        const T& getSharedComponent(Entity entity);
+        // The entity's handle is replaced, the old value is released
+        template <typename T>
+        void setSharedComponent(Entity entity, const T& component);
+
+        // Buffered components, stored with a copy of their state at the last swapBuffers() that
+        // other threads can read while the simulation writes (see BufferedComponent.hpp).
+        // Every other call works on the current state as for plain components
+
+        // T must be copyable
+        template <typename T>
+        void registerBufferedComponent();
+        // Report a write to entity's T through a reference returned by getComponent() or
+        // getComponents(), or the processors' archetypes. setComponent() and chunk iteration
+        // report their writes themselves. Not needed for unbuffered types
+        template <typename T>
+        void markDirty(Entity entity);
+        // Frame boundary: the current state of every buffered type becomes the previous one.
+        // No thread may be in forEachPrevious() during the call. Returns the number of elements
+        // copied, those of chunks written or restructured since the last call
+        std::size_t swapBuffers();
+        // Call fn(std::size_t count, const Entity* entities, const T* column) for every
+        // archetype having T at the last swapBuffers(), prefabs and sleeping entities excepted.
+        // Safe from any thread while the engine is used, between two swapBuffers()
+        template <typename T, typename Fn>
+        void forEachPrevious(Fn fn) const;
+
+        // Resources, global values stored once per type outside of the archetypes
+        // Processors declare which ones they read or write, see Processor::conflictsWith()
+
+        // Construct resource T from args, replacing the current one
+        template <typename T, typename... Args>
+        T& setResource(Args&&... args);
+        template <typename T>
+        T& getResource();
+        template <typename T>
+        bool haveResource() const;
+        template <typename T>
+        void removeResource();
+        ResourceManager& getResources();
+
+        // Runtime components, types defined by their size, alignment and lifetime functions
+        // (scripting, data files) and stored in byte columns like native ones. See RawComponent.hpp
+
+        // Returns the type number used by the calls below, name must not be registered yet
+        ComponentType registerRawComponent(const std::string& name, const RawComponentInfo& info);
+        ComponentType getRawComponentType(const std::string& name) const;
+        const RawComponentInfo& getRawComponentInfo(ComponentType type) const;
+        // Add a default constructed value and return its address, valid until entity changes archetype
+        void* addRawComponent(Entity entity, ComponentType type);
+        void* getRawComponent(Entity entity, ComponentType type);
+        bool haveRawComponent(Entity entity, ComponentType type);
+        void removeRawComponent(Entity entity, ComponentType type);
+        // Call fn(std::size_t count, void* const* columns) for every chunk of every archetype having
+        // all of types, columns[k] being the start of the chunk in the column of types[k]
+        // Elements of a column are getRawComponentInfo(types[k]).getStride() bytes apart
+        template <typename Fn>
+        void forEachRawChunk(const std::vector<ComponentType>& types, Fn fn);
+
+        // Worlds
+
+        // Move every entity of staging, an engine with no type unknown to this one, into this
+        // engine, column by column. Returns [staging entity] = new entity or NULL_ENTITY
+        // Component values are moved as is, fields holding staging entities must be fixed with it
+        // Columns are stored the way this engine registered their type: a type buffered in one
+        // engine only is converted. Nothing is merged, a check failing, if a type is unknown
+        // here or shared in one engine only, or if fewer IDs are left than staging has entities
+        // Parent/child relationships are kept, staging is left without entities and no observer
+        // of staging is fired
+        std::vector<Entity> merge(Engine& staging);
+
+        // Write the components of every archetype matching id (all of them by default, prefabs
+        // and sleepers excepted unless id names them) to the file descriptor fd, column by
+        // column straight from the component vectors, packed archetypes through a temporary
+        // buffer so they stay packed. See ColumnExport.hpp for the format. Returns false if a
+        // write failed
+        bool exportColumns(int fd, const Identifier& id = Identifier());
+
+        // Prefabs
+
+        // Create an entity tagged Prefab, its components are added as usual
+        Entity createPrefab();
+        bool isPrefab(Entity entity);
+        // Create count entities having a copy of every component of prefab but the Prefab tag,
+        // copied in bulk column by column. Children of prefab are not instantiated
+        // Nothing is created, a check failing, if prefab is not a prefab, if a component of prefab
+        // is not copyable or if fewer than count entity IDs are left
+        std::vector<Entity> instantiate(Entity prefab, std::size_t count);
+
+        // Sleeping entities
+
+        // Tag entities Sleeping so processors, chunk iteration and queries skip them, and drop
+        // them from indexes. Their archetypes are packed (see Archetype::pack) if compress,
+        // after which their components cannot be read or written until they wake (a check fails
+        // and the access is skipped). Observers see neither sleeping nor waking. Adding/removing
+        // components of or destroying an entity in a packed archetype, or an entity moving into
+        // one, unpacks it for good
+        void sleepEntities(const std::vector<Entity>& entities, bool compress = false);
+        // Remove the Sleeping tag and index entities again, archetypes left with sleeping
+        // entities are packed again if they were
+        void wakeEntities(const std::vector<Entity>& entities);
+        bool isSleeping(Entity entity);
+
+        // Secondary indexes
+
+        // Index entities having T by keyFunction(component), entities already having T are indexed at once
+        // Shared component types cannot be indexed. Indexes are told apart by component type and
+        // key type only: a second hash (or sorted) index of T with the same key type is refused,
+        // so two int fields of one component need two key types or two component types
+        template <typename T, typename KeyFunction>
+        void addHashIndex(KeyFunction keyFunction);
+        template <typename T, typename KeyFunction>
+        void addSortedIndex(KeyFunction keyFunction);
+        // Return any entity whose T has key or NULL_ENTITY, requires an index of T. The key is
+        // converted to the index's key type: C strings look up std::string keys, and numbers
+        // another arithmetic key type, exact type first then integers from the smallest, then
+        // floating types (bool keys only for bool lookups). 42 finds 42u, a value the key type
+        // cannot hold (300 for uint8_t, 2.5 for int) finds nothing. Without a matching index
+        // the check fails and nothing is found
+        template <typename T, typename Key>
+        Entity findEntity(const Key& key) const;
+        template <typename T, typename Key>
+        std::vector<Entity> findEntities(const Key& key) const;
+        // Entities whose T's key is in [low, high] ordered by key, requires a sorted index. Bounds
+        // the key type cannot hold are clamped to its range: [-5, 300] on uint8_t keys is [0, 255]
+        template <typename T, typename Key>
+        std::vector<Entity> findEntitiesInRange(const Key& low, const Key& high) const;
+
+        // Observers, fn(Entity entity, const T& component) is called after T is added to or set
+        // through the engine on an entity, and before it is removed (destroyEntity() included)
+        // Callbacks must not register observers nor add/remove components of a dying entity
+
+        template <typename T, typename Fn>
+        void onAdd(Fn fn);
+        template <typename T, typename Fn>
+        void onRemove(Fn fn);
+        template <typename T, typename Fn>
+        void onSet(Fn fn);
+        // Collect entities receiving one of events on one of the types and having all of them
+        // (or losing one of them for ObserverEvent::Remove); destroyed entities are dropped
+        template <typename T1, typename... Ts>
+        std::shared_ptr<ReactiveQuery> addReactiveQuery(ObserverEvent events = ObserverEvent::Add);
+
+        // Archetype registry
+
+        // Free every empty archetype at once
+        void flushEmpty();
+        // Incremental maintenance meant to be called once per frame: visit a few archetypes
+        // (see CompactionPolicy), free those found empty on consecutive visits and shrink
+        // over-allocated component vectors of the others
+        void compact();
+        void setCompactionPolicy(const CompactionPolicy& policy);
+        RegistryStats getRegistryStats() const;
+        // Bytes per archetype, column and engine structure, see MemoryStats
+        MemoryStats memoryStats() const;
+        // Make room for count more entities in the archetype of exactly T and Ts, creating
+        // it if needed, so a large spawn does not reallocate its columns. Types must not be
+        // shared. compact() may give back the room of archetypes it visits before the spawn
+        template <typename T, typename... Ts>
+        void reserve(std::size_t count);
+
+        // Row order
+
+        // Reorder the entities of every archetype having T by keyFn(const T&) ascending, moving all
+        // columns at once so chunk iteration and processors visit them in that order. Integer keys
+        // are radix sorted, other keys need operator <. If keepSorted, archetypes having T are put
+        // back in order by restoreOrders() after entities joined or left them or setComponent()
+        // was called on them. Writes through getComponent() references are not tracked
+        template <typename T, typename KeyFn>
+        void sortArchetypes(KeyFn keyFn, bool keepSorted = false);
+        // Sort again archetypes kept sorted that lost their order, done before chunk
+        // iteration and by Processor::getData(). The latest order matching an archetype is used
+        void restoreOrders();
 
         // Processors
         
         // Return true if a new archetype was created/removed since last call
         bool archetypesChanged();
+        // Incremented whenever an archetype is created or removed
+        uint64_t getArchetypeVersion() const;
         // Return a list of Archetypes that have identifiers matching id
         std::vector<Archetype*> getArchetypeRefs(const Identifier& id);
+        // Call fn(std::size_t count, T1* column, Ts*... columns) for every chunk of every
+        // archetype having all of the types (see Archetype::forEachChunk)
+        template <typename T1, typename... Ts, typename Fn>
+        void forEachChunk(Fn fn);
+        // Call fn(Entity entity, T1& component, Ts&... components) for each of count entities in order,
+        // which must all have the types. Entities are located through the row table without hashing
+        // and their components prefetched PREFETCH_DISTANCE entities ahead. Types may be const, the
+        // visited rows of the others are reported written
+        template <typename T1, typename... Ts, typename Fn>
+        void getComponents(const Entity* entities, std::size_t count, Fn fn);
         template <typename T>
         std::shared_ptr<T> registerProcessor();
         template <typename Proc, typename T1, typename... Ts>
         void setProcessorIdentifier();
+
+        // Instrumentation
+
+        #ifdef ARCHETYPE_PROFILE
+        Profiler& getProfiler();
+        // Size of every live archetype at the time of the call
+        std::vector<ArchetypeStats> getArchetypeStats() const;
+        // Dump the profiler's data together with current archetype sizes
+        void writeChromeTrace(std::ostream& os) const;
+        #endif
     private:
-        // Delete archetypes with 0 entities
-        void flushEmpty();
+        // Destroy entity without looking at its descendants
+        void destroySingleEntity(Entity entity);
+        void removeArchetype(uint32_t index);
+        template <typename T, typename Fn>
+        void addObserver(ObserverEvent event, Fn fn);
+        // Move entity to the archetype with identifier id and return its index. If that archetype
+        // does not exist, it is cloned from entity's current archetype then modified by edit(clone)
+        // Data of type constructed is left for the caller to emplace (see Archetype::transferEntity)
+        template <typename Edit>
+        uint32_t moveEntity(Entity entity, const Identifier& id, Edit edit, const char* constructed = nullptr);
+        // Assign value to entity's T through the engine, see setComponent()
+        template <typename T, typename U>
+        void writeComponent(Entity entity, U&& value);
+        // Index of the archetype with identifier id, cloned from archetype base then
+        // modified by edit(clone) if it does not exist
+        template <typename Edit>
+        uint32_t findOrCreateArchetype(const Identifier& id, const Archetype& base, Edit edit);
+        // Rows of archetypes matching id, prefabs and sleeping entities are left out unless id
+        // has Prefab or Sleeping
+        std::vector<uint32_t> getMatchingRows(const Identifier& id) const;
+        // Archetype of prefabs or sleeping entities, kept out of indexes
+        bool isHiddenArchetype(uint32_t index) const;
+        bool isSharedType(ComponentType type) const;
+        // Whether T is buffered and not const, writes to it must be reported
+        template <typename T>
+        bool isWrittenBuffered() const;
+        // Interned name of runtime component type
+        const char* getRawName(ComponentType type) const;
+        // Call fn(index) with the hash index of T (or the sorted one if SORTED) whose key type
+        // lookups of type Key use, see findEntity(). False if none
+        template <typename T, bool SORTED, typename Key, typename Fn>
+        bool visitIndex(Fn fn) const;
+        // visitIndex() for index key type K
+        template <typename T, bool SORTED, typename K, typename Fn>
+        bool visitIndexAs(Fn& fn) const;
+        // Add a vector of T to a new archetype, buffered if T was registered so
+        template <typename T>
+        void addColumn(Archetype& arch);
     private:
         // Index of empty archetype
         uint32_t mEmptyRow;
@@ -62,14 +440,26 @@ namespace ECS
 
         // Archetype related
 
-        // Contain every archetypes
-        std::array<Archetype, MAX_ARCHETYPE> mArchetypes;
+        // Contain every archetypes, a deque keeps references valid while growing
+        std::deque<Archetype> mArchetypes;
         // Keep track of every entity's current archetype
         // [i] = index of the archetype containing i in mArchetypes
         std::array<uint32_t, MAX_ENTITY> mEntityArchetype;
+        // [i] = position of i in its archetype's entities and component vectors
+        // Maintained by the archetypes themselves, see Archetype::setRowTable
+        std::array<uint32_t, MAX_ENTITY> mEntityRow;
         // [id] = The index of the archetype with identifier matching id
-        std::unordered_map<std::bitset<MAX_COMPONENT_TYPE>, uint32_t> mArchetypeIDs;
+        std::unordered_map<Identifier, uint32_t, IdentifierHash> mArchetypeIDs;
         bool mArchetypesChanged;
+        uint64_t mArchetypeVersion;
+
+        // Compaction
+
+        CompactionPolicy mCompaction;
+        // Next archetype compact() visits
+        uint32_t mCompactionCursor;
+        // [i] = number of consecutive compact() visits that found archetype i empty
+        std::vector<uint32_t> mEmptyVisits;
 
         // Entities
 
@@ -77,6 +467,37 @@ namespace ECS
 
         // Processors
         ProcessorManager mProcessors;
+
+        // Secondary indexes
+        IndexManager mIndices;
+        // [type name] = value storage of a shared component type
+        std::unordered_map<const char*, std::shared_ptr<ISharedPool>> mSharedPools;
+        // [type] = true for types of mSharedPools, for checks without a lookup
+        std::vector<bool> mSharedTypes;
+        // [type name] = empty column of a registered type, stored the way this engine stores it
+        // (plain, buffered, shared in its pool or raw). Cloned by merge() to build archetypes
+        std::unordered_map<const char*, std::shared_ptr<IComponentVector>> mColumnPrototypes;
+        // Parent/child relationships
+        Hierarchy mHierarchy;
+        ComponentType mPrefabType;
+        ComponentType mSleepingType;
+        // Identifiers holding only mPrefabType, only mSleepingType and both
+        Identifier mPrefabID;
+        Identifier mSleepingID;
+        Identifier mHiddenID;
+        ObserverManager mObservers;
+        ResourceManager mResources;
+        // [component type] = interned name and info of runtime types, name is nullptr for native types
+        std::vector<std::pair<const char*, RawComponentInfo>> mRawTypes;
+        // [type name] = previous-frame columns of a buffered component type, as of the last
+        // swapBuffers(). Vectors are kept alive until the next call
+        std::unordered_map<const char*, std::vector<std::shared_ptr<IComponentVector>>> mBufferedColumns;
+        // Orders archetypes are kept in, one per key component type
+        std::vector<std::pair<Identifier, std::function<void(Archetype&)>>> mRowOrders;
+
+        #ifdef ARCHETYPE_PROFILE
+        Profiler mProfiler;
+        #endif
     };
 
     template <typename T>
@@ -84,22 +505,27 @@ namespace ECS
     {
         ECS_ASSERT(mTypeList.haveType<T>() == false, ((std::string)"Component type " + (typeid(T).name()) + " registered twice"));
         mTypeList.registerType<T>();
+        mColumnPrototypes[typeid(T).name()] = std::make_shared<ComponentVector<T>>();
+    }
+
+    // Inline as every addComponent() checks it
+    inline bool Engine::isSharedType(ComponentType type) const
+    {
+        return type < mSharedTypes.size() && mSharedTypes[type];
     }
 
     template <typename T>
     T& Engine::getComponent(Entity entity)
     {
-        ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
-        Archetype& holder = mArchetypes[mEntityArchetype[entity]];
-
-        ECS_ASSERT(holder.haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered but query data of entity " + std::to_string(entity)));
-        return holder.getComponent<T>(entity);
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), getFallbackElement<T>());
+        // The archetype checks that entity has T
+        return mArchetypes[mEntityArchetype[entity]].getComponent<T>(entity);
     }
 
     template <typename T>
     bool Engine::haveComponent(Entity entity)
     {
-        ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), false);
         Archetype& holder = mArchetypes[mEntityArchetype[entity]];
         return holder.haveType<T>();
     }
@@ -107,104 +533,546 @@ namespace ECS
     template <typename T>
     void Engine::addComponent(Entity entity, const T& component)
     {
-        ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
-        ECS_ASSERT(haveComponent<T>(entity) == false, ((std::string)"Component of type " + (typeid(T).name()) + " added twice to entity " + std::to_string(entity)));
+        emplaceComponent<T>(entity, component);
+    }
 
-        // Initialize variables
-        Archetype& oldArchetype = mArchetypes[mEntityArchetype[entity]];
-        Identifier id = oldArchetype.getIdentifier();
-        id.setType(mTypeList.getType<T>());
-        uint32_t newArchetypeIndex;
-
-        // if the archetype is not already created
-        if (mArchetypeIDs.find(id.getValue()) == mArchetypeIDs.end())
-        {
-            mArchetypesChanged = true;
-            if (mTable.isFull())
-                flushEmpty();
-            // Information update
-            newArchetypeIndex = mTable.addRow(id);
-            mArchetypeIDs[id.getValue()] = newArchetypeIndex;
-            // Clone the old archetype
-            mArchetypes[newArchetypeIndex] = std::move(Archetype(oldArchetype));
-            mArchetypes[newArchetypeIndex].addType<T>(mTypeList);
-        }
-        else
-            newArchetypeIndex = mArchetypeIDs[id.getValue()];
-        // Finally give the entity a new home
-        mEntityArchetype[entity] = newArchetypeIndex;
-        oldArchetype.transferEntity(entity, mArchetypes[newArchetypeIndex]);
+    template <typename T>
+    void Engine::addComponent(Entity entity, T&& component)
+    {
+        emplaceComponent<std::decay_t<T>>(entity, std::forward<T>(component));
+    }
+
+    template <typename T, typename... Args>
+    void Engine::emplaceComponent(Entity entity, Args&&... args)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        // One type lookup serves the checks and the move
+        ComponentType type = mTypeList.getType<T>();
+        ECS_ASSERT_OR_RETURN(isSharedType(type) == false, ((std::string)"Shared component type " + (typeid(T).name()) + " added with addComponent()"));
+        Identifier id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        [[maybe_unused]] bool added = id.setType(type);
+        ECS_ASSERT_OR_RETURN(added, ((std::string)"Component of type " + (typeid(T).name()) + " added twice to entity " + std::to_string(entity)));
+        uint32_t newArchetypeIndex = moveEntity(entity, id, [this](Archetype& arch)
+        {
+            addColumn<T>(arch);
+        }, typeid(T).name());
 
         // The awaiting addition
-        mArchetypes[newArchetypeIndex].setComponent<T>(entity, component);
+        const T& component = mArchetypes[newArchetypeIndex].emplaceComponent<T>(entity, std::forward<Args>(args)...);
+        if (isHiddenArchetype(newArchetypeIndex) == false)
+            mIndices.setEntity<T>(entity, component);
+        mObservers.notify(type, ObserverEvent::Add, entity, id);
     }
 
     template <typename T>
-    void Engine::addComponent(Entity entity, const T&& component)
+    void Engine::removeComponent(Entity entity)
     {
-        ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
-        ECS_ASSERT(haveComponent<T>(entity) == false, ((std::string)"Component of type " + (typeid(T).name()) + " added twice to entity " + std::to_string(entity)));
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        ComponentType type = mTypeList.getType<T>();
+        Identifier id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        [[maybe_unused]] bool removed = id.removeType(type);
+        ECS_ASSERT_OR_RETURN(removed, ((std::string)"Component of type " + (typeid(T).name()) + " was not added to entity " + std::to_string(entity)));
+        mObservers.notify(type, ObserverEvent::Remove, entity, mArchetypes[mEntityArchetype[entity]].getIdentifier());
+
+        moveEntity(entity, id, [this](Archetype& arch)
+        {
+            arch.removeType<T>(mTypeList);
+        });
 
+        // While transferring the component is already truncated
+        mIndices.removeEntity<T>(entity);
+    }
+
+    template <typename Edit>
+    uint32_t Engine::moveEntity(Entity entity, const Identifier& id, Edit edit, const char* constructed)
+    {
         // Initialize variables
         Archetype& oldArchetype = mArchetypes[mEntityArchetype[entity]];
-        Identifier id = oldArchetype.getIdentifier();
-        id.setType(mTypeList.getType<T>());
-        uint32_t newArchetypeIndex;
-        // if the archetype is not already created
-        if (mArchetypeIDs.find(id.getValue()) == mArchetypeIDs.end())
-        {
-            mArchetypesChanged = true;
-            if (mTable.isFull())
-                flushEmpty();
-            // Information update
-            newArchetypeIndex = mTable.addRow(id);
-            mArchetypeIDs[id.getValue()] = newArchetypeIndex;
-            // Clone the old archetype
-            mArchetypes[newArchetypeIndex] = std::move(Archetype(oldArchetype));
-            mArchetypes[newArchetypeIndex].addType<T>(mTypeList);
-        }
-        else
-            newArchetypeIndex = mArchetypeIDs[id.getValue()];
+        if (oldArchetype.isPacked())
+            oldArchetype.unpack();
+        ECS_PROFILE(mProfiler.count(ProfileCounter::ArchetypeTransition));
+        uint32_t newArchetypeIndex = findOrCreateArchetype(id, oldArchetype, edit);
+        // The entity may land among sleeping entities that were packed
+        if (mArchetypes[newArchetypeIndex].isPacked())
+            mArchetypes[newArchetypeIndex].unpack();
+
         // Finally give the entity a new home
         mEntityArchetype[entity] = newArchetypeIndex;
-        oldArchetype.transferEntity(entity, mArchetypes[newArchetypeIndex]);
+        oldArchetype.transferEntity(entity, mArchetypes[newArchetypeIndex], constructed);
+        return newArchetypeIndex;
+    }
 
-        // The awaiting addition
-        mArchetypes[newArchetypeIndex].setComponent<T>(entity, component);
+    template <typename Edit>
+    uint32_t Engine::findOrCreateArchetype(const Identifier& id, const Archetype& base, Edit edit)
+    {
+        auto found = mArchetypeIDs.find(id);
+        if (found != mArchetypeIDs.end())
+            return found->second;
+
+        mArchetypesChanged = true;
+        mArchetypeVersion++;
+        // Information update
+        uint32_t res = mTable.addRow(id);
+        mArchetypeIDs[id] = res;
+        // A deque keeps references to base valid
+        if (res == mArchetypes.size())
+        {
+            mArchetypes.emplace_back();
+            mEmptyVisits.push_back(0);
+        }
+        // Clone the base archetype
+        mArchetypes[res] = Archetype(base);
+        mArchetypes[res].setRowTable(mEntityRow.data());
+        edit(mArchetypes[res]);
+        return res;
+    }
+
+    template <typename T, typename... Ts>
+    void Engine::reserve(std::size_t count)
+    {
+        ECS_ASSERT(((mSharedPools.find(typeid(T).name()) == mSharedPools.end()) && ... && (mSharedPools.find(typeid(Ts).name()) == mSharedPools.end())), "Shared component types reserved");
+
+        Identifier id = mTypeList.generateIdentifier<T, Ts...>();
+        uint32_t index = findOrCreateArchetype(id, mArchetypes[mEmptyRow], [this](Archetype& arch)
+        {
+            addColumn<T>(arch);
+            (addColumn<Ts>(arch), ...);
+        });
+        Archetype& arch = mArchetypes[index];
+        arch.reserve(arch.getEntities().size() + count);
+        // Not freed by compact() before the spawn gets a chance to fill it
+        mEmptyVisits[index] = 0;
+    }
+
+    template <typename T, typename Hash>
+    void Engine::registerSharedComponent()
+    {
+        registerComponent<T>();
+        ComponentType type = mTypeList.getType<T>();
+        if (mSharedTypes.size() <= type)
+            mSharedTypes.resize(type + 1, false);
+        mSharedTypes[type] = true;
+        auto pool = std::make_shared<SharedPool<T>>([](const T& value) -> std::size_t
+        {
+            return Hash()(value);
+        });
+        mSharedPools[typeid(T).name()] = pool;
+        mColumnPrototypes[typeid(T).name()] = std::make_shared<SharedComponentVector<T>>(pool);
     }
 
     template <typename T>
-    void Engine::removeComponent(Entity entity)
+    void Engine::registerBufferedComponent()
     {
-         ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
-        ECS_ASSERT(haveComponent<T>(entity), ((std::string)"Component of type " + (typeid(T).name()) + " was not added to entity " + std::to_string(entity)));
+        static_assert(std::is_copy_assignable_v<T> && std::is_copy_constructible_v<T>, "Buffered component types must be copyable");
+        registerComponent<T>();
+        mBufferedColumns[typeid(T).name()];
+        mColumnPrototypes[typeid(T).name()] = std::make_shared<BufferedComponentVector<T>>();
+    }
 
-        // Initialize variables
-        Archetype& oldArchetype = mArchetypes[mEntityArchetype[entity]];
-        Identifier id = oldArchetype.getIdentifier();
-        id.removeType(mTypeList.getType<T>());
-        uint32_t newArchetypeIndex;
+    template <typename T>
+    void Engine::markDirty(Entity entity)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        mArchetypes[mEntityArchetype[entity]].markDirty<T>(entity);
+    }
 
-        // if the archetype is not already created
-        if (mArchetypeIDs.find(id.getValue()) == mArchetypeIDs.end())
+    template <typename T>
+    bool Engine::isWrittenBuffered() const
+    {
+        return std::is_const_v<T> == false && mBufferedColumns.find(typeid(T).name()) != mBufferedColumns.end();
+    }
+
+    template <typename T, typename Fn>
+    void Engine::forEachPrevious(Fn fn) const
+    {
+        auto found = mBufferedColumns.find(typeid(T).name());
+        ECS_ASSERT_OR_RETURN(found != mBufferedColumns.end(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered as buffered"));
+        for (const auto& vec : found->second)
         {
-            mArchetypesChanged = true;
-            // Information update
-            newArchetypeIndex = mTable.addRow(id);
-            mArchetypeIDs[id.getValue()] = newArchetypeIndex;
+            const auto& buffered = static_cast<const BufferedComponentVector<T>&>(*vec);
+            if (buffered.getPreviousSize() != 0)
+                fn(buffered.getPreviousSize(), buffered.getPreviousEntities(), static_cast<const T*>(buffered.getPreviousData()));
+        }
+    }
+
+    template <typename T>
+    void Engine::addColumn(Archetype& arch)
+    {
+        // Move-only types cannot be registered as buffered
+        if constexpr (std::is_copy_assignable_v<T> && std::is_copy_constructible_v<T>)
+            if (mBufferedColumns.find(typeid(T).name()) != mBufferedColumns.end())
+            {
+                arch.addBufferedType<T>(mTypeList);
+                return;
+            }
+        arch.addType<T>(mTypeList);
+    }
+
+    template <typename T>
+    void Engine::addSharedComponent(Entity entity, const T& component)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        ECS_ASSERT_OR_RETURN(haveComponent<T>(entity) == false, ((std::string)"Component of type " + (typeid(T).name()) + " added twice to entity " + std::to_string(entity)));
+        ECS_ASSERT_OR_RETURN(mSharedPools.find(typeid(T).name()) != mSharedPools.end(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered as shared"));
 
-            // Clone the old archetype
-            mArchetypes[newArchetypeIndex] = std::move(Archetype(oldArchetype));
-            mArchetypes[newArchetypeIndex].removeType<T>(mTypeList);
+        Identifier id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        id.setType(mTypeList.getType<T>());
+        uint32_t newArchetypeIndex = moveEntity(entity, id, [this](Archetype& arch)
+        {
+            arch.addSharedType<T>(mTypeList, std::static_pointer_cast<SharedPool<T>>(mSharedPools[typeid(T).name()]));
+        });
+        mArchetypes[newArchetypeIndex].setSharedComponent<T>(entity, component);
+        mObservers.notify(mTypeList.getType<T>(), ObserverEvent::Add, entity, id);
+    }
+
+    template <typename T>
+    const T& Engine::getSharedComponent(Entity entity)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), getFallbackElement<T>());
+        return mArchetypes[mEntityArchetype[entity]].getSharedComponent<T>(entity);
+    }
+
+    template <typename T>
+    void Engine::setSharedComponent(Entity entity, const T& component)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        ECS_ASSERT_OR_RETURN(haveComponent<T>(entity), ((std::string)"Component of type " + (typeid(T).name()) + " was not added to entity " + std::to_string(entity)));
+        mArchetypes[mEntityArchetype[entity]].setSharedComponent<T>(entity, component);
+        mObservers.notify(mTypeList.getType<T>(), ObserverEvent::Set, entity, mArchetypes[mEntityArchetype[entity]].getIdentifier());
+    }
+
+    template <typename T>
+    void Engine::setComponent(Entity entity, const T& component)
+    {
+        writeComponent<T>(entity, component);
+    }
+
+    template <typename T>
+    void Engine::setComponent(Entity entity, T&& component)
+    {
+        writeComponent<std::decay_t<T>>(entity, std::forward<T>(component));
+    }
+
+    template <typename T, typename U>
+    void Engine::writeComponent(Entity entity, U&& value)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        Archetype& holder = mArchetypes[mEntityArchetype[entity]];
+        // One column lookup, which also checks that entity has T
+        T* component = holder.setComponent<T>(entity, std::forward<U>(value));
+        if (component == nullptr)
+            return;
+        holder.invalidateOrder();
+        if (isHiddenArchetype(mEntityArchetype[entity]) == false)
+            mIndices.setEntity<T>(entity, *component);
+        mObservers.notify(mTypeList.getType<T>(), ObserverEvent::Set, entity, holder.getIdentifier());
+    }
+
+    template <typename T, typename... Args>
+    T& Engine::setResource(Args&&... args)
+    {
+        return mResources.set<T>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T& Engine::getResource()
+    {
+        return mResources.get<T>();
+    }
+
+    template <typename T>
+    bool Engine::haveResource() const
+    {
+        return mResources.have<T>();
+    }
+
+    template <typename T>
+    void Engine::removeResource()
+    {
+        mResources.remove<T>();
+    }
+
+    template <typename T1, typename... Ts>
+    Identifier Engine::generateIdentifier() const
+    {
+        return mTypeList.generateIdentifier<T1, Ts...>();
+    }
+
+    template <typename T1, typename... Ts, typename Fn>
+    void Engine::getComponents(const Entity* entities, std::size_t count, Fn fn)
+    {
+        using Columns = std::tuple<T1*, Ts*...>;
+        // Rows of buffered columns are reported written one by one, const types are only read
+        bool written = mBufferedColumns.empty() == false && (isWrittenBuffered<T1>() || ... || isWrittenBuffered<Ts>());
+        // [archetype] = its columns of the types and the call that resolved them, kept between
+        // calls so none allocates. A call on another engine or from fn only stamps the
+        // archetypes it resolves, which this call resolves again
+        static thread_local std::vector<Columns> columns;
+        static thread_local std::vector<uint64_t> resolved;
+        static thread_local uint64_t calls = 0;
+        uint64_t call = ++calls;
+        if (columns.size() < mArchetypes.size())
+        {
+            columns.resize(mArchetypes.size());
+            resolved.resize(mArchetypes.size(), 0);
         }
-        else
-            newArchetypeIndex = mArchetypeIDs[id.getValue()];
+        auto locate = [&](Entity entity) -> Columns
+        {
+            uint32_t index = mEntityArchetype[entity];
+            if (resolved[index] != call)
+            {
+                columns[index] = mArchetypes[index].getColumns<T1, Ts...>();
+                resolved[index] = call;
+            }
+            return columns[index];
+        };
 
-        // Finally give the entity a new home
-        mEntityArchetype[entity] = newArchetypeIndex;
-        oldArchetype.transferEntity(entity, mArchetypes[newArchetypeIndex]);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // Dead IDs have no row to prefetch, they are reported below
+            if (i + PREFETCH_DISTANCE < count && mEntities.isAlive(entities[i + PREFETCH_DISTANCE]))
+            {
+                Entity ahead = entities[i + PREFETCH_DISTANCE];
+                uint32_t row = mEntityRow[ahead];
+                Columns found = locate(ahead);
+                if (std::get<0>(found) != nullptr)
+                    std::apply([row](auto*... column) { (ECS_PREFETCH(column + row), ...); }, found);
+            }
+            Entity entity = entities[i];
+            // Dead entities are skipped, their row may be out of any column
+            if (mEntities.isAlive(entity) == false)
+            {
+                ECS_ASSERT(false, ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+                continue;
+            }
+            uint32_t row = mEntityRow[entity];
+            // Entities whose columns cannot be given are skipped
+            Columns found = locate(entity);
+            if (std::get<0>(found) == nullptr)
+                continue;
+            std::apply([&](auto*... column) { fn(entity, column[row]...); }, found);
+            if (written)
+                mArchetypes[mEntityArchetype[entity]].markRowsDirty<T1, Ts...>(row, 1);
+        }
+    }
 
-        // While transferring the component is already truncated
+    template <typename T, typename Fn>
+    void Engine::onAdd(Fn fn)
+    {
+        addObserver<T>(ObserverEvent::Add, std::move(fn));
+    }
+
+    template <typename T, typename Fn>
+    void Engine::onRemove(Fn fn)
+    {
+        addObserver<T>(ObserverEvent::Remove, std::move(fn));
+    }
+
+    template <typename T, typename Fn>
+    void Engine::onSet(Fn fn)
+    {
+        addObserver<T>(ObserverEvent::Set, std::move(fn));
+    }
+
+    template <typename T1, typename... Ts>
+    std::shared_ptr<ReactiveQuery> Engine::addReactiveQuery(ObserverEvent events)
+    {
+        return mObservers.addQuery(generateIdentifier<T1, Ts...>(), events);
+    }
+
+    template <typename T, typename Fn>
+    void Engine::addObserver(ObserverEvent event, Fn fn)
+    {
+        ECS_ASSERT(mTypeList.haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered but observed"));
+        bool shared = mSharedPools.find(typeid(T).name()) != mSharedPools.end();
+        mObservers.addObserver(mTypeList.getType<T>(), event, [this, shared, fn](Entity entity)
+        {
+            Archetype& holder = mArchetypes[mEntityArchetype[entity]];
+            fn(entity, shared ? holder.getSharedComponent<T>(entity) : holder.getComponent<T>(entity));
+        });
+    }
+
+    template <typename T1, typename... Ts, typename Fn>
+    void Engine::forEachChunk(Fn fn)
+    {
+        restoreOrders();
+        for (uint32_t i : getMatchingRows(generateIdentifier<T1, Ts...>()))
+            mArchetypes[i].forEachChunk<T1, Ts...>(fn);
+    }
+
+    template <typename Fn>
+    void Engine::forEachRawChunk(const std::vector<ComponentType>& types, Fn fn)
+    {
+        restoreOrders();
+        std::vector<unsigned char*> columns(types.size());
+        std::vector<std::size_t> strides(types.size());
+        std::vector<void*> chunk(types.size());
+        for (uint32_t i : getMatchingRows(Identifier(types)))
+        {
+            Archetype& arch = mArchetypes[i];
+            for (std::size_t k = 0; k < types.size(); ++k)
+            {
+                RawComponentVector& vec = arch.getRawVector(getRawName(types[k]));
+                columns[k] = static_cast<unsigned char*>(vec.data());
+                strides[k] = vec.getStride();
+            }
+            std::size_t size = arch.getEntities().size();
+            for (std::size_t begin = 0; begin < size; begin += Archetype::CHUNK_SIZE)
+            {
+                for (std::size_t k = 0; k < types.size(); ++k)
+                    chunk[k] = columns[k] + begin * strides[k];
+                fn(std::min(Archetype::CHUNK_SIZE, size - begin), static_cast<void* const*>(chunk.data()));
+            }
+        }
+    }
+
+    template <typename T, typename KeyFn>
+    void Engine::sortArchetypes(KeyFn keyFn, bool keepSorted)
+    {
+        ECS_ASSERT(mTypeList.haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered but used as sort key"));
+        ECS_ASSERT(mSharedPools.find(typeid(T).name()) == mSharedPools.end(), ((std::string)"Shared component type " + (typeid(T).name()) + " used as sort key"));
+        Identifier id = generateIdentifier<T>();
+        for (uint32_t i : getMatchingRows(id))
+            mArchetypes[i].sortBy<T>(keyFn);
+        if (keepSorted == false)
+            return;
+
+        mRowOrders.erase(std::remove_if(mRowOrders.begin(), mRowOrders.end(), [&id](const auto& order)
+        {
+            return order.first == id;
+        }), mRowOrders.end());
+        mRowOrders.emplace_back(id, [keyFn](Archetype& arch)
+        {
+            arch.sortBy<T>(keyFn, true);
+        });
+    }
+
+    template <typename T, typename KeyFunction>
+    void Engine::addHashIndex(KeyFunction keyFunction)
+    {
+        using Key = std::decay_t<decltype(keyFunction(std::declval<const T&>()))>;
+        // Shared values have no per-entity storage to index
+        bool shared = mSharedPools.find(typeid(T).name()) != mSharedPools.end();
+        ECS_ASSERT(shared == false, ((std::string)"Shared component type " + (typeid(T).name()) + " indexed"));
+        if (shared)
+            return;
+        // Lookups could never reach a second index of the same key type
+        ECS_ASSERT_OR_RETURN((mIndices.haveHashIndex<T, Key>() == false), ((std::string)"Hash index of component type " + (typeid(T).name()) + " with key type " + (typeid(Key).name()) + " added twice"));
+        auto& index = mIndices.addHashIndex<T, Key>(std::move(keyFunction));
+        for (Archetype* arch : getArchetypeRefs(generateIdentifier<T>()))
+            for (auto entity : arch->getEntities())
+                index.setEntity(entity, arch->getComponent<T>(entity));
+    }
+
+    template <typename T, typename KeyFunction>
+    void Engine::addSortedIndex(KeyFunction keyFunction)
+    {
+        using Key = std::decay_t<decltype(keyFunction(std::declval<const T&>()))>;
+        // Shared values have no per-entity storage to index
+        bool shared = mSharedPools.find(typeid(T).name()) != mSharedPools.end();
+        ECS_ASSERT(shared == false, ((std::string)"Shared component type " + (typeid(T).name()) + " indexed"));
+        if (shared)
+            return;
+        ECS_ASSERT_OR_RETURN((mIndices.haveSortedIndex<T, Key>() == false), ((std::string)"Sorted index of component type " + (typeid(T).name()) + " with key type " + (typeid(Key).name()) + " added twice"));
+        auto& index = mIndices.addSortedIndex<T, Key>(std::move(keyFunction));
+        for (Archetype* arch : getArchetypeRefs(generateIdentifier<T>()))
+            for (auto entity : arch->getEntities())
+                index.setEntity(entity, arch->getComponent<T>(entity));
+    }
+
+    template <typename T, typename Key>
+    Entity Engine::findEntity(const Key& key) const
+    {
+        Entity res = NULL_ENTITY;
+        auto find = [&](const auto& index)
+        {
+            using IndexKey = typename std::decay_t<decltype(index)>::KeyType;
+            if (auto indexKey = convertIndexKey<IndexKey>(key, KeyRounding::Exact))
+                res = index.find(*indexKey);
+        };
+        [[maybe_unused]] bool found = visitIndex<T, false, Key>(find) || visitIndex<T, true, Key>(find);
+        ECS_ASSERT(found, ((std::string)"No index of component type " + (typeid(T).name()) + " with a key type matching " + (typeid(Key).name())));
+        return res;
+    }
+
+    template <typename T, typename Key>
+    std::vector<Entity> Engine::findEntities(const Key& key) const
+    {
+        std::vector<Entity> res;
+        [[maybe_unused]] bool found = visitIndex<T, false, Key>([&](const auto& index)
+        {
+            using IndexKey = typename std::decay_t<decltype(index)>::KeyType;
+            if (auto indexKey = convertIndexKey<IndexKey>(key, KeyRounding::Exact))
+                res = index.findAll(*indexKey);
+        }) || visitIndex<T, true, Key>([&](const auto& index)
+        {
+            using IndexKey = typename std::decay_t<decltype(index)>::KeyType;
+            if (auto indexKey = convertIndexKey<IndexKey>(key, KeyRounding::Exact))
+                res = index.findRange(*indexKey, *indexKey);
+        });
+        ECS_ASSERT(found, ((std::string)"No index of component type " + (typeid(T).name()) + " with a key type matching " + (typeid(Key).name())));
+        return res;
+    }
+
+    template <typename T, typename Key>
+    std::vector<Entity> Engine::findEntitiesInRange(const Key& low, const Key& high) const
+    {
+        std::vector<Entity> res;
+        [[maybe_unused]] bool found = visitIndex<T, true, Key>([&](const auto& index)
+        {
+            // Both bounds clamped to the key type's range, nothing if the range misses it
+            using IndexKey = typename std::decay_t<decltype(index)>::KeyType;
+            auto indexLow = convertIndexKey<IndexKey>(low, KeyRounding::Up);
+            auto indexHigh = convertIndexKey<IndexKey>(high, KeyRounding::Down);
+            if (indexLow && indexHigh)
+                res = index.findRange(*indexLow, *indexHigh);
+        });
+        ECS_ASSERT(found, ((std::string)"No sorted index of component type " + (typeid(T).name()) + " with a key type matching " + (typeid(Key).name())));
+        return res;
+    }
+
+    template <typename T, bool SORTED, typename Key, typename Fn>
+    bool Engine::visitIndex(Fn fn) const
+    {
+        using Decayed = std::decay_t<Key>;
+        if constexpr (std::is_convertible_v<const Key&, std::string> && std::is_same_v<Decayed, std::string> == false)
+            return visitIndexAs<T, SORTED, std::string>(fn);
+        else if constexpr (std::is_same_v<Decayed, bool>)
+            return visitIndexAs<T, SORTED, bool>(fn);
+        else if constexpr (std::is_arithmetic_v<Decayed>)
+            // Exact type first, then the others from the smallest. 0 and 1 are no bool keys
+            return visitIndexAs<T, SORTED, Decayed>(fn)
+                || visitIndexAs<T, SORTED, char>(fn)
+                || visitIndexAs<T, SORTED, signed char>(fn)
+                || visitIndexAs<T, SORTED, unsigned char>(fn)
+                || visitIndexAs<T, SORTED, short>(fn)
+                || visitIndexAs<T, SORTED, unsigned short>(fn)
+                || visitIndexAs<T, SORTED, int>(fn)
+                || visitIndexAs<T, SORTED, unsigned int>(fn)
+                || visitIndexAs<T, SORTED, long>(fn)
+                || visitIndexAs<T, SORTED, unsigned long>(fn)
+                || visitIndexAs<T, SORTED, long long>(fn)
+                || visitIndexAs<T, SORTED, unsigned long long>(fn)
+                || visitIndexAs<T, SORTED, float>(fn)
+                || visitIndexAs<T, SORTED, double>(fn);
+        else
+            return visitIndexAs<T, SORTED, Decayed>(fn);
+    }
+
+    template <typename T, bool SORTED, typename K, typename Fn>
+    bool Engine::visitIndexAs(Fn& fn) const
+    {
+        const auto* index = [this]()
+        {
+            if constexpr (SORTED)
+                return mIndices.findSortedIndex<T, K>();
+            else
+                return mIndices.findHashIndex<T, K>();
+        }();
+        if (index == nullptr)
+            return false;
+        fn(*index);
+        return true;
     }
 
     template <typename T>
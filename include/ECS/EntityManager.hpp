@@ -4,13 +4,24 @@
 /*
 * EntityManager manages lifetime of every 
 * entities
+* Free IDs are kept in a vector with an atomic
+* cursor, so IDs can be reserved from any thread:
+*
+*   free list : [ free ... free | reserved ... ]
+*                               ^ cursor
+*
+* Reserved IDs become alive entities when the
+* owning thread calls takeReserved(). Only
+* reserveEntity(ies) may run concurrently.
 */
 
 #include "Macros.hpp"
 #include "Properties.hpp"
 
-#include <stack>
+#include <atomic>
 #include <bitset>
+#include <string>
+#include <vector>
 
 namespace ECS
 {
@@ -22,10 +33,37 @@ namespace ECS
         Entity createEntity();
         void retrieveEntity(Entity e);
         bool isAlive(Entity e) const;
+
+        // Thread-safe, returns NULL_ENTITY if no ID is left
+        Entity reserveEntity();
+        // Thread-safe, reserve count IDs at once and write them to out
+        // Returns false and reserves nothing if not enough IDs are left
+        bool reserveEntities(std::size_t count, Entity* out);
+        bool haveReserved() const;
+        // Mark every reserved ID alive and return them
+        std::vector<Entity> takeReserved();
+        // Memory of the alive set and the free list
+        std::size_t getByteSize() const;
     private:
         std::bitset<MAX_ENTITY> mAlive;
-        std::stack<Entity> mContainer;
+        // Next ID to hand out is at the back
+        std::vector<Entity> mFree;
+        // [0, mCursor) of mFree are free, the rest is reserved
+        std::atomic<int64_t> mCursor;
     };
+
+    // Inline as every access through the engine checks it
+    inline bool EntityManager::isAlive(Entity e) const
+    {
+        // Out of bounds IDs are not alive, callers report them
+        return e < MAX_ENTITY && mAlive[e];
+    }
+
+    // Inline as every creation and destruction checks it
+    inline bool EntityManager::haveReserved() const
+    {
+        return mCursor.load(std::memory_order_relaxed) != (int64_t)mFree.size();
+    }
 }
 
 #endif // ARCHETYPE_ENTITYMANAGER_HPP
@@ -0,0 +1,79 @@
+#ifndef ARCHETYPE_HIERARCHY_HPP
+#define ARCHETYPE_HIERARCHY_HPP
+
+/*
+* Hierarchy stores parent/child relationships
+* between entities and keeps a breadth-first
+* ordering of every entity taking part in one:
+*
+*   order   :   R1 R2 | A B C | D E
+*   depth   :   0       1       2
+*   parents :   -  -  | 0 0 1 | 2 2     (positions in order)
+*
+* Parents always come before their children, so
+* hierarchical updates (e.g. transform propagation)
+* are one pass over the order, and entities of the
+* same depth can be processed in parallel.
+* The order is one of entity IDs: components stay
+* where their archetypes keep them, so reading them
+* in depth order is a lookup per entity, best
+* batched with Engine::getComponents().
+* The ordering is rebuilt lazily after changes.
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Parent/child relationships with depth-ordered traversal
+    class ARCHETYPE_API Hierarchy
+    {
+    public:
+        // Position of roots' parents in getDepthParents()
+        static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+        Hierarchy();
+        // Does nothing if parent is child or one of its descendants
+        void setParent(Entity child, Entity parent);
+        // Make child a root, do nothing if it has no parent
+        void removeParent(Entity child);
+        // Returns NULL_ENTITY for roots and entities without relationship
+        Entity getParent(Entity entity) const;
+        const std::vector<Entity>& getChildren(Entity entity) const;
+        // True if entity has a parent or a child
+        bool contain(Entity entity) const;
+        // True if ancestor is entity or one of its ancestors
+        bool isAncestor(Entity ancestor, Entity entity) const;
+        // Detach entity from its parent, forget it and its descendants and return them (entity included)
+        std::vector<Entity> removeSubtree(Entity entity);
+
+        // Depth-ordered traversal
+
+        // Every entity with a relationship, roots first then depth by depth
+        const std::vector<Entity>& getDepthOrder();
+        // [i] = position of the parent of getDepthOrder()[i] in getDepthOrder(), or NO_PARENT
+        const std::vector<uint32_t>& getDepthParents();
+        // Entities of depth d are at [offsets[d], offsets[d + 1]) in getDepthOrder()
+        const std::vector<uint32_t>& getDepthOffsets();
+        // Approximate heap memory of the relationships and the cached ordering
+        std::size_t getByteSize() const;
+    private:
+        void rebuild();
+    private:
+        std::unordered_map<Entity, Entity> mParents;
+        std::unordered_map<Entity, std::vector<Entity>> mChildren;
+        std::vector<Entity> mNoChildren;
+
+        // Cached ordering
+        bool mDirty;
+        std::vector<Entity> mOrder;
+        std::vector<uint32_t> mOrderParents;
+        std::vector<uint32_t> mOffsets;
+    };
+}
+
+#endif // ARCHETYPE_HIERARCHY_HPP
@@ -9,8 +9,10 @@
 #include "Macros.hpp"
 #include "Identifier.hpp"
 
+#include <string>
 #include <unordered_map>
 #include <typeinfo>
+#include <vector>
 #include <iostream>
 
 namespace ECS
@@ -24,6 +26,7 @@ namespace ECS
         void registerType();
         template<typename T1, typename T2, typename... Ts>
         void registerType();
+        // MAX_COMPONENT_TYPE once a check failed if T is not registered
         template <typename T>
         ComponentType getType() const;
         template <typename T>
@@ -32,6 +35,14 @@ namespace ECS
         Identifier generateIdentifier() const;
         template <typename T>
         bool haveType() const;
+        // Types registered by name, for runtime components (see RawComponent.hpp)
+        // name must outlive the generator, types are keyed by its address
+        ComponentType registerName(const char* name);
+        ComponentType getType(const char* name) const;
+        bool haveName(const char* name) const;
+        // [type in other] = the type with the same name in this generator
+        // Every type of other must be registered here as well
+        std::vector<ComponentType> getRemap(const IDGenerator& other) const;
     private:
         std::unordered_map<const char*, ComponentType> mTypeNumber;
         ComponentType mAvailableType;
@@ -56,29 +67,24 @@ namespace ECS
     template <typename T>
     ComponentType IDGenerator::getType() const
     {
-        auto name = typeid(T).name();
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered in IDGenerator"));
-
-        return mTypeNumber.at(name);
+        auto found = mTypeNumber.find(typeid(T).name());
+        ECS_ASSERT_OR_RETURN(found != mTypeNumber.end(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered in IDGenerator"), MAX_COMPONENT_TYPE);
+        return found->second;
     }
 
     template <typename T>
     Identifier IDGenerator::generateIdentifier() const
     {
-        const char* name = typeid(T).name();
-        ECS_ASSERT(haveType<T>(), ((std::string)"Component type " + (typeid(T).name()) + " was not registered in IDGenerator"));
         Identifier id;
-        id.setType(mTypeNumber.at(name));
+        id.setType(getType<T>());
         return id;
     }
 
     template <typename T1, typename T2, typename... Ts>
     Identifier IDGenerator::generateIdentifier() const
     {
-        const char* name = typeid(T1).name();
-        ECS_ASSERT(haveType<T1>(), ((std::string)"Component type " + (typeid(T1).name()) + " was not registered in IDGenerator"));
         Identifier res = generateIdentifier<T2, Ts...>();
-        res.setType(mTypeNumber.at(name));
+        res.setType(getType<T1>());
         return res;
     }
 
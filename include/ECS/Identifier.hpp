@@ -4,13 +4,18 @@
 /*
 * Identifier is used to classify Processor, Entity and
 * Archetype.
+* Component types are kept sorted in an inline array,
+* so typical identifiers never allocate; only those
+* with more than INLINE_CAPACITY types spill to the
+* heap. A 64-bit hash is updated on every change so
+* identifiers can key hash maps without rehashing.
 */
 
 #include "Macros.hpp"
 #include "Properties.hpp"
 
-#include <bitset>
-#include <unordered_set>
+#include <array>
+#include <cstddef>
 #include <vector>
 
 namespace ECS
@@ -19,20 +24,44 @@ namespace ECS
     class ARCHETYPE_API Identifier
     {
     public:
+        static constexpr std::size_t INLINE_CAPACITY = 16;
+
         Identifier();
         Identifier(const std::vector<ComponentType>& ts);
-        void setType(ComponentType t1);
+        // False, changing nothing, if t1 is already set
+        bool setType(ComponentType t1);
         void setType(const std::vector<ComponentType>& ts);
-        void removeType(ComponentType t);
+        // False if t was not set
+        bool removeType(ComponentType t);
+        bool haveType(ComponentType t) const;
         // Check if id's component types are all included in this Identifier
         bool contain(const Identifier& id) const;
-        const std::bitset<MAX_COMPONENT_TYPE>& getValue() const;
-        const std::unordered_set<ComponentType>& getAllType() const;
+        uint64_t getHash() const;
+        std::size_t getSize() const;
+        // Component types in ascending order
+        const ComponentType* begin() const;
+        const ComponentType* end() const;
+        bool operator == (const Identifier& id) const;
+        bool operator != (const Identifier& id) const;
         // Swap the contents of two Identifiers
         void swap(Identifier& obj);
     private:
-        std::bitset<MAX_COMPONENT_TYPE> mValue;
-        std::unordered_set<ComponentType> mTypes;
+        ComponentType* data();
+    private:
+        std::array<ComponentType, INLINE_CAPACITY> mInline;
+        // Used instead of mInline when there are more than INLINE_CAPACITY types
+        std::vector<ComponentType> mOverflow;
+        uint32_t mSize;
+        uint64_t mHash;
+    };
+
+    // Allow Identifier as key of unordered containers
+    struct IdentifierHash
+    {
+        std::size_t operator () (const Identifier& id) const
+        {
+            return (std::size_t)id.getHash();
+        }
     };
 }
 
@@ -0,0 +1,307 @@
+#ifndef ARCHETYPE_INDEX_HPP
+#define ARCHETYPE_INDEX_HPP
+
+/*
+* Secondary indexes map a key computed from a
+* component's value to the entities holding it.
+* HashIndex answers equality lookups in O(1),
+* SortedIndex answers range lookups in O(log n).
+* Indexes are kept up to date by Engine, see
+* IndexManager.hpp.
+* Lookup keys of another type are converted with
+* convertIndexKey(), which never casts a value
+* the key type cannot hold
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // How convertIndexKey() treats a key the index key type cannot hold exactly
+    enum class KeyRounding
+    {
+        // No conversion, the key matches nothing
+        Exact,
+        // The smallest value not below the key, for the low bound of a range
+        Up,
+        // The largest value not above the key, for the high bound of a range
+        Down
+    };
+
+    // key as index key type K, following rounding if K cannot hold it. Empty if no value of K
+    // qualifies (NaN, a bound past every value of K). Non-arithmetic keys are cast
+    template <typename K, typename Key>
+    std::optional<K> convertIndexKey(const Key& key, KeyRounding rounding);
+
+    // Base class of every index
+    class ARCHETYPE_API IComponentIndex
+    {
+    public:
+        IComponentIndex();
+        virtual ~IComponentIndex();
+        // Do nothing if entity is not indexed
+        virtual void removeEntity(Entity entity) = 0;
+        // setEntity() with component given by address, for type-erased callers
+        virtual void setEntityRaw(Entity entity, const void* component) = 0;
+        // Approximate heap memory of the index, memory owned by keys left out
+        virtual std::size_t getByteSize() const = 0;
+    };
+
+    // Base class of indexes over component type T
+    template <typename T>
+    class ITypedIndex : public IComponentIndex
+    {
+    public:
+        // Insert entity or update its key
+        virtual void setEntity(Entity entity, const T& component) = 0;
+        void setEntityRaw(Entity entity, const void* component) override
+        {
+            setEntity(entity, *static_cast<const T*>(component));
+        }
+    };
+
+    // Equality lookup of entities by Key
+    template <typename T, typename Key>
+    class HashIndex : public ITypedIndex<T>
+    {
+    public:
+        using KeyFunction = std::function<Key(const T&)>;
+        using KeyType = Key;
+
+        HashIndex(KeyFunction keyFunction);
+        void setEntity(Entity entity, const T& component) override;
+        void removeEntity(Entity entity) override;
+        std::size_t getByteSize() const override;
+
+        // Returns any entity with key or NULL_ENTITY
+        Entity find(const Key& key) const;
+        std::vector<Entity> findAll(const Key& key) const;
+    private:
+        KeyFunction mKeyFunction;
+        std::unordered_multimap<Key, Entity> mEntities;
+        std::unordered_map<Entity, Key> mKeys;
+    };
+
+    // Ordered lookup of entities by Key
+    template <typename T, typename Key>
+    class SortedIndex : public ITypedIndex<T>
+    {
+    public:
+        using KeyFunction = std::function<Key(const T&)>;
+        using KeyType = Key;
+
+        SortedIndex(KeyFunction keyFunction);
+        void setEntity(Entity entity, const T& component) override;
+        void removeEntity(Entity entity) override;
+        std::size_t getByteSize() const override;
+
+        // Returns any entity with key or NULL_ENTITY
+        Entity find(const Key& key) const;
+        // Entities whose keys are in [low, high], ordered by key
+        std::vector<Entity> findRange(const Key& low, const Key& high) const;
+    private:
+        using Container = std::multimap<Key, Entity>;
+
+        KeyFunction mKeyFunction;
+        Container mEntities;
+        std::unordered_map<Entity, typename Container::iterator> mPositions;
+    };
+
+    template <typename K, typename Key>
+    std::optional<K> convertIndexKey(const Key& key, KeyRounding rounding)
+    {
+        using Limits = std::numeric_limits<K>;
+        if constexpr (std::is_arithmetic_v<K> == false || std::is_arithmetic_v<Key> == false)
+            return static_cast<K>(key);
+        else if constexpr (std::is_integral_v<K> && std::is_integral_v<Key>)
+        {
+            // Compared as the widest integers, bool being 0 or 1
+            bool below = false, above = false;
+            if constexpr (std::is_signed_v<Key>)
+            {
+                below = key < 0 && (std::is_signed_v<K> == false || (intmax_t)key < (intmax_t)Limits::min());
+                above = key > 0 && (uintmax_t)key > (uintmax_t)Limits::max();
+            }
+            else
+                above = (uintmax_t)key > (uintmax_t)Limits::max();
+            if (below)
+                return rounding == KeyRounding::Up ? std::optional<K>(Limits::min()) : std::nullopt;
+            if (above)
+                return rounding == KeyRounding::Down ? std::optional<K>(Limits::max()) : std::nullopt;
+            return static_cast<K>(key);
+        }
+        else if constexpr (std::is_integral_v<K>)
+        {
+            // A floating key, only cast once it is integral and in range
+            if (std::isnan(key))
+                return std::nullopt;
+            long double value = key;
+            long double rounded = rounding == KeyRounding::Up ? std::ceil(value) : rounding == KeyRounding::Down ? std::floor(value) : value;
+            if (rounded != std::trunc(rounded))
+                return std::nullopt;
+            // Powers of two, exact in any floating type
+            long double low = std::is_signed_v<K> ? -std::ldexp(1.0L, Limits::digits) : 0.0L;
+            long double end = std::ldexp(1.0L, Limits::digits);
+            if (rounded < low)
+                return rounding == KeyRounding::Up ? std::optional<K>(Limits::min()) : std::nullopt;
+            if (rounded >= end)
+                return rounding == KeyRounding::Down ? std::optional<K>(Limits::max()) : std::nullopt;
+            return static_cast<K>(rounded);
+        }
+        else
+        {
+            // A floating index key type, infinities being its own bounds
+            if constexpr (std::is_floating_point_v<Key>)
+            {
+                if (std::isnan(key))
+                    return std::nullopt;
+                if (std::isinf(key) == false && (long double)key > (long double)Limits::max())
+                    return rounding == KeyRounding::Down ? std::optional<K>(Limits::max()) : rounding == KeyRounding::Up ? std::optional<K>(Limits::infinity()) : std::nullopt;
+                if (std::isinf(key) == false && (long double)key < (long double)Limits::lowest())
+                    return rounding == KeyRounding::Up ? std::optional<K>(Limits::lowest()) : rounding == KeyRounding::Down ? std::optional<K>(-Limits::infinity()) : std::nullopt;
+            }
+            K converted = static_cast<K>(key);
+            if ((long double)converted == (long double)key)
+                return converted;
+            if (rounding == KeyRounding::Exact)
+                return std::nullopt;
+            // Rounded to nearest, step once toward the side asked for
+            if (rounding == KeyRounding::Up && (long double)converted < (long double)key)
+                converted = std::nextafter(converted, Limits::infinity());
+            else if (rounding == KeyRounding::Down && (long double)converted > (long double)key)
+                converted = std::nextafter(converted, -Limits::infinity());
+            return converted;
+        }
+    }
+
+    template <typename T, typename Key>
+    HashIndex<T, Key>::HashIndex(KeyFunction keyFunction)
+        : mKeyFunction(std::move(keyFunction))
+    { }
+
+    template <typename T, typename Key>
+    void HashIndex<T, Key>::setEntity(Entity entity, const T& component)
+    {
+        Key key = mKeyFunction(component);
+        auto found = mKeys.find(entity);
+        if (found != mKeys.end())
+        {
+            if (found->second == key)
+                return;
+            removeEntity(entity);
+        }
+        mEntities.emplace(key, entity);
+        mKeys.emplace(entity, std::move(key));
+    }
+
+    template <typename T, typename Key>
+    void HashIndex<T, Key>::removeEntity(Entity entity)
+    {
+        auto found = mKeys.find(entity);
+        if (found == mKeys.end())
+            return;
+        auto range = mEntities.equal_range(found->second);
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second == entity)
+            {
+                mEntities.erase(it);
+                break;
+            }
+        mKeys.erase(found);
+    }
+
+    template <typename T, typename Key>
+    std::size_t HashIndex<T, Key>::getByteSize() const
+    {
+        // A hash node holds the pair and a next pointer, buckets are one pointer each
+        return mEntities.size() * (sizeof(std::pair<const Key, Entity>) + sizeof(void*))
+            + mKeys.size() * (sizeof(std::pair<const Entity, Key>) + sizeof(void*))
+            + (mEntities.bucket_count() + mKeys.bucket_count()) * sizeof(void*);
+    }
+
+    template <typename T, typename Key>
+    Entity HashIndex<T, Key>::find(const Key& key) const
+    {
+        auto found = mEntities.find(key);
+        return found == mEntities.end() ? NULL_ENTITY : found->second;
+    }
+
+    template <typename T, typename Key>
+    std::vector<Entity> HashIndex<T, Key>::findAll(const Key& key) const
+    {
+        std::vector<Entity> res;
+        auto range = mEntities.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+            res.push_back(it->second);
+        return res;
+    }
+
+    template <typename T, typename Key>
+    SortedIndex<T, Key>::SortedIndex(KeyFunction keyFunction)
+        : mKeyFunction(std::move(keyFunction))
+    { }
+
+    template <typename T, typename Key>
+    void SortedIndex<T, Key>::setEntity(Entity entity, const T& component)
+    {
+        Key key = mKeyFunction(component);
+        auto found = mPositions.find(entity);
+        if (found != mPositions.end())
+        {
+            if (!(found->second->first < key) && !(key < found->second->first))
+                return;
+            mEntities.erase(found->second);
+            found->second = mEntities.emplace(std::move(key), entity);
+        }
+        else
+            mPositions.emplace(entity, mEntities.emplace(std::move(key), entity));
+    }
+
+    template <typename T, typename Key>
+    void SortedIndex<T, Key>::removeEntity(Entity entity)
+    {
+        auto found = mPositions.find(entity);
+        if (found == mPositions.end())
+            return;
+        mEntities.erase(found->second);
+        mPositions.erase(found);
+    }
+
+    template <typename T, typename Key>
+    std::size_t SortedIndex<T, Key>::getByteSize() const
+    {
+        // A tree node holds the pair, three pointers and its color
+        constexpr std::size_t positionSize = sizeof(std::pair<const Entity, typename Container::iterator>) + sizeof(void*);
+        return mEntities.size() * (sizeof(typename Container::value_type) + 4 * sizeof(void*))
+            + mPositions.size() * positionSize + mPositions.bucket_count() * sizeof(void*);
+    }
+
+    template <typename T, typename Key>
+    Entity SortedIndex<T, Key>::find(const Key& key) const
+    {
+        auto found = mEntities.find(key);
+        return found == mEntities.end() ? NULL_ENTITY : found->second;
+    }
+
+    template <typename T, typename Key>
+    std::vector<Entity> SortedIndex<T, Key>::findRange(const Key& low, const Key& high) const
+    {
+        std::vector<Entity> res;
+        for (auto it = mEntities.lower_bound(low); it != mEntities.end() && !(high < it->first); ++it)
+            res.push_back(it->second);
+        return res;
+    }
+}
+
+#endif // ARCHETYPE_INDEX_HPP
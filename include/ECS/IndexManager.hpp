@@ -0,0 +1,167 @@
+#ifndef ARCHETYPE_INDEXMANAGER_HPP
+#define ARCHETYPE_INDEXMANAGER_HPP
+
+/*
+* Wrapper class for secondary indexes' registration,
+* lookup and update. Engine notifies it whenever a
+* component is added, written through the engine,
+* removed or its entity destroyed
+*/
+
+#include "Macros.hpp"
+#include "Index.hpp"
+
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Wrapper class for indexes' registration and updates
+    class ARCHETYPE_API IndexManager
+    {
+    public:
+        IndexManager();
+
+        // Registration, at most one index of each kind and key type per component type
+
+        template <typename T, typename Key>
+        HashIndex<T, Key>& addHashIndex(typename HashIndex<T, Key>::KeyFunction keyFunction);
+        template <typename T, typename Key>
+        SortedIndex<T, Key>& addSortedIndex(typename SortedIndex<T, Key>::KeyFunction keyFunction);
+        template <typename T, typename Key>
+        bool haveHashIndex() const;
+        template <typename T, typename Key>
+        bool haveSortedIndex() const;
+
+        // Lookups
+
+        template <typename T, typename Key>
+        const HashIndex<T, Key>& getHashIndex() const;
+        template <typename T, typename Key>
+        const SortedIndex<T, Key>& getSortedIndex() const;
+        // nullptr if there is no such index
+        template <typename T, typename Key>
+        const HashIndex<T, Key>* findHashIndex() const;
+        template <typename T, typename Key>
+        const SortedIndex<T, Key>* findSortedIndex() const;
+
+        // Updates
+
+        template <typename T>
+        void setEntity(Entity entity, const T& component);
+        template <typename T>
+        void removeEntity(Entity entity);
+        // Remove entity from indexes of every component type
+        void removeEntity(Entity entity);
+        // setEntity() for the component type named typeName, component given by address
+        void setEntity(const char* typeName, Entity entity, const void* component);
+        // Approximate heap memory of every index
+        std::size_t getByteSize() const;
+    private:
+        template <typename T, typename Index>
+        Index* findIndex() const;
+    private:
+        // [type name] = indexes of that component type
+        std::unordered_map<const char*, std::vector<std::shared_ptr<IComponentIndex>>> mIndices;
+    };
+
+    template <typename T, typename Key>
+    HashIndex<T, Key>& IndexManager::addHashIndex(typename HashIndex<T, Key>::KeyFunction keyFunction)
+    {
+        ECS_ASSERT((findIndex<T, HashIndex<T, Key>>() == nullptr), ((std::string)"Hash index of component type " + (typeid(T).name()) + " added twice"));
+        auto index = std::make_shared<HashIndex<T, Key>>(std::move(keyFunction));
+        mIndices[typeid(T).name()].push_back(index);
+        return *index;
+    }
+
+    template <typename T, typename Key>
+    SortedIndex<T, Key>& IndexManager::addSortedIndex(typename SortedIndex<T, Key>::KeyFunction keyFunction)
+    {
+        ECS_ASSERT((findIndex<T, SortedIndex<T, Key>>() == nullptr), ((std::string)"Sorted index of component type " + (typeid(T).name()) + " added twice"));
+        auto index = std::make_shared<SortedIndex<T, Key>>(std::move(keyFunction));
+        mIndices[typeid(T).name()].push_back(index);
+        return *index;
+    }
+
+    template <typename T, typename Key>
+    bool IndexManager::haveHashIndex() const
+    {
+        return findIndex<T, HashIndex<T, Key>>() != nullptr;
+    }
+
+    template <typename T, typename Key>
+    bool IndexManager::haveSortedIndex() const
+    {
+        return findIndex<T, SortedIndex<T, Key>>() != nullptr;
+    }
+
+    template <typename T, typename Key>
+    const HashIndex<T, Key>& IndexManager::getHashIndex() const
+    {
+        auto res = findIndex<T, HashIndex<T, Key>>();
+        ECS_ASSERT(res != nullptr, ((std::string)"No hash index of component type " + (typeid(T).name()) + " with key type " + (typeid(Key).name())));
+        return *res;
+    }
+
+    template <typename T, typename Key>
+    const SortedIndex<T, Key>& IndexManager::getSortedIndex() const
+    {
+        auto res = findIndex<T, SortedIndex<T, Key>>();
+        ECS_ASSERT(res != nullptr, ((std::string)"No sorted index of component type " + (typeid(T).name()) + " with key type " + (typeid(Key).name())));
+        return *res;
+    }
+
+    template <typename T, typename Key>
+    const HashIndex<T, Key>* IndexManager::findHashIndex() const
+    {
+        return findIndex<T, HashIndex<T, Key>>();
+    }
+
+    template <typename T, typename Key>
+    const SortedIndex<T, Key>* IndexManager::findSortedIndex() const
+    {
+        return findIndex<T, SortedIndex<T, Key>>();
+    }
+
+    template <typename T>
+    void IndexManager::setEntity(Entity entity, const T& component)
+    {
+        // Most engines have no index at all
+        if (mIndices.empty())
+            return;
+        auto found = mIndices.find(typeid(T).name());
+        if (found == mIndices.end())
+            return;
+        for (const auto& index : found->second)
+            std::static_pointer_cast<ITypedIndex<T>>(index)->setEntity(entity, component);
+    }
+
+    template <typename T>
+    void IndexManager::removeEntity(Entity entity)
+    {
+        if (mIndices.empty())
+            return;
+        auto found = mIndices.find(typeid(T).name());
+        if (found == mIndices.end())
+            return;
+        for (const auto& index : found->second)
+            index->removeEntity(entity);
+    }
+
+    template <typename T, typename Index>
+    Index* IndexManager::findIndex() const
+    {
+        auto found = mIndices.find(typeid(T).name());
+        if (found == mIndices.end())
+            return nullptr;
+        for (const auto& index : found->second)
+            if (auto res = dynamic_cast<Index*>(index.get()))
+                return res;
+        return nullptr;
+    }
+}
+
+#endif // ARCHETYPE_INDEXMANAGER_HPP
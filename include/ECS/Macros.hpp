@@ -5,38 +5,95 @@
 * ARCHRTYPE_DLL         :       Define if building library from source
 * ARCHETYPE_DEBUG       :       Should be defined if built / used in debug mode;
 *                               Once defined, the library requires linking to "Dbghelp" when built with MSVC
+* ARCHETYPE_CHECKED     :       Define to keep checks in release builds: failures are counted and
+*                               reported (see Backtrack.hpp) instead of exiting;
+*                               Must be defined both when building and using the library
+* ARCHETYPE_PROFILE     :       Define to record engine instrumentation (see Profiler.hpp);
+*                               Must be defined both when building and using the library
 */
 #include <cassert>
 #include <iostream>
 
-#ifdef ARCHETYPE_DLL
-    #define ARCHETYPE_API __declspec(dllexport)
+#if defined(_WIN32)
+    #ifdef ARCHETYPE_DLL
+        #define ARCHETYPE_API __declspec(dllexport)
+    #else
+        #define ARCHETYPE_API __declspec(dllimport)
+    #endif // ARCHETYPE_DLL
 #else
-    #define ARCHETYPE_API __declspec(dllimport)
-#endif // ARCHETYPE_DLL
+    #define ARCHETYPE_API __attribute__((visibility("default")))
+#endif // _WIN32
 
 #if !defined(__PRETTY_FUNCTION__) && !defined(__GNUC__)
 #define __PRETTY_FUNCTION__ __FUNCSIG__
 #endif
 
-#ifdef ARCHETYPE_DEBUG
+// Branch hint and out-of-line attribute for the failure path of checks
+#if defined(__GNUC__)
+#define ECS_LIKELY(X) __builtin_expect(!!(X), 1)
+#define ECS_COLD __attribute__((cold, noinline))
+#else
+#define ECS_LIKELY(X) (X)
+#define ECS_COLD
+#endif
+
+#if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
 #include "Backtrack.hpp"
-// if not X then write Y and exit
+// if not X then report Y (see setCheckHandler), which by default exits in debug mode
+// and counts the failure in checked mode. Y is only built on failure, in a cold function
+// kept out of the caller's code
 #define ECS_ASSERT(X, Y){\
-if (X) \
+if (ECS_LIKELY(X)) \
+{} \
+else \
+{\
+    [&](const char* function) ECS_COLD \
+    {\
+        ::ECS::reportCheckFailure(std::string(Y), function, __FILE__, __LINE__);\
+    }(__PRETTY_FUNCTION__);\
+}\
+}
+// ECS_ASSERT that also returns ... from the caller on failure, for checks guarding memory
+// accesses so that checked builds carry on without undefined behavior
+#define ECS_ASSERT_OR_RETURN(X, Y, ...){\
+if (ECS_LIKELY(X)) \
 {} \
 else \
 {\
-    std::cerr << "ECS: Assertion: " << Y << '\n';\
-    std::cerr << "In function: " << __PRETTY_FUNCTION__ << '\n';\
-    std::cerr << "At: " << __FILE__ << ", line " << __LINE__ << '\n';\
-    std::cerr << "Last called function(s):\n";\
-    printStackTrace();\
-    exit(-1);\
+    [&](const char* function) ECS_COLD \
+    {\
+        ::ECS::reportCheckFailure(std::string(Y), function, __FILE__, __LINE__);\
+    }(__PRETTY_FUNCTION__);\
+    return __VA_ARGS__;\
 }\
 }
 #else
 #define ECS_ASSERT(X, Y) {}
+#define ECS_ASSERT_OR_RETURN(X, Y, ...) {}
+#endif // ARCHETYPE_DEBUG || ARCHETYPE_CHECKED
+
+// Checks too costly for checked mode (RTTI, scans), only compiled in debug mode
+#ifdef ARCHETYPE_DEBUG
+#define ECS_DEBUG_ASSERT(X, Y) ECS_ASSERT(X, Y)
+#else
+#define ECS_DEBUG_ASSERT(X, Y) {}
 #endif // ARCHETYPE_DEBUG
 
+// Hint the CPU to fetch the cache line holding X for reading
+#if defined(__GNUC__)
+#define ECS_PREFETCH(X) __builtin_prefetch(X)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define ECS_PREFETCH(X) _mm_prefetch((const char*)(X), _MM_HINT_T0)
+#else
+#define ECS_PREFETCH(X) ((void)0)
+#endif
+
+#ifdef ARCHETYPE_PROFILE
+// Only compiled in when instrumentation is enabled
+#define ECS_PROFILE(...) __VA_ARGS__
+#else
+#define ECS_PROFILE(...)
+#endif // ARCHETYPE_PROFILE
+
 #endif // ARCHETYPE_MACRO_HPP
@@ -0,0 +1,106 @@
+#ifndef ARCHETYPE_OBSERVER_HPP
+#define ARCHETYPE_OBSERVER_HPP
+
+/*
+* Observers are callbacks Engine fires when a
+* component is added to, written through the
+* engine to or removed from an entity (destroying
+* an entity removes all of its components).
+* A ReactiveQuery collects entities touched by
+* such events into a dense list between runs, so
+* a processor only visits changed entities:
+*
+*   query   :   Collider, RigidBody     (types)
+*   events  :   Add                     (triggers)
+*   list    :   [ 12, 7, 40 ]           entities that gained one of the
+*                                       types and now have all of them
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+#include "Identifier.hpp"
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Component events, can be combined with |
+    enum class ObserverEvent : uint32_t
+    {
+        Add = 1,
+        Remove = 2,
+        Set = 4
+    };
+
+    inline ObserverEvent operator | (ObserverEvent a, ObserverEvent b)
+    {
+        return (ObserverEvent)((uint32_t)a | (uint32_t)b);
+    }
+
+    inline bool haveEvent(ObserverEvent events, ObserverEvent e)
+    {
+        return ((uint32_t)events & (uint32_t)e) != 0;
+    }
+
+    // Dense list of entities accumulated from component events
+    class ARCHETYPE_API ReactiveQuery
+    {
+    public:
+        ReactiveQuery(const Identifier& id, ObserverEvent events);
+        // Entities collected since last clear(), each once, in order of arrival
+        const std::vector<Entity>& getEntities() const;
+        bool haveEntity(Entity entity) const;
+        void clear();
+        const Identifier& getIdentifier() const;
+    private:
+        friend class ObserverManager;
+        // entityID is the identifier of the entity once the event is done
+        void notify(ObserverEvent event, Entity entity, const Identifier& entityID);
+        void push(Entity entity);
+        void drop(Entity entity);
+    private:
+        Identifier mID;
+        ObserverEvent mEvents;
+        std::vector<Entity> mEntities;
+        // [entity] = position of entity in mEntities
+        std::unordered_map<Entity, uint32_t> mPositions;
+    };
+
+    // Wrapper class for observers' and reactive queries' registration and notification
+    class ARCHETYPE_API ObserverManager
+    {
+    public:
+        using Callback = std::function<void(Entity)>;
+
+        ObserverManager();
+        void addObserver(ComponentType type, ObserverEvent event, Callback callback);
+        std::shared_ptr<ReactiveQuery> addQuery(const Identifier& id, ObserverEvent events);
+        // Fire event of type for entity, cheap when nothing observes any type
+        void notify(ComponentType type, ObserverEvent event, Entity entity, const Identifier& entityID)
+        {
+            if (mEmpty == false)
+                dispatch(type, event, entity, entityID);
+        }
+        // Drop a destroyed entity from every query
+        void removeEntity(Entity entity);
+        // Events of entities having type are not dispatched
+        void addExcludedType(ComponentType type);
+    private:
+        void dispatch(ComponentType type, ObserverEvent event, Entity entity, const Identifier& entityID);
+    private:
+        bool mEmpty;
+        std::vector<ComponentType> mExcludedTypes;
+        // [type] = callbacks of that component type, one list per event
+        std::unordered_map<ComponentType, std::vector<Callback>> mOnAdd;
+        std::unordered_map<ComponentType, std::vector<Callback>> mOnRemove;
+        std::unordered_map<ComponentType, std::vector<Callback>> mOnSet;
+        std::vector<std::shared_ptr<ReactiveQuery>> mQueries;
+        // [type] = queries whose identifier contains type
+        std::unordered_map<ComponentType, std::vector<ReactiveQuery*>> mTypeQueries;
+    };
+}
+
+#endif // ARCHETYPE_OBSERVER_HPP
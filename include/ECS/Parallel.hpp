@@ -0,0 +1,148 @@
+#ifndef ARCHETYPE_PARALLEL_HPP
+#define ARCHETYPE_PARALLEL_HPP
+
+/*
+* Deterministic parallel iteration, for lockstep
+* simulations that must give the same result on
+* every peer whatever its thread count.
+* Rows of the matching archetypes are cut into
+* partitions of a fixed size, in archetype slot
+* order then row order, and numbered:
+*
+*   archetype 2 :   [ 0 | 1 | 2 ]
+*   archetype 5 :   [ 3 | 4 ]
+*
+* Threads take partitions in any order. Each one
+* records its structural changes in its own
+* CommandBuffer, applied in partition order once
+* every partition is done. Partitions and slots
+* only depend on the sequence of engine calls, so
+* as long as fn writes nothing but the rows of its
+* partition and results[partition.index], folding
+* those results in order gives the same bits for
+* any thread count
+*/
+
+#include "CommandBuffer.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace ECS
+{
+    // Rows handed to one call of ParallelExecutor::forEach()'s function
+    struct ParallelPartition
+    {
+        // Position among the partitions of the call, from 0
+        std::size_t index;
+        std::size_t count;
+        // count entities, in row order
+        const Entity* entities;
+        // Applied after every partition of the call is done
+        CommandBuffer& commands;
+    };
+
+    // Runs functions over fixed-size partitions on a pool of threads
+    class ARCHETYPE_API ParallelExecutor
+    {
+    public:
+        static constexpr std::size_t DEFAULT_PARTITION_SIZE = Archetype::CHUNK_SIZE;
+
+        // threads counts the calling thread, which takes part in every call. Peers must
+        // use the same partitionSize, not the same thread count
+        ParallelExecutor(Engine& engine, unsigned threads, std::size_t partitionSize = DEFAULT_PARTITION_SIZE);
+        ParallelExecutor(const ParallelExecutor&) = delete;
+        ParallelExecutor& operator = (const ParallelExecutor&) = delete;
+        ~ParallelExecutor();
+
+        // Number of partitions forEach<T1, Ts...>() would use now, to size per-partition results
+        template <typename T1, typename... Ts>
+        std::size_t getPartitionCount();
+        // Call fn(const ParallelPartition& partition, T1* column, Ts*... columns) for every partition
+        // of the archetypes having all of the types, then apply the partitions' commands in order.
+        // Columns start at the partition's first row. Writes to columns are not seen by
+        // indexes, observers nor kept orders. Types may be const, the partitions' rows of the
+        // others are reported written (see Archetype::markRowsDirty) before any thread starts
+        template <typename T1, typename... Ts, typename Fn>
+        void forEach(Fn fn);
+        unsigned getThreadCount() const;
+        std::size_t getPartitionSize() const;
+    private:
+        struct Range
+        {
+            Archetype* archetype;
+            std::size_t begin;
+            std::size_t count;
+        };
+
+        // Fill mRanges with the partitions of the archetypes matching id
+        void partition(const Identifier& id);
+        // Run task(i) for every i in [0, count) and return once all are done
+        void run(std::size_t count, const std::function<void(std::size_t)>& task);
+        // Run the tasks not taken yet by another thread
+        void drain();
+        void work();
+        void applyCommands();
+    private:
+        Engine& mEngine;
+        std::size_t mPartitionSize;
+        std::vector<Range> mRanges;
+        // [partition] = commands, kept between calls to reuse their memory
+        std::vector<CommandBuffer> mCommands;
+
+        // Pool
+
+        std::vector<std::thread> mWorkers;
+        std::mutex mMutex;
+        // Workers wait for a new generation, the caller for mBusy to reach 0
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        uint64_t mGeneration;
+        unsigned mBusy;
+        bool mStop;
+        const std::function<void(std::size_t)>* mTask;
+        std::size_t mTaskCount;
+        std::atomic<std::size_t> mNextTask;
+    };
+
+    template <typename T1, typename... Ts>
+    std::size_t ParallelExecutor::getPartitionCount()
+    {
+        partition(mEngine.generateIdentifier<T1, Ts...>());
+        return mRanges.size();
+    }
+
+    template <typename T1, typename... Ts, typename Fn>
+    void ParallelExecutor::forEach(Fn fn)
+    {
+        partition(mEngine.generateIdentifier<T1, Ts...>());
+        // Columns are looked up and dirtied on this thread, once per archetype, so workers
+        // only touch the rows of their partitions
+        std::vector<std::tuple<T1*, Ts*...>> columns(mRanges.size());
+        for (std::size_t i = 0; i < mRanges.size(); ++i)
+        {
+            const Range& range = mRanges[i];
+            columns[i] = i > 0 && mRanges[i - 1].archetype == range.archetype ? columns[i - 1] : range.archetype->getColumns<T1, Ts...>();
+            if (std::get<T1*>(columns[i]) != nullptr)
+                range.archetype->markRowsDirty<T1, Ts...>(range.begin, range.count);
+        }
+        std::function<void(std::size_t)> task = [this, &fn, &columns](std::size_t i)
+        {
+            const Range& range = mRanges[i];
+            const std::tuple<T1*, Ts*...>& column = columns[i];
+            if (std::get<T1*>(column) == nullptr)
+                return;
+            ParallelPartition partition{ i, range.count, range.archetype->getEntities().data() + range.begin, mCommands[i] };
+            fn(static_cast<const ParallelPartition&>(partition), std::get<T1*>(column) + range.begin, (std::get<Ts*>(column) + range.begin)...);
+        };
+        run(mRanges.size(), task);
+        applyCommands();
+    }
+}
+
+#endif // ARCHETYPE_PARALLEL_HPP
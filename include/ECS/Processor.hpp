@@ -16,18 +16,51 @@
 * {
 *   // Do something
 * }
+*
+* Processors that do not have to visit every entity
+* each frame can iterate in slices instead: each
+* forEachSlice() call resumes where the previous one
+* stopped and ends once its SliceBudget is spent.
+*
+* Processors declare the resources they read and
+* write, two processors may run in parallel only if
+* conflictsWith() is false for them
 */
 
 #include "Macros.hpp"
 #include "IDGenerator.hpp"
 #include "Archetype.hpp"
+#include "Profiler.hpp"
+#include "Resource.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 
+// Place at the top of a processor's method to time it as one run of the processor
+#ifdef ARCHETYPE_PROFILE
+#define ECS_PROFILE_PROCESSOR() ECS::ProfileScope ecsProcessorScope(getProfiler(), getName(), true)
+#else
+#define ECS_PROFILE_PROCESSOR()
+#endif // ARCHETYPE_PROFILE
+
 namespace ECS
 {
     class ARCHETYPE_API Engine;
 
+    // Work allowed per Processor::forEachSlice() call, the first limit reached ends the call
+    struct SliceBudget
+    {
+        // Entities visited per call
+        std::size_t entities = SIZE_MAX;
+        // Time spent per call, 0 for no limit. Checked between ranges, so a call
+        // overruns by at most one range
+        int64_t microseconds = 0;
+        // Maximum rows of a range when microseconds is set
+        std::size_t granularity = 64;
+    };
+
     // Processor can process engine's components directly once returned from Engine::registerProcessor<T>()
     // Follow this syntax:
     // class Derived : ECS::Processor;
@@ -46,11 +79,123 @@ namespace ECS
         Processor(Engine& engine);
         void setIdentifier(const Identifier& id);
         std::vector<Archetype*>& getData();
+
+        // Time-sliced iteration
+
+        void setBudget(const SliceBudget& budget);
+        // Call fn(Archetype& arch, std::size_t begin, std::size_t end) for consecutive row ranges
+        // of the matching archetypes, starting where the previous call stopped, until the budget
+        // is spent or every entity was visited once. Returns true if the call finished a pass,
+        // the next one then starts over from the first archetype
+        // The position is kept by archetype identifier and row: entities moved by insertions or
+        // removals meanwhile may be skipped or visited twice in a pass
+        template <typename Fn>
+        bool forEachSlice(Fn fn);
+        // Start the next forEachSlice() from the first archetype
+        void resetCursor();
+
+        // Resources
+
+        template <typename T>
+        void declareRead();
+        // Writing includes reading
+        template <typename T>
+        void declareWrite();
+        // True if one of the processors writes a resource the other reads or writes
+        bool conflictsWith(const Processor& other) const;
+        #ifdef ARCHETYPE_PROFILE
+        void setName(const char* name);
+        const char* getName() const;
+    protected:
+        Profiler& getProfiler();
+        #endif
+    protected:
+        // Access to resources, checked against the declarations in debug mode
+        template <typename T>
+        const T& readResource() const;
+        template <typename T>
+        T& writeResource();
+    private:
+        // Recompute mArchetypeRefs if archetypes changed, returns true if so
+        bool updateRefs();
+        void beginSlice();
+        // Next row range of the current forEachSlice() call, false once it is over
+        bool nextSlice(Archetype*& arch, std::size_t& begin, std::size_t& end);
+        // Returns true if the pass is finished
+        bool endSlice();
     private:
         Engine& mEngine;
+        ResourceManager& mResources;
         Identifier mID;
         std::vector<Archetype*> mArchetypeRefs;
+        // Engine's archetype version when mArchetypeRefs was computed
+        uint64_t mArchetypeVersion;
+
+        // Time slicing
+
+        SliceBudget mBudget;
+        // Position in mArchetypeRefs and row of the next entity to visit
+        std::size_t mCursorArchetype;
+        std::size_t mCursorRow;
+        // Identifier of mArchetypeRefs[mCursorArchetype], to find it again when archetypes change
+        Identifier mCursorID;
+        // State of the running forEachSlice() call
+        std::size_t mSliceLeft;
+        std::size_t mSliceVisited;
+        bool mPassDone;
+        std::chrono::steady_clock::time_point mSliceStart;
+
+        // Sorted type indexes of declared resources (see ResourceManager::getTypeIndex)
+        std::vector<uint32_t> mReads;
+        std::vector<uint32_t> mWrites;
+        #ifdef ARCHETYPE_PROFILE
+        const char* mName;
+        #endif
     };
+
+    template <typename T>
+    void Processor::declareRead()
+    {
+        uint32_t index = ResourceManager::getTypeIndex<T>();
+        auto found = std::lower_bound(mReads.begin(), mReads.end(), index);
+        if (found == mReads.end() || *found != index)
+            mReads.insert(found, index);
+    }
+
+    template <typename T>
+    void Processor::declareWrite()
+    {
+        declareRead<T>();
+        uint32_t index = ResourceManager::getTypeIndex<T>();
+        auto found = std::lower_bound(mWrites.begin(), mWrites.end(), index);
+        if (found == mWrites.end() || *found != index)
+            mWrites.insert(found, index);
+    }
+
+    template <typename T>
+    const T& Processor::readResource() const
+    {
+        ECS_ASSERT(std::binary_search(mReads.begin(), mReads.end(), ResourceManager::getTypeIndex<T>()), ((std::string)"Resource of type " + (typeid(T).name()) + " read by a processor that did not declare it"));
+        return mResources.get<T>();
+    }
+
+    template <typename T>
+    T& Processor::writeResource()
+    {
+        ECS_ASSERT(std::binary_search(mWrites.begin(), mWrites.end(), ResourceManager::getTypeIndex<T>()), ((std::string)"Resource of type " + (typeid(T).name()) + " written by a processor that did not declare it"));
+        return mResources.get<T>();
+    }
+
+    template <typename Fn>
+    bool Processor::forEachSlice(Fn fn)
+    {
+        beginSlice();
+        Archetype* arch;
+        std::size_t begin, end;
+        while (nextSlice(arch, begin, end))
+            fn(*arch, begin, end);
+        return endSlice();
+    }
 }
 
 #endif // ARCHETYPE_PROCESSOR_HPP
@@ -35,6 +35,7 @@ namespace ECS
         ECS_ASSERT(mProcessors.find(name) == mProcessors.end(),
                    ((std::string)"Processor of type " + (typeid(T).name()) + " registered twice"));
         std::shared_ptr<T> res = std::make_shared<T>(mEngine);
+        ECS_PROFILE(res->setName(name));
         mProcessors[name] = res;
         return res;
     }
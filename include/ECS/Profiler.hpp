@@ -0,0 +1,123 @@
+#ifndef ARCHETYPE_PROFILER_HPP
+#define ARCHETYPE_PROFILER_HPP
+
+/*
+* Profiler collects engine instrumentation: processor
+* run times, entities visited and structural change
+* counters. It is only filled by the engine when
+* ARCHETYPE_PROFILE is defined, otherwise every
+* recording site compiles to nothing.
+* Recorded data can be queried or dumped in Chrome
+* trace event format (chrome://tracing, Perfetto).
+* Timed runs are kept in a ring of MAX_TRACE_EVENTS,
+* so an always-on profile only holds the latest ones
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Timed runs kept for the trace, older ones are overwritten
+    constexpr std::size_t MAX_TRACE_EVENTS = 1 << 16;
+
+    // Structural events counted by the engine
+    enum class ProfileCounter
+    {
+        // Entity moved between archetypes by addComponent/removeComponent
+        ArchetypeTransition,
+        // Calls to Engine::flushEmpty()
+        FlushEmpty,
+        // Archetypes created in a never used Record row
+        ArchetypeCreated,
+        // Archetypes created in a Record row freed by flushEmpty() or compact()
+        ArchetypeRecycled,
+        // Archetypes freed by flushEmpty() or compact()
+        ArchetypeRemoved,
+        Count
+    };
+
+    // Accumulated statistics of one processor type
+    struct ProcessorStats
+    {
+        const char* name = nullptr;
+        uint64_t runs = 0;
+        // In nanoseconds
+        uint64_t totalTime = 0;
+        uint64_t maxTime = 0;
+        uint64_t entitiesVisited = 0;
+    };
+
+    // Snapshot of one live archetype
+    struct ArchetypeStats
+    {
+        uint32_t index = 0;
+        std::size_t entities = 0;
+        std::size_t bytes = 0;
+    };
+
+    // Storage of engine instrumentation, see Engine::getProfiler()
+    class ARCHETYPE_API Profiler
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Profiler();
+        void reset();
+
+        // Recording
+
+        void count(ProfileCounter counter, uint64_t amount = 1);
+        void addEntitiesVisited(const char* name, std::size_t amount);
+        // Record a timed run, processors are identified by their type name
+        void addRun(const char* name, Clock::time_point start, Clock::time_point end, bool isProcessor);
+
+        // Queries
+
+        uint64_t getCounter(ProfileCounter counter) const;
+        const std::unordered_map<const char*, ProcessorStats>& getProcessorStats() const;
+        // Timed runs recorded since the last reset, those overwritten in the ring included
+        uint64_t getRunCount() const;
+        // Write the last MAX_TRACE_EVENTS timed runs, counter values and archetype sizes as
+        // Chrome trace JSON
+        void writeChromeTrace(std::ostream& os, const std::vector<ArchetypeStats>& archetypes) const;
+    private:
+        struct Event
+        {
+            const char* name;
+            // In nanoseconds since the profiler was reset
+            int64_t start;
+            int64_t duration;
+        };
+    private:
+        Clock::time_point mOrigin;
+        std::array<uint64_t, (std::size_t)ProfileCounter::Count> mCounters;
+        std::unordered_map<const char*, ProcessorStats> mProcessors;
+        // Ring of timed runs, mEvents[mRuns % MAX_TRACE_EVENTS] is written next
+        std::vector<Event> mEvents;
+        uint64_t mRuns;
+    };
+
+    // Record the lifetime of the object as one run named "name"
+    class ARCHETYPE_API ProfileScope
+    {
+    public:
+        ProfileScope(Profiler& profiler, const char* name, bool isProcessor = false);
+        ~ProfileScope();
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator = (const ProfileScope&) = delete;
+    private:
+        Profiler& mProfiler;
+        const char* mName;
+        bool mIsProcessor;
+        Profiler::Clock::time_point mStart;
+    };
+}
+
+#endif // ARCHETYPE_PROFILER_HPP
@@ -6,14 +6,18 @@
 */
 
 #include <stdint.h>
+#include <cstddef>
 
 namespace ECS
 {
     using Entity = uint32_t;
-    using ComponentType = uint8_t;
+    using ComponentType = uint16_t;
     constexpr Entity MAX_ENTITY = 50000;
-    constexpr ComponentType MAX_COMPONENT_TYPE = 50;
-    constexpr uint32_t MAX_ARCHETYPE = 200;
+    constexpr ComponentType MAX_COMPONENT_TYPE = UINT16_MAX;
+    // Returned by lookups that found no entity
+    constexpr Entity NULL_ENTITY = UINT32_MAX;
+    // Alignment in bytes of component columns, their allocation is also padded to it
+    constexpr std::size_t COMPONENT_ALIGNMENT = 64;
 }
 
 #endif // ARCHETYPE_PROPERTIES_HPP
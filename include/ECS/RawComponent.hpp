@@ -0,0 +1,114 @@
+#ifndef ARCHETYPE_RAWCOMPONENT_HPP
+#define ARCHETYPE_RAWCOMPONENT_HPP
+
+/*
+* Component types defined at runtime (scripting,
+* data files) by their size, alignment and
+* lifetime functions instead of a C++ type.
+* Their values live in a column of raw bytes
+* laid out like a ComponentVector's, one element
+* every getStride() bytes, so they are iterated
+* as fast as native components.
+* Missing functions mean the trivial operation:
+*
+*   construct   :   zero-fill
+*   destruct    :   nothing
+*   move        :   memcpy, the source is not destroyed
+*   copy        :   memcpy, only if destruct is missing
+*
+* A type with a destructor must have a move
+* function, after which the source is destroyed
+*/
+
+#include "ComponentVector.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Layout and lifetime functions of a runtime component type
+    struct RawComponentInfo
+    {
+        std::size_t size = 0;
+        std::size_t alignment = 1;
+        // Construct a default value at dst
+        void (*construct)(void* dst) = nullptr;
+        void (*destruct)(void* dst) = nullptr;
+        // Construct dst from src, src is left moved-from
+        void (*move)(void* dst, void* src) = nullptr;
+        void (*copy)(void* dst, const void* src) = nullptr;
+
+        // Distance in bytes between two elements of a column
+        std::size_t getStride() const;
+        bool isTriviallyCopyable() const;
+    };
+
+    // Pointer to the one copy of name kept for the whole program, so runtime types with
+    // the same name key the same entries in every engine like typeid(T).name() does
+    ARCHETYPE_API const char* internComponentName(const std::string& name);
+
+    // Column of a runtime component type
+    class ARCHETYPE_API RawComponentVector : public IComponentVector
+    {
+    public:
+        RawComponentVector(const char* name, const RawComponentInfo& info);
+        RawComponentVector(const RawComponentVector&) = delete;
+        RawComponentVector& operator = (const RawComponentVector&) = delete;
+        ~RawComponentVector() override;
+
+        std::shared_ptr<IComponentVector> createClone() const override;
+        void removeEntity(Entity entity) override;
+        void addDefaultData(Entity entity) override;
+        void moveData(Entity entity, IComponentVector& newVec) override;
+        void fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity) override;
+        const void* getRawData(Entity entity) const override;
+        void appendFrom(IComponentVector& source, const std::vector<Entity>& remap) override;
+        void setRowTable(const uint32_t* rows) override;
+        void permute(const std::vector<uint32_t>& order) override;
+        bool getRawColumn(const void*& data, std::size_t& elementSize) const override;
+        std::size_t getByteSize() const override;
+        std::size_t getWastedBytes() const override;
+        void shrinkToFit() override;
+        void reserve(std::size_t capacity) override;
+        void assignRawColumn(const std::vector<Entity>& entities, const void* data) override;
+        void markDirty(std::size_t begin, std::size_t count) override;
+        // Without a copy function, only types without a destructor are copied as bytes
+        bool isCopyable() const override;
+        bool isDefaultConstructible() const override;
+
+        // Data accesses and manipulations
+
+        void* operator [](Entity entity);
+        bool haveData(Entity entity) const;
+        void removeData(Entity entity);
+        // Start of the dense elements, aligned to at least COMPONENT_ALIGNMENT
+        void* data();
+        std::size_t getSize() const;
+        std::size_t getStride() const;
+    private:
+        unsigned char* at(std::size_t index) const;
+        // Append a slot for entity and return it, the caller constructs its value
+        unsigned char* pushSlot(Entity entity);
+        // Block for capacity elements, nullptr if empty
+        unsigned char* allocate(std::size_t capacity) const;
+        // Move-construct dst from src and destroy src
+        void relocate(unsigned char* dst, unsigned char* src) const;
+        // Reallocate to capacity elements, relocating the current ones
+        void reallocate(std::size_t capacity);
+    private:
+        const char* mName;
+        RawComponentInfo mInfo;
+        std::size_t mStride;
+        std::size_t mAlignment;
+        unsigned char* mData;
+        std::size_t mSize;
+        std::size_t mCapacity;
+        // [index] = entity, dense like mData
+        std::vector<Entity> mInOut;
+        std::unordered_map<Entity, Entity> mOutIn;
+    };
+}
+
+#endif // ARCHETYPE_RAWCOMPONENT_HPP
@@ -4,12 +4,12 @@
 /*
     Record Archetype - Component relationship
 
-            C1  C2  C3  ... C50
+            C1  C2  C3  ... Cn
     A1      ... ... ... ... ...
     A2      ... ... ... ... ...
     A3      ... ... ... ... ...
     ...     ... ... ... ... ...
-    A200    ... ... ... ... ...
+    An      ... ... ... ... ...
 
     When an Archetype is deleted/created, the
     cost of updating the table O(Archetype's types)
@@ -20,16 +20,19 @@
     Set bits of C(i) {Ci in Cs} is the set of archetype needed.
 
     How to find them fast? Well... iteration...
+
+    Columns are only allocated up to the highest
+    component type used, so registering thousands
+    of types does not cost memory until used.
+    Rows grow on demand, freed rows are reused first.
 */
 
 #include "Macros.hpp"
 #include "Properties.hpp"
 #include "Identifier.hpp"
+#include "Profiler.hpp"
 
-#include <bitset>
-#include <stack>
 #include <vector>
-#include <array>
 #include <string>
 
 namespace ECS
@@ -40,67 +43,43 @@ namespace ECS
     {
     public:
         Record();
-        bool isFull() const;
         uint32_t addRow(const Identifier& ID);
         uint32_t addRow(const std::vector<ComponentType>& cs);
         void removeRow(uint32_t row, const Identifier& ID);
-        std::vector<uint32_t> getIntersection(const std::unordered_set<ComponentType>& cs) const;
+        bool haveRow(uint32_t row) const;
+        std::vector<uint32_t> getIntersection(const Identifier& ID) const;
+        // Same, leaving out rows having any type of excluded
+        std::vector<uint32_t> getIntersection(const Identifier& ID, const Identifier& excluded) const;
+        // Number of rows ever allocated, free or not
+        uint32_t getRowCount() const;
+        uint32_t getFreeRowCount() const;
+        std::size_t getByteSize() const;
+        #ifdef ARCHETYPE_PROFILE
+        // Count rows creation, recycling and removal into profiler
+        void setProfiler(Profiler* profiler);
+        #endif
     private:
-        std::bitset<MAX_ARCHETYPE> getAndBitset(const std::unordered_set<ComponentType>& cs) const;
+        // Bit i of the set is bit (i % 64) of word (i / 64)
+        using Bits = std::vector<uint64_t>;
 
-        // Returns first set bit of a in [start,end) or -1 if all bit is not set
-        template <std::size_t N>
-        int firstSetBit(const std::bitset<N>& a, int start) const;
-        // Returns list of all set bit of bitset a
-        template <std::size_t N>
-        std::vector<uint32_t> allSetBit(const std::bitset<N>& a) const;
+        uint32_t takeRow();
+        Bits getAndBitset(const Identifier& ID) const;
+        Bits& getColumn(ComponentType c);
+        static void setBit(Bits& bits, uint32_t i, bool value);
+        static bool testBit(const Bits& bits, uint32_t i);
+        // Returns list of all set bit of bits
+        static std::vector<uint32_t> allSetBit(const Bits& bits);
     private:
-        std::array<std::bitset<MAX_ARCHETYPE>, MAX_COMPONENT_TYPE> mTable;
-        std::stack<uint32_t> mAvailableRow;
-        std::bitset<MAX_ARCHETYPE> mRowList;
+        // [c] = archetypes having component type c, may be shorter than mRowList
+        std::vector<Bits> mTable;
+        std::vector<uint32_t> mAvailableRow;
+        Bits mRowList;
+        uint32_t mRowCount;
+        #ifdef ARCHETYPE_PROFILE
+        Profiler* mProfiler;
+        // Rows that were added at least once
+        Bits mUsedRow;
+        #endif
     };
-
-    template <std::size_t N>
-    std::vector<uint32_t> Record::allSetBit(const std::bitset<N>& a) const
-    {
-        std::size_t cnt = a.count();
-        int start = 0;
-        std::vector<uint32_t> res;
-        while (cnt != 0)
-        {
-            start = firstSetBit<N>(a, start);
-            if (start >= 0 && (int)N > start)
-            {
-                res.push_back(start);
-                ++start;
-                --cnt;
-            }
-            else
-                break;
-        }
-        return res;
-    }
-
-    #ifdef __GNUC__
-    template <std::size_t N>
-    int Record::firstSetBit(const std::bitset<N>& a, int start) const
-    {
-        ECS_ASSERT(start < (int)N, ((std::string)"Invalid access to bitset \"a\" at index " + std::to_string(start)));
-        start = (int)a._Find_next(start - 1);
-        if (start == (int)a.size())
-            return -1;
-        return start;
-    }
-    #else
-    template <std::size_t N>
-    int Record::firstSetBit(const std::bitset<N>& a, int start) const
-    {
-        ECS_ASSERT(start < (int)N, ((std::string)"Invalid access to bitset \"a\" at index " + std::to_string(start)));
-        for (int i = start; i < N; ++i)
-            if (a.test(i))
-                return i;
-        return -1;
-    }
-    #endif // __GNUC__
 }
 #endif // ARCHTYPE_RECORD_HPP
@@ -0,0 +1,199 @@
+#ifndef ARCHETYPE_REPLICATION_HPP
+#define ARCHETYPE_REPLICATION_HPP
+
+/*
+* Delta-compressed replication of component values
+* from a server Engine to client Engines.
+* The server captures a snapshot of the replicated
+* types once per tick, sorted by entity; a client's
+* message is the difference between that snapshot
+* and the last one the client acknowledged, or the
+* whole snapshot if there is none:
+*
+*   sequence  :   1    2    3    4    5
+*   captured  :   S1   S2   S3   S4   S5
+*   client    :   ack 2 ------------> gets S5 - S2
+*
+* Snapshots are compared BLOCK_SIZE entities at a
+* time, blocks holding the same entities and bytes
+* are skipped with one comparison. Values are split
+* in 32-bit words, only the words that changed are
+* sent after a bit mask; entity IDs are gaps from
+* the previous one as variable length integers. Both
+* sides must add the same types in the same order,
+* they must be trivially copyable and not shared.
+* Client entities are created for server entities
+* having a replicated type and destroyed once they
+* lose all of them
+*/
+
+#include "Engine.hpp"
+#include "RowSort.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Sequence meaning "no snapshot"
+    constexpr uint32_t REPLICATION_NO_SEQUENCE = 0;
+    // Snapshots kept on each side to serve as baselines
+    constexpr std::size_t REPLICATION_HISTORY = 32;
+
+    // Replicated values of one tick
+    struct ReplicationSnapshot
+    {
+        struct Column
+        {
+            // Ascending
+            std::vector<Entity> entities;
+            // Value of entities[i] at i * element size
+            std::vector<uint8_t> values;
+        };
+        uint32_t sequence = REPLICATION_NO_SEQUENCE;
+        // [type position] = column
+        std::vector<Column> columns;
+    };
+
+    // Types replicated by a server or a client
+    class ARCHETYPE_API Replicator
+    {
+    public:
+        static constexpr std::size_t BLOCK_SIZE = 32;
+
+        explicit Replicator(Engine& engine);
+        // Replicate component T, in the same order on the server and its clients
+        template <typename T>
+        void addType();
+    protected:
+        struct Type
+        {
+            uint32_t size;
+            // Fill column with the values of the engine, sorted by entity
+            std::function<void(Engine&, ReplicationSnapshot::Column&)> capture;
+            // Add or set the component from its bytes
+            std::function<void(Engine&, Entity, const uint8_t*)> write;
+            std::function<void(Engine&, Entity)> remove;
+        };
+    protected:
+        Engine& mEngine;
+        std::vector<Type> mTypes;
+    };
+
+    // Writes the messages of every client
+    class ARCHETYPE_API ReplicationServer : public Replicator
+    {
+    public:
+        explicit ReplicationServer(Engine& engine);
+        // Returns the new client's ID
+        uint32_t addClient();
+        // Snapshot the replicated types, returns its sequence
+        uint32_t capture();
+        // Replace out with the delta from client's acknowledged snapshot to the latest capture
+        void encode(uint32_t client, std::vector<uint8_t>& out) const;
+        // Client applied the message of sequence, ignored if too old
+        void acknowledge(uint32_t client, uint32_t sequence);
+    private:
+        std::shared_ptr<const ReplicationSnapshot> findSnapshot(uint32_t sequence) const;
+    private:
+        // Latest captures, oldest first. The buffers of the one dropped are reused
+        // when no client still has it as baseline
+        std::deque<std::shared_ptr<ReplicationSnapshot>> mHistory;
+        // [client] = acknowledged snapshot, nullptr if none
+        std::vector<std::shared_ptr<const ReplicationSnapshot>> mBaselines;
+        uint32_t mSequence;
+    };
+
+    // Applies the messages of a server to an engine
+    class ARCHETYPE_API ReplicationClient : public Replicator
+    {
+    public:
+        explicit ReplicationClient(Engine& engine);
+        // Returns false if the message is malformed or its baseline is unknown, the engine
+        // is then left untouched. Messages older than the applied one are only kept
+        // as baselines
+        bool apply(const uint8_t* data, std::size_t size);
+        // Sequence of the applied snapshot, to be acknowledged to the server
+        uint32_t getSequence() const;
+        // Client entity of serverEntity or NULL_ENTITY
+        Entity getEntity(Entity serverEntity) const;
+    private:
+        bool decode(const uint8_t* data, std::size_t size, ReplicationSnapshot& snapshot, uint32_t& baseline) const;
+        // Make the engine go from the applied snapshot to snapshot
+        void sync(const ReplicationSnapshot& snapshot);
+    private:
+        // Latest received snapshots, oldest first
+        std::deque<std::shared_ptr<const ReplicationSnapshot>> mHistory;
+        std::shared_ptr<const ReplicationSnapshot> mApplied;
+        // [server entity] = client entity
+        std::unordered_map<Entity, Entity> mEntities;
+    };
+
+    template <typename T>
+    void Replicator::addType()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Replicated components must be trivially copyable");
+        static_assert(std::is_default_constructible_v<T>, "Replicated components must be default constructible");
+
+        Type type;
+        type.size = (uint32_t)sizeof(T);
+        type.capture = [](Engine& engine, ReplicationSnapshot::Column& column)
+        {
+            std::vector<Entity> entities;
+            std::vector<const T*> values;
+            entities.reserve(column.entities.size());
+            values.reserve(column.entities.size());
+            for (const Archetype* arch : engine.getArchetypeRefs(engine.generateIdentifier<T>()))
+            {
+                // Read-only, buffered columns are not reported written
+                const T* data = std::get<0>(arch->getColumns<T>());
+                if (data == nullptr)
+                    continue;
+                for (Entity entity : arch->getEntities())
+                {
+                    entities.push_back(entity);
+                    values.push_back(data++);
+                }
+            }
+            // Entities created in a row and never moved come in descending order
+            std::vector<uint32_t> order;
+            if (std::is_sorted(entities.rbegin(), entities.rend()))
+            {
+                order.resize(entities.size());
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    order[i] = (uint32_t)(order.size() - 1 - i);
+            }
+            else
+                order = sortRows(entities);
+            column.entities.resize(order.size());
+            column.values.resize(order.size() * sizeof(T));
+            for (std::size_t i = 0; i < order.size(); ++i)
+            {
+                column.entities[i] = entities[order[i]];
+                std::memcpy(column.values.data() + i * sizeof(T), values[order[i]], sizeof(T));
+            }
+        };
+        type.write = [](Engine& engine, Entity entity, const uint8_t* bytes)
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            if (engine.haveComponent<T>(entity))
+                engine.setComponent<T>(entity, value);
+            else
+                engine.addComponent<T>(entity, value);
+        };
+        type.remove = [](Engine& engine, Entity entity)
+        {
+            engine.removeComponent<T>(entity);
+        };
+        mTypes.push_back(std::move(type));
+    }
+}
+
+#endif // ARCHETYPE_REPLICATION_HPP
@@ -0,0 +1,105 @@
+#ifndef ARCHETYPE_RESOURCE_HPP
+#define ARCHETYPE_RESOURCE_HPP
+
+/*
+* Resources are global values stored once per type
+* (game clock, input snapshot, physics settings...)
+* outside of the archetypes, so reaching them costs
+* no entity, archetype or query.
+* Every resource type gets a dense number the first
+* time it is used, resources are kept in an array
+* indexed by that number:
+*
+*   type index  :   0       1       2
+*   resources   :   Clock   -       Input
+*/
+
+#include "Macros.hpp"
+#include "ComponentVector.hpp"
+
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace ECS
+{
+    // Type-indexed storage of one value per resource type
+    class ARCHETYPE_API ResourceManager
+    {
+    public:
+        ResourceManager();
+
+        // Construct resource T from args, replacing the current one
+        template <typename T, typename... Args>
+        T& set(Args&&... args);
+        // A placeholder (see getFallbackElement()) once a check failed if there is no resource T
+        template <typename T>
+        T& get();
+        template <typename T>
+        const T& get() const;
+        template <typename T>
+        bool have() const;
+        // Do nothing if there is no resource T
+        template <typename T>
+        void remove();
+
+        // Dense number of resource type T, the same for every manager of the program
+        template <typename T>
+        static uint32_t getTypeIndex();
+    private:
+        static uint32_t nextTypeIndex();
+    private:
+        // [type index] = resource, nullptr if not set
+        std::vector<std::shared_ptr<void>> mResources;
+    };
+
+    template <typename T>
+    uint32_t ResourceManager::getTypeIndex()
+    {
+        static const uint32_t index = nextTypeIndex();
+        return index;
+    }
+
+    template <typename T, typename... Args>
+    T& ResourceManager::set(Args&&... args)
+    {
+        uint32_t index = getTypeIndex<T>();
+        if (index >= mResources.size())
+            mResources.resize(index + 1);
+        auto resource = std::make_shared<T>(std::forward<Args>(args)...);
+        T& res = *resource;
+        mResources[index] = std::move(resource);
+        return res;
+    }
+
+    template <typename T>
+    T& ResourceManager::get()
+    {
+        return const_cast<T&>(static_cast<const ResourceManager*>(this)->get<T>());
+    }
+
+    template <typename T>
+    const T& ResourceManager::get() const
+    {
+        ECS_ASSERT_OR_RETURN(have<T>(), ((std::string)"Resource of type " + (typeid(T).name()) + " was not set but queried"), getFallbackElement<T>());
+        return *static_cast<const T*>(mResources[getTypeIndex<T>()].get());
+    }
+
+    template <typename T>
+    bool ResourceManager::have() const
+    {
+        uint32_t index = getTypeIndex<T>();
+        return index < mResources.size() && mResources[index] != nullptr;
+    }
+
+    template <typename T>
+    void ResourceManager::remove()
+    {
+        if (have<T>())
+            mResources[getTypeIndex<T>()].reset();
+    }
+}
+
+#endif // ARCHETYPE_RESOURCE_HPP
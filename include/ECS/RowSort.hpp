@@ -0,0 +1,129 @@
+#ifndef ARCHETYPE_ROWSORT_HPP
+#define ARCHETYPE_ROWSORT_HPP
+
+/*
+* Sorting of archetype rows by a key.
+* Both functions return a permutation of the rows,
+* [i] = row that goes to position i, so every
+* column of the archetype can be moved at once.
+* Integer keys are radix sorted one byte per pass,
+* passes where all keys share the byte are skipped.
+* resortRows() is meant for rows that are already
+* almost in order
+*/
+
+#include "Properties.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ECS
+{
+    template <typename Key>
+    constexpr bool IS_RADIX_KEY = std::is_integral_v<Key> && std::is_same_v<Key, bool> == false;
+
+    // Sort order of keys into order, which must hold 0, 1, ..., keys.size() - 1
+    template <typename Key>
+    void radixSortRows(const std::vector<Key>& keys, std::vector<uint32_t>& order)
+    {
+        using Bits = std::make_unsigned_t<Key>;
+        constexpr std::size_t PASSES = sizeof(Bits);
+        std::size_t size = keys.size();
+
+        // Signed keys have their sign bit flipped so negative ones come first
+        std::vector<Bits> bits(size), bitsTmp(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            bits[i] = (Bits)keys[i];
+            if constexpr (std::is_signed_v<Key>)
+                bits[i] ^= (Bits)((Bits)1 << (8 * sizeof(Bits) - 1));
+        }
+
+        // Histograms of every byte in a single pass
+        std::vector<std::array<uint32_t, 256>> counts(PASSES);
+        for (auto& c : counts)
+            c.fill(0);
+        for (std::size_t i = 0; i < size; ++i)
+            for (std::size_t p = 0; p < PASSES; ++p)
+                counts[p][(bits[i] >> (8 * p)) & 0xFF]++;
+
+        std::vector<uint32_t> orderTmp(size);
+        for (std::size_t p = 0; p < PASSES; ++p)
+        {
+            std::size_t shift = 8 * p;
+            auto& c = counts[p];
+            if (c[(bits[0] >> shift) & 0xFF] == size)
+                continue;
+            uint32_t offset = 0;
+            for (auto& n : c)
+            {
+                uint32_t count = n;
+                n = offset;
+                offset += count;
+            }
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                uint32_t pos = c[(bits[i] >> shift) & 0xFF]++;
+                orderTmp[pos] = order[i];
+                bitsTmp[pos] = bits[i];
+            }
+            order.swap(orderTmp);
+            bits.swap(bitsTmp);
+        }
+    }
+
+    // Radix sort for integer keys, std::stable_sort with operator < otherwise
+    template <typename Key>
+    std::vector<uint32_t> sortRows(const std::vector<Key>& keys)
+    {
+        std::vector<uint32_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (keys.empty())
+            return order;
+        if constexpr (IS_RADIX_KEY<Key>)
+            radixSortRows(keys, order);
+        else
+            std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b)
+            {
+                return keys[a] < keys[b];
+            });
+        return order;
+    }
+
+    // Meant for keys that are mostly sorted: rows out of place are set aside, sorted on their own
+    // and merged back, O(n + k log k) for k such rows
+    template <typename Key>
+    std::vector<uint32_t> resortRows(const std::vector<Key>& keys)
+    {
+        // A row stays if it keeps the kept rows sorted and is not above its next row,
+        // so one large key does not push every following row aside
+        std::vector<uint32_t> kept, moved;
+        kept.reserve(keys.size());
+        for (uint32_t i = 0; i < keys.size(); ++i)
+        {
+            bool afterKept = kept.empty() || (keys[i] < keys[kept.back()]) == false;
+            bool beforeNext = i + 1 == keys.size() || (keys[i + 1] < keys[i]) == false;
+            if (afterKept && beforeNext)
+                kept.push_back(i);
+            else
+                moved.push_back(i);
+        }
+        if (moved.empty())
+            return kept;
+
+        auto less = [&keys](uint32_t a, uint32_t b)
+        {
+            return keys[a] < keys[b];
+        };
+        std::stable_sort(moved.begin(), moved.end(), less);
+        std::vector<uint32_t> order(keys.size());
+        std::merge(kept.begin(), kept.end(), moved.begin(), moved.end(), order.begin(), less);
+        return order;
+    }
+}
+
+#endif // ARCHETYPE_ROWSORT_HPP
@@ -0,0 +1,435 @@
+#ifndef ARCHETYPE_SHAREDCOMPONENT_HPP
+#define ARCHETYPE_SHAREDCOMPONENT_HPP
+
+/*
+* Shared components are stored once per distinct
+* value instead of once per entity.
+* SharedPool deduplicates values of one type with
+* reference counting, SharedComponentVector is the
+* archetype column that keeps a 4 byte handle per
+* row, found through the engine's row table like
+* other columns. Rows are grouped by value on
+* demand so processors can batch work per value.
+* T must be default constructible, comparable
+* with operator == and hashable: values are found
+* in the pool by hash, then compared
+*/
+
+#include "Macros.hpp"
+#include "Properties.hpp"
+#include "ComponentVector.hpp"
+
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ECS
+{
+    // Base class for template SharedPool
+    class ARCHETYPE_API ISharedPool
+    {
+    public:
+        ISharedPool();
+        virtual ~ISharedPool();
+        // Number of distinct values alive
+        virtual std::size_t getSize() const = 0;
+        virtual std::size_t getByteSize() const = 0;
+    };
+
+    // Reference counted storage of distinct values of T
+    template <typename T>
+    class SharedPool : public ISharedPool
+    {
+    public:
+        using Handle = uint32_t;
+        using HashFunction = std::size_t (*)(const T&);
+        static constexpr Handle NULL_HANDLE = UINT32_MAX;
+
+        SharedPool(HashFunction hash);
+        // Returns handle of a value equal to value, inserting it if necessary
+        Handle acquire(const T& value);
+        void acquire(Handle handle);
+        void release(Handle handle);
+        const T& get(Handle handle) const;
+        // Every handle given out is below this bound
+        Handle getHandleBound() const;
+        std::size_t getSize() const override;
+        std::size_t getByteSize() const override;
+    private:
+        std::vector<T> mValues;
+        // Freed slots have reference count 0
+        std::vector<uint32_t> mRefCounts;
+        std::vector<Handle> mFree;
+        HashFunction mHash;
+        // [hash] = handles of live values with this hash
+        std::unordered_multimap<std::size_t, Handle> mLookup;
+        // [handle] = hash of its value
+        std::vector<std::size_t> mHashes;
+    };
+
+    // Archetype column storing a handle to a shared value per row
+    template <typename T>
+    class SharedComponentVector : public IComponentVector
+    {
+    public:
+        using Handle = typename SharedPool<T>::Handle;
+
+        SharedComponentVector(std::shared_ptr<SharedPool<T>> pool);
+        ~SharedComponentVector();
+        std::shared_ptr<IComponentVector> createClone() const override;
+        // The entity must still be at its row in the row table
+        void removeEntity(Entity entity) override;
+        // The entity has no value until setValue() is called
+        void addDefaultData(Entity entity) override;
+        // The handle is handed over to newVec, the entity keeps its value
+        void moveData(Entity entity, IComponentVector& newVec) override;
+        void fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity) override;
+        // Address of the shared value, nullptr if none is set
+        const void* getRawData(Entity entity) const override;
+        // Values are inserted in this vector's pool, source may use another one
+        void appendFrom(IComponentVector& source, const std::vector<Entity>& remap) override;
+        void setRowTable(const uint32_t* rows) override;
+        void permute(const std::vector<uint32_t>& order) override;
+        // Values are not stored per entity
+        bool getRawColumn(const void*& data, std::size_t& elementSize) const override;
+        std::size_t getByteSize() const override;
+        std::size_t getWastedBytes() const override;
+        void shrinkToFit() override;
+        // Values are in the pool, only handles are reserved
+        void reserve(std::size_t capacity) override;
+        void assignRawColumn(const std::vector<Entity>& entities, const void* data) override;
+        void markDirty(std::size_t begin, std::size_t count) override;
+        bool isCopyable() const override;
+        bool isDefaultConstructible() const override;
+
+        const T& getValue(Entity entity) const;
+        void setValue(Entity entity, const T& value);
+        // Call fn(const T& value, const uint32_t* rows, std::size_t count) once per distinct
+        // value, rows ascending. Rows are bucketed by handle, without hashing
+        template <typename Fn>
+        void forEachGroup(Fn fn) const;
+    private:
+        // Row of entity, the size of mHandles once a check failed if it is out of range
+        uint32_t getRow(Entity entity) const;
+    private:
+        std::shared_ptr<SharedPool<T>> mPool;
+        // [row] = handle, NULL_HANDLE until a value is set
+        std::vector<Handle> mHandles;
+        const uint32_t* mRows;
+    };
+
+    template <typename T>
+    SharedPool<T>::SharedPool(HashFunction hash)
+        : mHash(hash)
+    { }
+
+    template <typename T>
+    typename SharedPool<T>::Handle SharedPool<T>::acquire(const T& value)
+    {
+        std::size_t hash = mHash(value);
+        auto range = mLookup.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+            if (mValues[it->second] == value)
+            {
+                mRefCounts[it->second]++;
+                return it->second;
+            }
+
+        Handle res;
+        if (mFree.empty())
+        {
+            res = (Handle)mValues.size();
+            mValues.push_back(value);
+            mRefCounts.push_back(1);
+            mHashes.push_back(hash);
+        }
+        else
+        {
+            res = mFree.back();
+            mFree.pop_back();
+            mValues[res] = value;
+            mRefCounts[res] = 1;
+            mHashes[res] = hash;
+        }
+        mLookup.emplace(hash, res);
+        return res;
+    }
+
+    template <typename T>
+    void SharedPool<T>::acquire(Handle handle)
+    {
+        ECS_ASSERT(handle < mValues.size() && mRefCounts[handle] != 0, ((std::string)"Invalid shared handle " + std::to_string(handle) + " of type " + (typeid(T).name())));
+        mRefCounts[handle]++;
+    }
+
+    template <typename T>
+    void SharedPool<T>::release(Handle handle)
+    {
+        ECS_ASSERT(handle < mValues.size() && mRefCounts[handle] != 0, ((std::string)"Invalid shared handle " + std::to_string(handle) + " of type " + (typeid(T).name())));
+        if (--mRefCounts[handle] == 0)
+        {
+            auto range = mLookup.equal_range(mHashes[handle]);
+            for (auto it = range.first; it != range.second; ++it)
+                if (it->second == handle)
+                {
+                    mLookup.erase(it);
+                    break;
+                }
+            // Drop whatever resources the value holds
+            mValues[handle] = T();
+            mFree.push_back(handle);
+        }
+    }
+
+    template <typename T>
+    const T& SharedPool<T>::get(Handle handle) const
+    {
+        ECS_ASSERT(handle < mValues.size() && mRefCounts[handle] != 0, ((std::string)"Invalid shared handle " + std::to_string(handle) + " of type " + (typeid(T).name())));
+        return mValues[handle];
+    }
+
+    template <typename T>
+    std::size_t SharedPool<T>::getSize() const
+    {
+        return mValues.size() - mFree.size();
+    }
+
+    template <typename T>
+    std::size_t SharedPool<T>::getByteSize() const
+    {
+        constexpr std::size_t nodeSize = sizeof(std::pair<const std::size_t, Handle>) + sizeof(void*);
+        return mValues.capacity() * sizeof(T) + mRefCounts.capacity() * sizeof(uint32_t)
+            + mFree.capacity() * sizeof(Handle) + mHashes.capacity() * sizeof(std::size_t)
+            + mLookup.size() * nodeSize + mLookup.bucket_count() * sizeof(void*);
+    }
+
+    template <typename T>
+    typename SharedPool<T>::Handle SharedPool<T>::getHandleBound() const
+    {
+        return (Handle)mValues.size();
+    }
+
+    template <typename T>
+    SharedComponentVector<T>::SharedComponentVector(std::shared_ptr<SharedPool<T>> pool)
+        : IComponentVector(true), mPool(std::move(pool)), mRows(nullptr)
+    { }
+
+    template <typename T>
+    SharedComponentVector<T>::~SharedComponentVector()
+    {
+        for (Handle handle : mHandles)
+            if (handle != SharedPool<T>::NULL_HANDLE)
+                mPool->release(handle);
+    }
+
+    template <typename T>
+    std::shared_ptr<IComponentVector> SharedComponentVector<T>::createClone() const
+    {
+        auto res = std::make_shared<SharedComponentVector<T>>(mPool);
+        res->mRows = mRows;
+        return res;
+    }
+
+    template <typename T>
+    uint32_t SharedComponentVector<T>::getRow(Entity entity) const
+    {
+        uint32_t row = mRows[entity];
+        ECS_ASSERT_OR_RETURN(row < mHandles.size(), ((std::string)"No data of entity " + std::to_string(entity) + " in shared vector of type " + (typeid(T).name())), (uint32_t)mHandles.size());
+        return row;
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::removeEntity(Entity entity)
+    {
+        uint32_t row = getRow(entity);
+        if (row == mHandles.size())
+            return;
+        if (mHandles[row] != SharedPool<T>::NULL_HANDLE)
+            mPool->release(mHandles[row]);
+        // Same swap with the last element as in the archetype
+        mHandles[row] = mHandles.back();
+        mHandles.pop_back();
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::addDefaultData(Entity)
+    {
+        mHandles.push_back(SharedPool<T>::NULL_HANDLE);
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::moveData(Entity entity, IComponentVector& newVec)
+    {
+        auto& casted = static_cast<SharedComponentVector<T>&>(newVec);
+        uint32_t row = getRow(entity);
+        if (row == mHandles.size())
+        {
+            casted.addDefaultData(entity);
+            return;
+        }
+        // Nothing left to release when the entity is removed from here
+        casted.mHandles.push_back(mHandles[row]);
+        mHandles[row] = SharedPool<T>::NULL_HANDLE;
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::fillData(const Entity*, std::size_t count, const IComponentVector& source, Entity sourceEntity)
+    {
+        const auto& casted = static_cast<const SharedComponentVector<T>&>(source);
+        uint32_t row = casted.getRow(sourceEntity);
+        Handle handle = row < casted.mHandles.size() ? casted.mHandles[row] : SharedPool<T>::NULL_HANDLE;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (handle != SharedPool<T>::NULL_HANDLE)
+                mPool->acquire(handle);
+            mHandles.push_back(handle);
+        }
+    }
+
+    template <typename T>
+    const void* SharedComponentVector<T>::getRawData(Entity entity) const
+    {
+        uint32_t row = mRows[entity];
+        if (row >= mHandles.size() || mHandles[row] == SharedPool<T>::NULL_HANDLE)
+            return nullptr;
+        return &mPool->get(mHandles[row]);
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::appendFrom(IComponentVector& source, const std::vector<Entity>&)
+    {
+        auto& casted = static_cast<SharedComponentVector<T>&>(source);
+        // [handle in source's pool] = handle of the same value in mPool
+        std::vector<Handle> handles(casted.mPool->getHandleBound(), SharedPool<T>::NULL_HANDLE);
+        mHandles.reserve(mHandles.size() + casted.mHandles.size());
+        for (Handle handle : casted.mHandles)
+        {
+            if (handle == SharedPool<T>::NULL_HANDLE)
+            {
+                mHandles.push_back(handle);
+                continue;
+            }
+            if (handles[handle] == SharedPool<T>::NULL_HANDLE)
+                handles[handle] = mPool->acquire(casted.mPool->get(handle));
+            else
+                mPool->acquire(handles[handle]);
+            mHandles.push_back(handles[handle]);
+            casted.mPool->release(handle);
+        }
+        casted.mHandles.clear();
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::setRowTable(const uint32_t* rows)
+    {
+        mRows = rows;
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::permute(const std::vector<uint32_t>& order)
+    {
+        std::vector<Handle> handles(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            handles[i] = mHandles[order[i]];
+        mHandles.swap(handles);
+    }
+
+    template <typename T>
+    bool SharedComponentVector<T>::getRawColumn(const void*&, std::size_t&) const
+    {
+        return false;
+    }
+
+    template <typename T>
+    std::size_t SharedComponentVector<T>::getByteSize() const
+    {
+        return mHandles.capacity() * sizeof(Handle);
+    }
+
+    template <typename T>
+    std::size_t SharedComponentVector<T>::getWastedBytes() const
+    {
+        return (mHandles.capacity() - mHandles.size()) * sizeof(Handle);
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::shrinkToFit()
+    {
+        mHandles.shrink_to_fit();
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::reserve(std::size_t capacity)
+    {
+        mHandles.reserve(capacity);
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::assignRawColumn(const std::vector<Entity>&, const void*)
+    {
+        ECS_ASSERT(false, ((std::string)"Shared component type " + (typeid(T).name()) + " assigned raw bytes"));
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::markDirty(std::size_t, std::size_t)
+    { }
+
+    // Only handles are copied or created
+    template <typename T>
+    bool SharedComponentVector<T>::isCopyable() const
+    {
+        return true;
+    }
+
+    template <typename T>
+    bool SharedComponentVector<T>::isDefaultConstructible() const
+    {
+        return true;
+    }
+
+    template <typename T>
+    const T& SharedComponentVector<T>::getValue(Entity entity) const
+    {
+        uint32_t row = getRow(entity);
+        ECS_ASSERT_OR_RETURN(row < mHandles.size() && mHandles[row] != SharedPool<T>::NULL_HANDLE, ((std::string)"No shared value of type " + (typeid(T).name()) + " set for entity " + std::to_string(entity)), getFallbackElement<T>());
+        return mPool->get(mHandles[row]);
+    }
+
+    template <typename T>
+    void SharedComponentVector<T>::setValue(Entity entity, const T& value)
+    {
+        uint32_t row = getRow(entity);
+        if (row == mHandles.size())
+            return;
+        // Acquired first, the value may be the one released
+        Handle handle = mPool->acquire(value);
+        if (mHandles[row] != SharedPool<T>::NULL_HANDLE)
+            mPool->release(mHandles[row]);
+        mHandles[row] = handle;
+    }
+
+    template <typename T>
+    template <typename Fn>
+    void SharedComponentVector<T>::forEachGroup(Fn fn) const
+    {
+        // Counting sort of rows by handle, [handle] = start of its rows in rows
+        std::vector<uint32_t> starts(mPool->getHandleBound() + 1, 0);
+        for (Handle handle : mHandles)
+            if (handle != SharedPool<T>::NULL_HANDLE)
+                starts[handle + 1]++;
+        for (std::size_t i = 1; i < starts.size(); ++i)
+            starts[i] += starts[i - 1];
+        std::vector<uint32_t> rows(starts.back());
+        std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+        for (uint32_t row = 0; row < mHandles.size(); ++row)
+            if (mHandles[row] != SharedPool<T>::NULL_HANDLE)
+                rows[next[mHandles[row]]++] = row;
+        for (Handle handle = 0; handle + 1 < starts.size(); ++handle)
+            if (starts[handle] != starts[handle + 1])
+                fn(mPool->get(handle), rows.data() + starts[handle], (std::size_t)(starts[handle + 1] - starts[handle]));
+    }
+}
+
+#endif // ARCHETYPE_SHAREDCOMPONENT_HPP
@@ -1,11 +1,19 @@
 #include "../include/ECS/Archetype.hpp"
 
+#include <cstring>
+
 namespace ECS
 {
     Archetype::Archetype()
+        : mRows(nullptr)
+        , mOrdered(true)
+        , mIsPacked(false)
     { }
 
     Archetype::Archetype(const Archetype& copyObject)
+        : mRows(copyObject.mRows)
+        , mOrdered(true)
+        , mIsPacked(false)
     {
         mID = copyObject.mID;
         for (const auto& pr : copyObject.mVectors)
@@ -17,46 +25,351 @@ namespace ECS
         mVectors.swap(obj.mVectors);
         mID.swap(obj.mID);
         mEntities.swap(obj.mEntities);
+        std::swap(mRows, obj.mRows);
+        std::swap(mOrdered, obj.mOrdered);
+        std::swap(mIsPacked, obj.mIsPacked);
+        mPackedColumns.swap(obj.mPackedColumns);
+        mPacked.swap(obj.mPacked);
         return *this;
     }
 
-    void Archetype::transferEntity(Entity entity, Archetype& newArch)
+    void Archetype::transferEntity(Entity entity, Archetype& newArch, const char* constructed)
+    {
+        ECS_ASSERT(mIsPacked == false && newArch.mIsPacked == false, ((std::string)"Entity " + std::to_string(entity) + " transferred from or to a packed archetype"));
+        for (auto& pr : newArch.mVectors)
+        {
+            auto found = mVectors.find(pr.first);
+            if (found != mVectors.end())
+                found->second->moveData(entity, *pr.second);
+            else if (pr.first != constructed)
+                pr.second->addDefaultData(entity);
+        }
+        // The row table is shared, entity keeps its old row until it left this archetype
+        // (shared component vectors read it)
+        removeEntity(entity, mRows[entity]);
+        newArch.mRows[entity] = (uint32_t)newArch.mEntities.size();
+        newArch.mEntities.push_back(entity);
+        newArch.mOrdered = false;
+    }
+
+    void Archetype::addRawType(const char* name, ComponentType type, const RawComponentInfo& info)
+    {
+        ECS_ASSERT(haveRawType(name) == false, ((std::string)"Component type " + name + " added twice in archetype"));
+        mVectors.emplace(name, std::make_shared<RawComponentVector>(name, info));
+        mID.setType(type);
+    }
+
+    void Archetype::removeRawType(const char* name, ComponentType type)
+    {
+        ECS_ASSERT(haveRawType(name), ((std::string)"Component type " + name + " was not added in archetype but query removal"));
+        mVectors.erase(name);
+        mID.removeType(type);
+    }
+
+    bool Archetype::haveRawType(const char* name) const
     {
-        newArch.addEntity(entity);
-        for (auto& pr : mVectors)
-            if (newArch.mVectors.find(pr.first) != newArch.mVectors.end())
-                pr.second->overwriteData(entity, newArch.mVectors[pr.first]);
-        removeEntity(entity);
+        return mVectors.find(name) != mVectors.end();
     }
 
-    Identifier Archetype::getIdentifier() const
+    RawComponentVector& Archetype::getRawVector(const char* name)
+    {
+        auto found = mVectors.find(name);
+        ECS_ASSERT(found != mVectors.end(), ((std::string)"Component type " + name + " was not added in archetype but query vector reference"));
+        // at() throws instead of dereferencing end() once the check failed
+        return static_cast<RawComponentVector&>(found != mVectors.end() ? *found->second : *mVectors.at(name));
+    }
+
+    void Archetype::reportVectorQuery([[maybe_unused]] const char* name, [[maybe_unused]] bool added) const
+    {
+        ECS_ASSERT(added, ((std::string)"Component type " + name + " was not added in archetype but query vector reference"));
+        ECS_ASSERT(added == false || mIsPacked == false, ((std::string)"Component type " + name + " queried in a packed archetype"));
+        ECS_ASSERT(added == false || mIsPacked, ((std::string)"Component type " + name + " is shared but queried as a plain component"));
+    }
+
+    const Identifier& Archetype::getIdentifier() const
     {
         return mID;
     }
 
+    std::size_t Archetype::getByteSize() const
+    {
+        std::size_t res = mEntities.capacity() * sizeof(Entity) + mPacked.capacity();
+        for (const auto& p : mVectors)
+            res += p.second->getByteSize();
+        return res;
+    }
+
+    std::size_t Archetype::getWastedBytes() const
+    {
+        std::size_t res = 0;
+        for (const auto& p : mVectors)
+            res += p.second->getWastedBytes();
+        return res;
+    }
+
+    void Archetype::shrinkToFit(std::size_t minWastedBytes)
+    {
+        for (const auto& p : mVectors)
+            if (p.second->getWastedBytes() >= minWastedBytes)
+                p.second->shrinkToFit();
+        mEntities.shrink_to_fit();
+    }
+
+    void Archetype::reserve(std::size_t capacity)
+    {
+        for (const auto& p : mVectors)
+            p.second->reserve(capacity);
+        mEntities.reserve(capacity);
+    }
+
+    void Archetype::pack(bool compress)
+    {
+        ECS_ASSERT(mIsPacked == false, "Archetype packed twice");
+        std::vector<const char*> names;
+        for (const auto& p : mVectors)
+            names.push_back(p.first);
+        std::sort(names.begin(), names.end(), [](const char* a, const char* b)
+        {
+            return std::strcmp(a, b) < 0;
+        });
+
+        std::size_t count = mEntities.size();
+        std::vector<uint8_t> shuffled;
+        for (const char* name : names)
+        {
+            IComponentVector& vec = *mVectors.at(name);
+            const void* data;
+            std::size_t elementSize;
+            if (vec.getRawColumn(data, elementSize) == false)
+                continue;
+            PackedColumn column{ name, elementSize, mPacked.size(), count * elementSize, false };
+            if (compress && column.size > 0)
+            {
+                shuffled.resize(column.size);
+                shuffleBytes(static_cast<const uint8_t*>(data), count, elementSize, shuffled.data());
+                compressBytes(shuffled.data(), shuffled.size(), mPacked);
+                column.compressed = mPacked.size() - column.offset < column.size;
+            }
+            // Stored as is when compression does not pay
+            if (column.compressed == false)
+            {
+                mPacked.resize(column.offset);
+                mPacked.insert(mPacked.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + column.size);
+            }
+            column.size = mPacked.size() - column.offset;
+            mPackedColumns.push_back(column);
+            vec.assignRawColumn({}, nullptr);
+            vec.shrinkToFit();
+        }
+        mPacked.shrink_to_fit();
+        mIsPacked = true;
+    }
+
+    void Archetype::unpack()
+    {
+        ECS_ASSERT(mIsPacked, "Archetype unpacked but not packed");
+        // Vectors read their elements in place, the buffer must be aligned like them
+        std::vector<uint8_t, AlignedAllocator<uint8_t>> column;
+        std::vector<uint8_t> shuffled;
+        for (const PackedColumn& packed : mPackedColumns)
+        {
+            readPackedColumn(packed, column, shuffled);
+            mVectors.at(packed.name)->assignRawColumn(mEntities, column.data());
+        }
+        mPackedColumns.clear();
+        mPacked.clear();
+        mPacked.shrink_to_fit();
+        mIsPacked = false;
+    }
+
+    bool Archetype::isPacked() const
+    {
+        return mIsPacked;
+    }
+
+    std::size_t Archetype::getPackedSize() const
+    {
+        return mPacked.size();
+    }
+
+    bool Archetype::readPackedColumn(const char* name, std::vector<uint8_t, AlignedAllocator<uint8_t>>& out) const
+    {
+        std::vector<uint8_t> shuffled;
+        for (const PackedColumn& packed : mPackedColumns)
+            if (packed.name == name)
+            {
+                readPackedColumn(packed, out, shuffled);
+                return true;
+            }
+        return false;
+    }
+
+    void Archetype::readPackedColumn(const PackedColumn& packed, std::vector<uint8_t, AlignedAllocator<uint8_t>>& out, std::vector<uint8_t>& shuffled) const
+    {
+        std::size_t count = mEntities.size();
+        const uint8_t* src = mPacked.data() + packed.offset;
+        std::size_t size = count * packed.elementSize;
+        out.resize(size);
+        if (packed.compressed)
+        {
+            shuffled.resize(size);
+            [[maybe_unused]] bool valid = decompressBytes(src, packed.size, shuffled.data(), size);
+            ECS_ASSERT(valid, ((std::string)"Packed column of type " + packed.name + " is corrupted"));
+            unshuffleBytes(shuffled.data(), count, packed.elementSize, out.data());
+        }
+        else if (size > 0)
+            std::memcpy(out.data(), src, size);
+    }
+
     void Archetype::removeEntity(Entity entity)
     {
+        removeEntity(entity, mRows[entity]);
+    }
+
+    void Archetype::removeEntity(Entity entity, uint32_t row)
+    {
+        ECS_ASSERT(mIsPacked == false, ((std::string)"Entity " + std::to_string(entity) + " removed from a packed archetype"));
         for (const auto& p : mVectors)
             p.second->removeEntity(entity);
-        mEntities.erase(entity);
+        // Entities created without components are not stored in the empty archetype
+        if (row >= mEntities.size() || mEntities[row] != entity)
+            return;
+        // Same swap with the last element as in component vectors
+        Entity last = mEntities.back();
+        mEntities[row] = last;
+        mRows[last] = row;
+        mEntities.pop_back();
+        mOrdered = false;
     }
 
-    void Archetype::addEntity(Entity entity)
+    bool Archetype::addEntity(Entity entity)
     {
+        ECS_ASSERT(mIsPacked == false, ((std::string)"Entity " + std::to_string(entity) + " added to a packed archetype"));
+        // Checked first, a column without the entity would shift every row after it
+        for (const auto& p : mVectors)
+            if (p.second->isDefaultConstructible() == false)
+            {
+                ECS_ASSERT(false, ((std::string)"Component type " + p.first + " is not default constructible but entity " + std::to_string(entity) + " added with default data"));
+                return false;
+            }
         for (const auto& p : mVectors)
             p.second->addDefaultData(entity);
-        mEntities.insert(entity);
+        mRows[entity] = (uint32_t)mEntities.size();
+        mEntities.push_back(entity);
+        mOrdered = false;
+        return true;
+    }
+
+    bool Archetype::addEntities(const std::vector<Entity>& entities, const Archetype& source, Entity sourceEntity)
+    {
+        if (source.isCopyable() == false)
+        {
+            ECS_ASSERT(false, "Entities added as copies of an entity with components that are not copyable");
+            return false;
+        }
+        // Checked before any vector grows, so a refusal leaves the archetype as it was
+        for (const auto& p : mVectors)
+            if (source.mVectors.find(p.first) == source.mVectors.end())
+            {
+                ECS_ASSERT(false, ((std::string)"Component type " + p.first + " is missing from the source archetype of a bulk copy"));
+                return false;
+            }
+        for (const auto& p : mVectors)
+            p.second->fillData(entities.data(), entities.size(), *source.mVectors.find(p.first)->second, sourceEntity);
+        for (Entity e : entities)
+        {
+            mRows[e] = (uint32_t)mEntities.size();
+            mEntities.push_back(e);
+        }
+        mOrdered = false;
+        return true;
+    }
+
+    bool Archetype::isCopyable() const
+    {
+        for (const auto& p : mVectors)
+            if (p.second->isCopyable() == false)
+                return false;
+        return true;
+    }
+
+    void Archetype::appendFrom(Archetype& source, const std::vector<Entity>& remap)
+    {
+        ECS_ASSERT(mIsPacked == false && source.mIsPacked == false, "Entities appended from or to a packed archetype");
+        for (const auto& p : mVectors)
+        {
+            auto found = source.mVectors.find(p.first);
+            ECS_ASSERT(found != source.mVectors.end(), ((std::string)"Component type " + p.first + " is missing from the source archetype of a merge"));
+            p.second->appendFrom(*found->second, remap);
+        }
+        // Component vectors append source's elements in source's row order
+        for (Entity e : source.mEntities)
+        {
+            mRows[remap[e]] = (uint32_t)mEntities.size();
+            mEntities.push_back(remap[e]);
+        }
+        source.mEntities.clear();
+        mOrdered = false;
+    }
+
+    void Archetype::addVector(const char* name, ComponentType type, std::shared_ptr<IComponentVector> vec)
+    {
+        ECS_ASSERT_OR_RETURN(haveRawType(name) == false, ((std::string)"Component type " + name + " added twice in archetype"));
+        vec->setRowTable(mRows);
+        mVectors.emplace(name, std::move(vec));
+        mID.setType(type);
     }
 
-    const std::unordered_set<Entity>& Archetype::getEntities() const
+    const std::vector<Entity>& Archetype::getEntities() const
     {
         return mEntities;
     }
 
+    void Archetype::setRowTable(uint32_t* rows)
+    {
+        mRows = rows;
+        for (const auto& p : mVectors)
+            p.second->setRowTable(rows);
+    }
+
+    const std::unordered_map<const char*, std::shared_ptr<IComponentVector>>& Archetype::getVectors() const
+    {
+        return mVectors;
+    }
+
+    void Archetype::permute(const std::vector<uint32_t>& order)
+    {
+        ECS_ASSERT(order.size() == mEntities.size(), ((std::string)"Permutation of " + std::to_string(order.size()) + " rows applied to archetype of " + std::to_string(mEntities.size()) + " entities"));
+        for (const auto& p : mVectors)
+            p.second->permute(order);
+        std::vector<Entity> entities(order.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            entities[i] = mEntities[order[i]];
+            mRows[entities[i]] = i;
+        }
+        mEntities.swap(entities);
+        mOrdered = true;
+    }
+
+    bool Archetype::isOrdered() const
+    {
+        return mOrdered;
+    }
+
+    void Archetype::invalidateOrder()
+    {
+        mOrdered = false;
+    }
+
     void Archetype::clear()
     {
         mID = Identifier();
         mVectors.clear();
         mEntities.clear();
+        mOrdered = true;
+        mIsPacked = false;
+        mPackedColumns.clear();
+        mPacked.clear();
     }
 }
@@ -1,14 +1,71 @@
 #include "../include/ECS/Backtrack.hpp"
 
+#ifdef _MSC_VER
 #include <windows.h>
 #include <dbghelp.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#define ARCHETYPE_EXECINFO
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif // _MSC_VER
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 
 namespace ECS
 {
-    #ifdef ARCHETYPE_DEBUG
+    #if defined(ARCHETYPE_DEBUG) || defined(ARCHETYPE_CHECKED)
+    namespace
+    {
+        std::atomic<uint64_t> failureCount(0);
+        std::atomic<CheckHandler> checkHandler(nullptr);
+
+        void defaultCheckHandler(const std::string& message, const char* function, const char* file, int line)
+        {
+        #ifndef ARCHETYPE_DEBUG
+            // Checked mode goes on, only the first failures are worth a report
+            if (getCheckFailureCount() > CHECK_REPORT_LIMIT)
+                return;
+        #endif
+            std::cerr << "ECS: Assertion: " << message << '\n';
+            std::cerr << "In function: " << function << '\n';
+            std::cerr << "At: " << file << ", line " << line << '\n';
+            std::cerr << "Last called function(s):\n";
+            printStackTrace();
+        #ifdef ARCHETYPE_DEBUG
+            exit(-1);
+        #else
+            if (getCheckFailureCount() == CHECK_REPORT_LIMIT)
+                std::cerr << "ECS: Further failed checks are only counted\n";
+        #endif
+        }
+    }
+
+    void setCheckHandler(CheckHandler handler)
+    {
+        checkHandler.store(handler, std::memory_order_release);
+    }
+
+    uint64_t getCheckFailureCount()
+    {
+        return failureCount.load(std::memory_order_relaxed);
+    }
+
+    void resetCheckFailureCount()
+    {
+        failureCount.store(0, std::memory_order_relaxed);
+    }
+
+    void reportCheckFailure(const std::string& message, const char* function, const char* file, int line)
+    {
+        failureCount.fetch_add(1, std::memory_order_relaxed);
+        CheckHandler handler = checkHandler.load(std::memory_order_acquire);
+        (handler != nullptr ? handler : defaultCheckHandler)(message, function, file, line);
+    }
+
     #ifdef _MSC_VER
     // Thanks ChatGPT :'>
     void ARCHETYPE_API printStackTrace()
@@ -67,12 +124,44 @@ namespace ECS
         // Cleanup the symbol handler
         SymCleanup(GetCurrentProcess());
     }
-    #endif // _MSC_VER
-    #ifndef _MSC_VER
+    #elif defined(ARCHETYPE_EXECINFO)
+    void ARCHETYPE_API printStackTrace()
+    {
+        constexpr int MAX_FRAMES = 64;
+        void* addresses[MAX_FRAMES];
+        int count = backtrace(addresses, MAX_FRAMES);
+
+        // Frame 0 is this function
+        for (int i = 1; i < count; ++i)
+        {
+            Dl_info info;
+            std::cerr << addresses[i] << ": ";
+            if (dladdr(addresses[i], &info) == 0)
+            {
+                std::cerr << "<unknown>\n";
+                continue;
+            }
+            if (info.dli_sname != nullptr)
+            {
+                int status = -1;
+                char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                std::cerr << (status == 0 ? demangled : info.dli_sname);
+                std::free(demangled);
+            }
+            else
+                std::cerr << "<unknown>";
+            // Module and offset, for addr2line when the symbol is not exported
+            if (info.dli_fname != nullptr)
+                std::cerr << " (" << info.dli_fname << " +0x" << std::hex
+                    << (uintptr_t)addresses[i] - (uintptr_t)info.dli_fbase << std::dec << ")";
+            std::cerr << '\n';
+        }
+    }
+    #else
     void ARCHETYPE_API printStackTrace()
     {
-        std::cout << "This feature is only available on MSVC\n";
+        std::cout << "This feature is only available on MSVC, glibc and macOS\n";
     }
     #endif // _MSC_VER
-    #endif // ARCHETYPE_DEBUG
+    #endif // ARCHETYPE_DEBUG || ARCHETYPE_CHECKED
 }
@@ -0,0 +1,74 @@
+#include "../include/ECS/ColumnExport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ECS
+{
+    namespace
+    {
+        // Small values are gathered up to this size before being written
+        constexpr std::size_t BUFFER_SIZE = 4096;
+    }
+
+    ColumnWriter::ColumnWriter(int fd)
+        : mFd(fd)
+        , mOffset(0)
+        , mFailed(false)
+    {
+        mBuffer.reserve(BUFFER_SIZE);
+    }
+
+    void ColumnWriter::writeBytes(const void* data, std::size_t size)
+    {
+        if (mBuffer.size() + size > BUFFER_SIZE)
+            flush();
+        const char* bytes = static_cast<const char*>(data);
+        mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+        mOffset += size;
+    }
+
+    void ColumnWriter::writeBlock(const void* data, std::size_t size)
+    {
+        static const char padding[BLOCK_ALIGNMENT] = {};
+        writeBytes(padding, (BLOCK_ALIGNMENT - mOffset % BLOCK_ALIGNMENT) % BLOCK_ALIGNMENT);
+        flush();
+        if (mFailed == false && writeRaw(data, size) == false)
+            mFailed = true;
+        mOffset += size;
+    }
+
+    bool ColumnWriter::flush()
+    {
+        if (mFailed == false && mBuffer.empty() == false && writeRaw(mBuffer.data(), mBuffer.size()) == false)
+            mFailed = true;
+        mBuffer.clear();
+        return mFailed == false;
+    }
+
+    bool ColumnWriter::writeRaw(const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+        #if defined(_WIN32)
+            int written = _write(mFd, bytes, (unsigned int)std::min<std::size_t>(size, 1u << 30));
+        #else
+            ssize_t written = ::write(mFd, bytes, size);
+        #endif
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= (std::size_t)written;
+        }
+        return true;
+    }
+}
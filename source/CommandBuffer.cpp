@@ -0,0 +1,60 @@
+#include "../include/ECS/CommandBuffer.hpp"
+
+namespace ECS
+{
+    CommandBuffer::CommandBuffer()
+        : mCreated(0)
+    { }
+
+    Entity CommandBuffer::createEntity()
+    {
+        mCommands.push_back([](Engine& engine, std::vector<Entity>& created)
+        {
+            created.push_back(engine.createEntity());
+        });
+        return PENDING_ENTITY_BIT | mCreated++;
+    }
+
+    void CommandBuffer::destroyEntity(Entity entity)
+    {
+        mCommands.push_back([entity](Engine& engine, std::vector<Entity>& created)
+        {
+            engine.destroyEntity(resolve(entity, created));
+        });
+    }
+
+    std::vector<Entity> CommandBuffer::apply(Engine& engine)
+    {
+        std::vector<Entity> created;
+        created.reserve(mCreated);
+        for (const auto& command : mCommands)
+            command(engine, created);
+        clear();
+        return created;
+    }
+
+    bool CommandBuffer::empty() const
+    {
+        return mCommands.empty();
+    }
+
+    void CommandBuffer::clear()
+    {
+        mCommands.clear();
+        mCreated = 0;
+    }
+
+    bool CommandBuffer::isPending(Entity entity)
+    {
+        return entity != NULL_ENTITY && (entity & PENDING_ENTITY_BIT) != 0;
+    }
+
+    Entity CommandBuffer::resolve(Entity entity, const std::vector<Entity>& created)
+    {
+        if (isPending(entity) == false)
+            return entity;
+        Entity index = entity & ~PENDING_ENTITY_BIT;
+        ECS_ASSERT_OR_RETURN(index < created.size(), ((std::string)"Pending entity " + std::to_string(index) + " used before its creation or in another command buffer"), NULL_ENTITY);
+        return created[index];
+    }
+}
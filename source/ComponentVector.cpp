@@ -3,6 +3,11 @@
 namespace ECS
 {
     IComponentVector::IComponentVector()
+        : mShared(false)
+    { }
+
+    IComponentVector::IComponentVector(bool shared)
+        : mShared(shared)
     { }
 
     IComponentVector::~IComponentVector()
@@ -0,0 +1,132 @@
+#include "../include/ECS/Compression.hpp"
+
+#include <cstring>
+
+namespace ECS
+{
+    namespace
+    {
+        constexpr std::size_t MIN_MATCH = 4;
+        constexpr std::size_t MAX_OFFSET = 65535;
+        constexpr uint32_t HASH_BITS = 14;
+        constexpr uint32_t NO_POSITION = UINT32_MAX;
+
+        uint32_t read32(const uint8_t* p)
+        {
+            uint32_t res;
+            std::memcpy(&res, p, sizeof(res));
+            return res;
+        }
+
+        void writeLength(std::vector<uint8_t>& out, std::size_t length)
+        {
+            for (; length >= 255; length -= 255)
+                out.push_back(255);
+            out.push_back((uint8_t)length);
+        }
+
+        // Literals then, if matchLength is not 0, the match
+        void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength)
+        {
+            std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+            out.push_back((uint8_t)((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+            if (literalLength >= 15)
+                writeLength(out, literalLength - 15);
+            out.insert(out.end(), literals, literals + literalLength);
+            if (matchLength == 0)
+                return;
+            out.push_back((uint8_t)(offset & 0xFF));
+            out.push_back((uint8_t)(offset >> 8));
+            if (matchCode >= 15)
+                writeLength(out, matchCode - 15);
+        }
+
+        bool readLength(const uint8_t* src, std::size_t srcSize, std::size_t& pos, std::size_t& length)
+        {
+            uint8_t byte;
+            do
+            {
+                if (pos >= srcSize)
+                    return false;
+                byte = src[pos++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+    }
+
+    void shuffleBytes(const uint8_t* src, std::size_t count, std::size_t elementSize, uint8_t* dst)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            for (std::size_t k = 0; k < elementSize; ++k)
+                dst[k * count + i] = src[i * elementSize + k];
+    }
+
+    void unshuffleBytes(const uint8_t* src, std::size_t count, std::size_t elementSize, uint8_t* dst)
+    {
+        for (std::size_t k = 0; k < elementSize; ++k)
+            for (std::size_t i = 0; i < count; ++i)
+                dst[i * elementSize + k] = src[k * count + i];
+    }
+
+    void compressBytes(const uint8_t* src, std::size_t size, std::vector<uint8_t>& out)
+    {
+        // [hash of 4 bytes] = last position they were seen at
+        std::vector<uint32_t> table((std::size_t)1 << HASH_BITS, NO_POSITION);
+        std::size_t anchor = 0;
+        std::size_t i = 0;
+        while (i + MIN_MATCH <= size)
+        {
+            uint32_t sequence = read32(src + i);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            uint32_t candidate = table[hash];
+            table[hash] = (uint32_t)i;
+            if (candidate == NO_POSITION || i - candidate > MAX_OFFSET || read32(src + candidate) != sequence)
+            {
+                ++i;
+                continue;
+            }
+            std::size_t length = MIN_MATCH;
+            while (i + length < size && src[candidate + length] == src[i + length])
+                ++length;
+            writeSequence(out, src + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+        writeSequence(out, src + anchor, size - anchor, 0, 0);
+    }
+
+    bool decompressBytes(const uint8_t* src, std::size_t srcSize, uint8_t* dst, std::size_t dstSize)
+    {
+        std::size_t s = 0, d = 0;
+        while (s < srcSize)
+        {
+            uint8_t token = src[s++];
+            std::size_t literalLength = token >> 4;
+            if (literalLength == 15 && readLength(src, srcSize, s, literalLength) == false)
+                return false;
+            if (literalLength > srcSize - s || literalLength > dstSize - d)
+                return false;
+            std::memcpy(dst + d, src + s, literalLength);
+            s += literalLength;
+            d += literalLength;
+            if (s == srcSize)
+                break;
+
+            if (srcSize - s < 2)
+                return false;
+            std::size_t offset = src[s] | (std::size_t)src[s + 1] << 8;
+            s += 2;
+            std::size_t matchLength = token & 15;
+            if (matchLength == 15 && readLength(src, srcSize, s, matchLength) == false)
+                return false;
+            matchLength += MIN_MATCH;
+            if (offset == 0 || offset > d || matchLength > dstSize - d)
+                return false;
+            // Byte by byte, the match may overlap the bytes it produces
+            for (std::size_t k = 0; k < matchLength; ++k, ++d)
+                dst[d] = dst[d - offset];
+        }
+        return d == dstSize;
+    }
+}
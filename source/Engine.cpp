@@ -1,33 +1,203 @@
 #include "../include/ECS/Engine.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace ECS
 {
     Engine::Engine()
         : mArchetypesChanged(false)
+        , mArchetypeVersion(0)
+        , mCompactionCursor(0)
         , mProcessors(*this)
     {
+        ECS_PROFILE(mTable.setProfiler(&mProfiler));
         // Reserve first archetype for empty entity
         mEmptyRow = mTable.addRow(Identifier());
-        mArchetypeIDs[std::bitset<MAX_COMPONENT_TYPE>()] = mEmptyRow;
+        mArchetypeIDs[Identifier()] = mEmptyRow;
         for (Entity e = 0; e < MAX_ENTITY; ++e)
+        {
             mEntityArchetype[e] = mEmptyRow;
-        mArchetypes[mEmptyRow] = Archetype();
+            mEntityRow[e] = 0;
+        }
+        mArchetypes.emplace_back();
+        mArchetypes.back().setRowTable(mEntityRow.data());
+        mEmptyVisits.push_back(0);
+        // Built-in tag type
+        registerComponent<Prefab>();
+        mPrefabType = mTypeList.getType<Prefab>();
+        registerComponent<Sleeping>();
+        mSleepingType = mTypeList.getType<Sleeping>();
+        mPrefabID.setType(mPrefabType);
+        mSleepingID.setType(mSleepingType);
+        mHiddenID.setType(mPrefabType);
+        mHiddenID.setType(mSleepingType);
+        mObservers.addExcludedType(mPrefabType);
+        mObservers.addExcludedType(mSleepingType);
     }
 
     Entity Engine::createEntity()
     {
+        flushReserved();
         Entity res = mEntities.createEntity();
-        mEntityArchetype[res] = mEmptyRow;
+        // NULL_ENTITY once every ID is taken, reported by the entity manager
+        if (res != NULL_ENTITY)
+            mEntityArchetype[res] = mEmptyRow;
         return res;
     }
 
     void Engine::destroyEntity(Entity entity)
     {
-        // destroy
-        ECS_ASSERT(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        flushReserved();
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"));
+        if (mHierarchy.contain(entity) == false)
+        {
+            destroySingleEntity(entity);
+            return;
+        }
+        for (Entity e : mHierarchy.removeSubtree(entity))
+            destroySingleEntity(e);
+    }
+
+    Entity Engine::reserveEntity()
+    {
+        return mEntities.reserveEntity();
+    }
+
+    std::vector<Entity> Engine::reserveEntities(std::size_t count)
+    {
+        std::vector<Entity> res(count);
+        if (mEntities.reserveEntities(count, res.data()) == false)
+            res.clear();
+        return res;
+    }
+
+    void Engine::flushReserved()
+    {
+        if (mEntities.haveReserved() == false)
+            return;
+        for (Entity e : mEntities.takeReserved())
+            mEntityArchetype[e] = mEmptyRow;
+    }
+
+    // A dead entity in the hierarchy would never be destroyed with its parent, and its ID
+    // would come back with relationships it never had
+    void Engine::setParent(Entity child, Entity parent)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(child), ((std::string)"Entity " + std::to_string(child) + " was not created yet"));
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(parent), ((std::string)"Entity " + std::to_string(parent) + " was not created yet"));
+        mHierarchy.setParent(child, parent);
+    }
+
+    void Engine::removeParent(Entity child)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(child), ((std::string)"Entity " + std::to_string(child) + " was not created yet"));
+        mHierarchy.removeParent(child);
+    }
+
+    Entity Engine::getParent(Entity entity) const
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), NULL_ENTITY);
+        return mHierarchy.getParent(entity);
+    }
+
+    const std::vector<Entity>& Engine::getChildren(Entity entity) const
+    {
+        static const std::vector<Entity> noChildren;
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), noChildren);
+        return mHierarchy.getChildren(entity);
+    }
+
+    Hierarchy& Engine::getHierarchy()
+    {
+        return mHierarchy;
+    }
+
+    ResourceManager& Engine::getResources()
+    {
+        return mResources;
+    }
+
+    ComponentType Engine::registerRawComponent(const std::string& name, const RawComponentInfo& info)
+    {
+        const char* interned = internComponentName(name);
+        ECS_ASSERT(mTypeList.haveName(interned) == false, ((std::string)"Component type " + name + " registered twice"));
+        ECS_ASSERT(info.destruct == nullptr || info.move != nullptr, ((std::string)"Runtime component type " + name + " has a destructor but no move function"));
+        ComponentType type = mTypeList.registerName(interned);
+        if (type >= mRawTypes.size())
+            mRawTypes.resize(type + 1, std::make_pair(nullptr, RawComponentInfo()));
+        mRawTypes[type] = std::make_pair(interned, info);
+        mColumnPrototypes[interned] = std::make_shared<RawComponentVector>(interned, info);
+        return type;
+    }
+
+    ComponentType Engine::getRawComponentType(const std::string& name) const
+    {
+        return mTypeList.getType(internComponentName(name));
+    }
+
+    const RawComponentInfo& Engine::getRawComponentInfo(ComponentType type) const
+    {
+        getRawName(type);
+        return mRawTypes[type].second;
+    }
+
+    void* Engine::addRawComponent(Entity entity, ComponentType type)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), nullptr);
+        const char* name = getRawName(type);
+        ECS_ASSERT_OR_RETURN(haveRawComponent(entity, type) == false, ((std::string)"Component of type " + name + " added twice to entity " + std::to_string(entity)), nullptr);
+
+        Identifier id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        id.setType(type);
+        // The value is default constructed while transferring
+        uint32_t newArchetypeIndex = moveEntity(entity, id, [this, name, type](Archetype& arch)
+        {
+            arch.addRawType(name, type, mRawTypes[type].second);
+        });
+        mObservers.notify(type, ObserverEvent::Add, entity, id);
+        return mArchetypes[newArchetypeIndex].getRawVector(name)[entity];
+    }
+
+    void* Engine::getRawComponent(Entity entity, ComponentType type)
+    {
+        ECS_ASSERT_OR_RETURN(haveRawComponent(entity, type), ((std::string)"Component type " + getRawName(type) + " was not added but query data of entity " + std::to_string(entity)), nullptr);
+        return mArchetypes[mEntityArchetype[entity]].getRawVector(getRawName(type))[entity];
+    }
+
+    bool Engine::haveRawComponent(Entity entity, ComponentType type)
+    {
+        ECS_ASSERT_OR_RETURN(mEntities.isAlive(entity), ((std::string)"Entity " + std::to_string(entity) + " was not created yet"), false);
+        return mArchetypes[mEntityArchetype[entity]].haveRawType(getRawName(type));
+    }
+
+    void Engine::removeRawComponent(Entity entity, ComponentType type)
+    {
+        const char* name = getRawName(type);
+        ECS_ASSERT_OR_RETURN(haveRawComponent(entity, type), ((std::string)"Component of type " + name + " was not added to entity " + std::to_string(entity)));
+        mObservers.notify(type, ObserverEvent::Remove, entity, mArchetypes[mEntityArchetype[entity]].getIdentifier());
+
+        Identifier id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        id.removeType(type);
+        moveEntity(entity, id, [name, type](Archetype& arch)
+        {
+            arch.removeRawType(name, type);
+        });
+    }
+
+    void Engine::destroySingleEntity(Entity entity)
+    {
+        const Identifier& id = mArchetypes[mEntityArchetype[entity]].getIdentifier();
+        for (ComponentType type : id)
+            mObservers.notify(type, ObserverEvent::Remove, entity, id);
+        mObservers.removeEntity(entity);
         mEntities.retrieveEntity(entity);
-        for (auto& pr : mArchetypeIDs)
-            mArchetypes[pr.second].removeEntity(entity);
+        Archetype& arch = mArchetypes[mEntityArchetype[entity]];
+        if (arch.isPacked())
+            arch.unpack();
+        arch.removeEntity(entity);
+        mEntityArchetype[entity] = mEmptyRow;
+        mIndices.removeEntity(entity);
     }
 
     bool Engine::archetypesChanged()
@@ -37,33 +207,529 @@ namespace ECS
             mArchetypesChanged = false;
             return true;
         }
-        return true;
+        return false;
+    }
+
+    uint64_t Engine::getArchetypeVersion() const
+    {
+        return mArchetypeVersion;
     }
 
     std::vector<Archetype*> Engine::getArchetypeRefs(const Identifier& id)
     {
         std::vector<Archetype*> res;
-        for (auto i : mTable.getIntersection(id.getAllType()))
+        for (auto i : getMatchingRows(id))
             res.push_back(&mArchetypes[i]);
         return res;
     }
 
+    void Engine::restoreOrders()
+    {
+        for (auto order = mRowOrders.rbegin(); order != mRowOrders.rend(); ++order)
+            for (uint32_t i : getMatchingRows(order->first))
+                if (mArchetypes[i].isOrdered() == false)
+                    order->second(mArchetypes[i]);
+    }
+
+    std::vector<uint32_t> Engine::getMatchingRows(const Identifier& id) const
+    {
+        bool prefab = id.haveType(mPrefabType);
+        bool sleeping = id.haveType(mSleepingType);
+        if (prefab && sleeping)
+            return mTable.getIntersection(id);
+        return mTable.getIntersection(id, prefab ? mSleepingID : sleeping ? mPrefabID : mHiddenID);
+    }
+
+    bool Engine::isHiddenArchetype(uint32_t index) const
+    {
+        const Identifier& id = mArchetypes[index].getIdentifier();
+        return id.haveType(mPrefabType) || id.haveType(mSleepingType);
+    }
+
+    const char* Engine::getRawName(ComponentType type) const
+    {
+        ECS_ASSERT(type < mRawTypes.size() && mRawTypes[type].first != nullptr, ((std::string)"Component type " + std::to_string(type) + " is not a registered runtime component type"));
+        return mRawTypes[type].first;
+    }
+
+    std::vector<Entity> Engine::merge(Engine& staging)
+    {
+        std::vector<Entity> res;
+        ECS_ASSERT_OR_RETURN(&staging != this, "Engine merged into itself", res);
+        staging.flushReserved();
+        flushReserved();
+        // Refused before staging is touched: types this engine does not know (reported by
+        // getRemap), types shared in one engine only, or fewer IDs left than entities to move
+        std::vector<ComponentType> types = mTypeList.getRemap(staging.mTypeList);
+        if (std::find(types.begin(), types.end(), MAX_COMPONENT_TYPE) != types.end())
+            return res;
+        for (const Archetype& source : staging.mArchetypes)
+        {
+            if (source.getEntities().empty())
+                continue;
+            for (const auto& pr : source.getVectors())
+            {
+                bool shared = mColumnPrototypes.at(pr.first)->isShared();
+                ECS_ASSERT(shared == pr.second->isShared(), ((std::string)"Component type " + pr.first + " is shared in one of the merged engines only"));
+                if (shared != pr.second->isShared())
+                    return res;
+            }
+        }
+        std::vector<Entity> alive;
+        for (Entity e = 0; e < MAX_ENTITY; ++e)
+            if (staging.mEntities.isAlive(e))
+                alive.push_back(e);
+        std::vector<Entity> created = reserveEntities(alive.size());
+        if (created.size() != alive.size())
+            return res;
+        flushReserved();
+
+        // [staging entity] = new entity
+        if (alive.empty() == false)
+            res.resize(alive.back() + 1, NULL_ENTITY);
+        for (std::size_t i = 0; i < alive.size(); ++i)
+        {
+            Entity e = alive[i];
+            res[e] = created[i];
+            staging.mEntities.retrieveEntity(e);
+            staging.mEntityArchetype[e] = staging.mEmptyRow;
+            staging.mIndices.removeEntity(e);
+            staging.mObservers.removeEntity(e);
+        }
+
+        // Whole columns, one archetype at a time
+        for (Archetype& source : staging.mArchetypes)
+        {
+            if (source.getEntities().empty())
+                continue;
+            if (source.isPacked())
+                source.unpack();
+            Identifier id;
+            for (ComponentType type : source.getIdentifier())
+                id.setType(types[type]);
+            // Columns as this engine stores them, buffered or not: vectors of one type append
+            // from each other either way
+            uint32_t index = findOrCreateArchetype(id, mArchetypes[mEmptyRow], [this, &source](Archetype& arch)
+            {
+                for (const auto& pr : source.getVectors())
+                    arch.addVector(pr.first, mTypeList.getType(pr.first), mColumnPrototypes.at(pr.first)->createClone());
+            });
+            std::vector<Entity> entities;
+            for (Entity e : source.getEntities())
+                entities.push_back(res[e]);
+            Archetype& arch = mArchetypes[index];
+            // Sleeping entities of this engine may have been packed
+            if (arch.isPacked())
+                arch.unpack();
+            arch.appendFrom(source, res);
+            for (Entity e : entities)
+                mEntityArchetype[e] = index;
+
+            if (isHiddenArchetype(index))
+                continue;
+            for (const auto& pr : arch.getVectors())
+                for (Entity e : entities)
+                    if (const void* component = pr.second->getRawData(e))
+                        mIndices.setEntity(pr.first, e, component);
+            for (ComponentType type : id)
+                for (Entity e : entities)
+                    mObservers.notify(type, ObserverEvent::Add, e, id);
+        }
+
+        // Relationships, parents come first in depth order
+        const auto& order = staging.mHierarchy.getDepthOrder();
+        const auto& parents = staging.mHierarchy.getDepthParents();
+        for (std::size_t i = 0; i < order.size(); ++i)
+            if (parents[i] != Hierarchy::NO_PARENT)
+                mHierarchy.setParent(res[order[i]], res[order[parents[i]]]);
+        staging.mHierarchy = Hierarchy();
+        return res;
+    }
+
+    bool Engine::exportColumns(int fd, const Identifier& id)
+    {
+        std::vector<uint32_t> rows = getMatchingRows(id);
+
+        // Schema: every exportable type of the exported archetypes
+        // [type name] = position in the schema
+        std::unordered_map<const char*, uint32_t> schema;
+        std::vector<std::pair<const char*, uint32_t>> types;
+        for (uint32_t i : rows)
+        {
+            if (mArchetypes[i].getEntities().empty())
+                continue;
+            // Columns of packed archetypes are still described by their emptied vectors
+            for (const auto& pr : mArchetypes[i].getVectors())
+            {
+                const void* data;
+                std::size_t elementSize;
+                if (pr.second->getRawColumn(data, elementSize) && schema.find(pr.first) == schema.end())
+                {
+                    schema.emplace(pr.first, (uint32_t)types.size());
+                    types.emplace_back(pr.first, (uint32_t)elementSize);
+                }
+            }
+        }
+
+        ColumnWriter writer(fd);
+        writer.writeBytes("ECSC", 4);
+        writer.writeValue(COLUMN_EXPORT_VERSION);
+        writer.writeValue((uint32_t)types.size());
+        for (const auto& type : types)
+        {
+            uint32_t length = (uint32_t)std::strlen(type.first);
+            writer.writeValue(type.second);
+            writer.writeValue(length);
+            writer.writeBytes(type.first, length);
+        }
+
+        struct Column
+        {
+            uint32_t type;
+            const void* data;
+            std::size_t elementSize;
+        };
+        std::vector<Column> columns;
+        // Packed columns are decompressed here, their archetypes stay packed
+        std::vector<std::vector<uint8_t, AlignedAllocator<uint8_t>>> unpacked;
+        for (uint32_t i : rows)
+        {
+            const Archetype& arch = mArchetypes[i];
+            const auto& entities = arch.getEntities();
+            if (entities.empty())
+                continue;
+            columns.clear();
+            std::size_t used = 0;
+            for (const auto& pr : arch.getVectors())
+            {
+                Column column;
+                if (pr.second->getRawColumn(column.data, column.elementSize) == false)
+                    continue;
+                if (arch.isPacked())
+                {
+                    if (unpacked.size() == used)
+                        unpacked.emplace_back();
+                    arch.readPackedColumn(pr.first, unpacked[used]);
+                    column.data = unpacked[used++].data();
+                }
+                column.type = schema[pr.first];
+                columns.push_back(column);
+            }
+            writer.writeValue((uint32_t)entities.size());
+            writer.writeValue((uint32_t)columns.size());
+            writer.writeBlock(entities.data(), entities.size() * sizeof(Entity));
+            for (const auto& column : columns)
+            {
+                uint64_t length = (uint64_t)entities.size() * column.elementSize;
+                writer.writeValue(column.type);
+                writer.writeValue(length);
+                writer.writeBlock(column.data, length);
+            }
+        }
+        writer.writeValue(COLUMN_EXPORT_END);
+        return writer.flush();
+    }
+
+    Entity Engine::createPrefab()
+    {
+        Entity res = createEntity();
+        addComponent(res, Prefab{ 0 });
+        return res;
+    }
+
+    bool Engine::isPrefab(Entity entity)
+    {
+        return haveComponent<Prefab>(entity);
+    }
+
+    std::vector<Entity> Engine::instantiate(Entity prefab, std::size_t count)
+    {
+        std::vector<Entity> res;
+        // Refused before any entity is created, in release builds as well
+        bool prefabbed = mEntities.isAlive(prefab) && isPrefab(prefab);
+        ECS_ASSERT(prefabbed, ((std::string)"Entity " + std::to_string(prefab) + " is not a prefab but instantiated"));
+        if (prefabbed == false)
+            return res;
+        bool copyable = mArchetypes[mEntityArchetype[prefab]].isCopyable();
+        ECS_ASSERT(copyable, ((std::string)"Prefab " + std::to_string(prefab) + " has components that are not copyable but is instantiated"));
+        if (copyable == false)
+            return res;
+        // All IDs or none (the entity manager reports a shortage), a full engine would hand
+        // out NULL_ENTITY
+        flushReserved();
+        res = reserveEntities(count);
+        if (res.empty())
+            return res;
+        flushReserved();
+
+        uint32_t prefabIndex = mEntityArchetype[prefab];
+        Identifier id = mArchetypes[prefabIndex].getIdentifier();
+        id.removeType(mPrefabType);
+        uint32_t index = findOrCreateArchetype(id, mArchetypes[prefabIndex], [this](Archetype& arch)
+        {
+            arch.removeType<Prefab>(mTypeList);
+        });
+        Archetype& arch = mArchetypes[index];
+        if (arch.addEntities(res, mArchetypes[prefabIndex], prefab) == false)
+        {
+            // The instances got no component, their IDs go back
+            for (Entity e : res)
+                destroyEntity(e);
+            res.clear();
+            return res;
+        }
+        for (Entity e : res)
+            mEntityArchetype[e] = index;
+
+        // Indexes and observers see each instance as if its components were added one by one
+        for (const auto& pr : arch.getVectors())
+        {
+            // Every instance holds the same value
+            const void* component = pr.second->getRawData(res.front());
+            if (component == nullptr)
+                continue;
+            for (Entity e : res)
+                mIndices.setEntity(pr.first, e, component);
+        }
+        for (ComponentType type : id)
+            for (Entity e : res)
+                mObservers.notify(type, ObserverEvent::Add, e, id);
+        return res;
+    }
+
+    void Engine::sleepEntities(const std::vector<Entity>& entities, bool compress)
+    {
+        // Archetypes the entities land in, in first-seen order
+        std::vector<uint32_t> targets;
+        for (Entity e : entities)
+        {
+            ECS_ASSERT(mEntities.isAlive(e), ((std::string)"Entity " + std::to_string(e) + " was not created yet"));
+            ECS_ASSERT(isSleeping(e) == false, ((std::string)"Entity " + std::to_string(e) + " put to sleep twice"));
+            ECS_ASSERT(isPrefab(e) == false, ((std::string)"Prefab " + std::to_string(e) + " put to sleep"));
+            Identifier id = mArchetypes[mEntityArchetype[e]].getIdentifier();
+            id.setType(mSleepingType);
+            uint32_t index = moveEntity(e, id, [this](Archetype& arch)
+            {
+                arch.addType<Sleeping>(mTypeList);
+            });
+            mIndices.removeEntity(e);
+            if (std::find(targets.begin(), targets.end(), index) == targets.end())
+                targets.push_back(index);
+        }
+        if (compress)
+            for (uint32_t index : targets)
+                mArchetypes[index].pack(true);
+    }
+
+    void Engine::wakeEntities(const std::vector<Entity>& entities)
+    {
+        // Archetypes the entities leave that were packed
+        std::vector<uint32_t> packed;
+        for (Entity e : entities)
+        {
+            ECS_ASSERT(mEntities.isAlive(e), ((std::string)"Entity " + std::to_string(e) + " was not created yet"));
+            ECS_ASSERT(isSleeping(e), ((std::string)"Entity " + std::to_string(e) + " woken but not sleeping"));
+            uint32_t from = mEntityArchetype[e];
+            if (mArchetypes[from].isPacked())
+                packed.push_back(from);
+            Identifier id = mArchetypes[from].getIdentifier();
+            id.removeType(mSleepingType);
+            uint32_t index = moveEntity(e, id, [this](Archetype& arch)
+            {
+                arch.removeType<Sleeping>(mTypeList);
+            });
+            for (const auto& pr : mArchetypes[index].getVectors())
+                if (const void* component = pr.second->getRawData(e))
+                    mIndices.setEntity(pr.first, e, component);
+        }
+        for (uint32_t index : packed)
+            if (mArchetypes[index].isPacked() == false && mArchetypes[index].getEntities().empty() == false)
+                mArchetypes[index].pack(true);
+    }
+
+    bool Engine::isSleeping(Entity entity)
+    {
+        return haveComponent<Sleeping>(entity);
+    }
+
+    std::size_t Engine::swapBuffers()
+    {
+        for (auto& pr : mBufferedColumns)
+            pr.second.clear();
+        if (mBufferedColumns.empty())
+            return 0;
+        std::size_t res = 0;
+        // Slot order, so readers visit archetypes in the same order on every run
+        std::vector<uint32_t> live;
+        for (const auto& pr : mArchetypeIDs)
+            live.push_back(pr.second);
+        std::sort(live.begin(), live.end());
+        for (uint32_t index : live)
+        {
+            const Archetype& arch = mArchetypes[index];
+            bool hidden = isHiddenArchetype(index);
+            for (const auto& pr : arch.getVectors())
+            {
+                auto columns = mBufferedColumns.find(pr.first);
+                if (columns == mBufferedColumns.end())
+                    continue;
+                res += dynamic_cast<IBufferedVector&>(*pr.second).swapBuffers();
+                if (hidden == false)
+                    columns->second.push_back(pr.second);
+            }
+        }
+        return res;
+    }
+
     void Engine::flushEmpty()
     {
-        std::vector<std::bitset<MAX_COMPONENT_TYPE>> tobeRemoved;
+        ECS_PROFILE(mProfiler.count(ProfileCounter::FlushEmpty));
+        ECS_PROFILE(ProfileScope scope(mProfiler, "Engine::flushEmpty"));
+        std::vector<uint32_t> tobeRemoved;
 
         for (auto& pr : mArchetypeIDs)
+            if (pr.second != mEmptyRow && mArchetypes[pr.second].getEntities().empty())
+                tobeRemoved.push_back(pr.second);
+        // Freed slots are reused in this order, hashing must not decide it
+        std::sort(tobeRemoved.begin(), tobeRemoved.end());
+
+        for (auto i : tobeRemoved)
+            removeArchetype(i);
+    }
+
+    void Engine::compact()
+    {
+        uint32_t rows = mTable.getRowCount();
+        for (uint32_t step = 0; step < mCompaction.archetypesPerStep && step < rows; ++step)
         {
-            if (pr.first == std::bitset<MAX_COMPONENT_TYPE>())
+            uint32_t i = mCompactionCursor;
+            mCompactionCursor = (mCompactionCursor + 1) % rows;
+            if (i == mEmptyRow || mTable.haveRow(i) == false)
                 continue;
-            if (mArchetypes[pr.second].getEntities().empty())
+
+            Archetype& arch = mArchetypes[i];
+            if (arch.getEntities().empty())
+            {
+                if (++mEmptyVisits[i] >= mCompaction.emptyVisits)
+                    removeArchetype(i);
+            }
+            else
+            {
+                mEmptyVisits[i] = 0;
+                arch.shrinkToFit(mCompaction.minWastedBytes);
+            }
+        }
+    }
+
+    void Engine::setCompactionPolicy(const CompactionPolicy& policy)
+    {
+        mCompaction = policy;
+    }
+
+    RegistryStats Engine::getRegistryStats() const
+    {
+        RegistryStats res;
+        for (const auto& pr : mArchetypeIDs)
+        {
+            const Archetype& arch = mArchetypes[pr.second];
+            res.archetypes++;
+            if (arch.getEntities().empty())
+                res.emptyArchetypes++;
+            res.archetypeBytes += arch.getByteSize();
+            res.wastedBytes += arch.getWastedBytes();
+        }
+        res.freeSlots = mTable.getFreeRowCount();
+        res.recordBytes = mTable.getByteSize();
+        return res;
+    }
+
+    MemoryStats Engine::memoryStats() const
+    {
+        MemoryStats res;
+        res.registry = getRegistryStats();
+        uint32_t occupied = 0;
+        std::size_t entities = 0;
+        for (const auto& pr : mArchetypeIDs)
+        {
+            const Archetype& arch = mArchetypes[pr.second];
+            ArchetypeMemory mem;
+            mem.index = pr.second;
+            mem.identifier = pr.first;
+            mem.entities = (uint32_t)arch.getEntities().size();
+            mem.bytes = arch.getByteSize();
+            mem.wastedBytes = arch.getWastedBytes();
+            for (const auto& vec : arch.getVectors())
             {
-                mTable.removeRow(pr.second, mArchetypes[pr.second].getIdentifier());
-                tobeRemoved.push_back(pr.first);
+                ColumnMemory column;
+                column.type = vec.first;
+                column.bytes = vec.second->getByteSize();
+                column.wastedBytes = vec.second->getWastedBytes();
+                mem.columns.push_back(column);
             }
+            std::sort(mem.columns.begin(), mem.columns.end(), [](const ColumnMemory& a, const ColumnMemory& b)
+            {
+                return std::strcmp(a.type, b.type) < 0;
+            });
+            if (mem.entities > 0)
+                occupied++;
+            entities += mem.entities;
+            res.archetypes.push_back(std::move(mem));
         }
+        std::sort(res.archetypes.begin(), res.archetypes.end(), [](const ArchetypeMemory& a, const ArchetypeMemory& b)
+        {
+            return a.index < b.index;
+        });
+
+        constexpr std::size_t idNodeSize = sizeof(std::pair<const Identifier, uint32_t>) + sizeof(void*);
+        res.archetypeSlotBytes = mArchetypes.size() * sizeof(Archetype)
+            + mArchetypeIDs.size() * idNodeSize + mArchetypeIDs.bucket_count() * sizeof(void*);
+        res.entityBytes = sizeof(mEntityArchetype) + sizeof(mEntityRow) + mEntities.getByteSize();
+        res.indexBytes = mIndices.getByteSize();
+        res.hierarchyBytes = mHierarchy.getByteSize();
+        for (const auto& pr : mSharedPools)
+            res.sharedPoolBytes += pr.second->getByteSize();
+        res.totalBytes = res.registry.archetypeBytes + res.registry.recordBytes + res.archetypeSlotBytes
+            + res.entityBytes + res.indexBytes + res.hierarchyBytes + res.sharedPoolBytes;
+        if (res.registry.archetypeBytes > 0)
+            res.wastedRatio = (float)res.registry.wastedBytes / res.registry.archetypeBytes;
+        if (occupied > 0)
+            res.entitiesPerArchetype = (float)entities / occupied;
+        return res;
+    }
 
-        for(auto& i : tobeRemoved)
-            mArchetypeIDs.erase(i);
+    void Engine::removeArchetype(uint32_t index)
+    {
+        Archetype& arch = mArchetypes[index];
+        ECS_ASSERT(arch.getEntities().empty(), ((std::string)"Removal of archetype " + std::to_string(index) + " still containing entities"));
+        mTable.removeRow(index, arch.getIdentifier());
+        mArchetypeIDs.erase(arch.getIdentifier());
+        // Release the component vectors' memory
+        arch = Archetype();
+        mEmptyVisits[index] = 0;
+        mArchetypesChanged = true;
+        mArchetypeVersion++;
+    }
+
+    #ifdef ARCHETYPE_PROFILE
+    Profiler& Engine::getProfiler()
+    {
+        return mProfiler;
+    }
+
+    std::vector<ArchetypeStats> Engine::getArchetypeStats() const
+    {
+        std::vector<ArchetypeStats> res;
+        for (const auto& pr : mArchetypeIDs)
+        {
+            const Archetype& arch = mArchetypes[pr.second];
+            res.push_back({ pr.second, arch.getEntities().size(), arch.getByteSize() });
+        }
+        return res;
+    }
+
+    void Engine::writeChromeTrace(std::ostream& os) const
+    {
+        mProfiler.writeChromeTrace(os, getArchetypeStats());
     }
+    #endif
 }
@@ -7,35 +7,74 @@
 namespace ECS
 {
     EntityManager::EntityManager()
-        : mContainer()
+        : mFree()
+        , mCursor(MAX_ENTITY)
     {
+        mFree.reserve(MAX_ENTITY);
         for (Entity e = 0; e < MAX_ENTITY; ++e)
         {
-            mContainer.push(e);
+            mFree.push_back(e);
             mAlive.set(e, false);
         }
     }
 
     Entity EntityManager::createEntity()
     {
-        ECS_ASSERT(mContainer.empty() == false, "Too many entities");
-        Entity res = mContainer.top();
-        mContainer.pop();
+        ECS_ASSERT(haveReserved() == false, "Reserved entities must be taken before creating entities");
+        ECS_ASSERT_OR_RETURN(mFree.empty() == false, "Too many entities", NULL_ENTITY);
+        Entity res = mFree.back();
+        mFree.pop_back();
+        mCursor.store((int64_t)mFree.size(), std::memory_order_relaxed);
         mAlive.set(res, true);
         return res;
     }
 
     void EntityManager::retrieveEntity(Entity e)
     {
-        ECS_ASSERT(e < MAX_ENTITY, ((std::string)"Entity retrieval got entity " + std::to_string(e) + " out of bounds"));
-        ECS_ASSERT(mAlive[e], ((std::string)"Entity " + std::to_string(e) + " was not created yet"));
-        mContainer.push(e);
+        // A second retrieval would hand the ID out twice
+        ECS_ASSERT_OR_RETURN(isAlive(e), ((std::string)"Entity " + std::to_string(e) + " was not created yet"));
+        ECS_ASSERT(haveReserved() == false, "Reserved entities must be taken before retrieving entities");
+        mFree.push_back(e);
+        mCursor.store((int64_t)mFree.size(), std::memory_order_relaxed);
         mAlive.set(e, false);
     }
 
-    bool EntityManager::isAlive(Entity e) const
+    Entity EntityManager::reserveEntity()
     {
-        ECS_ASSERT(e < MAX_ENTITY, ((std::string)"Entity query of entity " + std::to_string(e) + " out of bound"));
-        return mAlive.test(e);
+        Entity res;
+        if (reserveEntities(1, &res) == false)
+            return NULL_ENTITY;
+        return res;
+    }
+
+    bool EntityManager::reserveEntities(std::size_t count, Entity* out)
+    {
+        // mFree itself is not modified until takeReserved(), so reading it is safe
+        int64_t end = mCursor.fetch_sub((int64_t)count, std::memory_order_relaxed);
+        int64_t begin = end - (int64_t)count;
+        if (begin < 0)
+        {
+            mCursor.fetch_add((int64_t)count, std::memory_order_relaxed);
+            ECS_ASSERT(false, ((std::string)"Too many entities, cannot reserve " + std::to_string(count)));
+            return false;
+        }
+        for (int64_t i = end; i > begin; --i)
+            *out++ = mFree[i - 1];
+        return true;
+    }
+
+    std::vector<Entity> EntityManager::takeReserved()
+    {
+        std::size_t cursor = (std::size_t)mCursor.load(std::memory_order_acquire);
+        std::vector<Entity> res(mFree.begin() + cursor, mFree.end());
+        mFree.resize(cursor);
+        for (auto e : res)
+            mAlive.set(e, true);
+        return res;
+    }
+
+    std::size_t EntityManager::getByteSize() const
+    {
+        return sizeof(mAlive) + mFree.capacity() * sizeof(Entity);
     }
 }
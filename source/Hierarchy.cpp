@@ -0,0 +1,149 @@
+#include "../include/ECS/Hierarchy.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace ECS
+{
+    Hierarchy::Hierarchy()
+        : mDirty(false)
+        , mOffsets(1, 0)
+    { }
+
+    void Hierarchy::setParent(Entity child, Entity parent)
+    {
+        ECS_ASSERT(child != parent, ((std::string)"Entity " + std::to_string(child) + " set as its own parent"));
+        ECS_ASSERT(isAncestor(child, parent) == false, ((std::string)"Setting parent of entity " + std::to_string(child) + " to " + std::to_string(parent) + " creates a cycle"));
+        removeParent(child);
+        mParents[child] = parent;
+        mChildren[parent].push_back(child);
+        mDirty = true;
+    }
+
+    void Hierarchy::removeParent(Entity child)
+    {
+        auto found = mParents.find(child);
+        if (found == mParents.end())
+            return;
+        auto& siblings = mChildren[found->second];
+        siblings.erase(std::find(siblings.begin(), siblings.end(), child));
+        if (siblings.empty())
+            mChildren.erase(found->second);
+        mParents.erase(found);
+        mDirty = true;
+    }
+
+    Entity Hierarchy::getParent(Entity entity) const
+    {
+        auto found = mParents.find(entity);
+        return found == mParents.end() ? NULL_ENTITY : found->second;
+    }
+
+    const std::vector<Entity>& Hierarchy::getChildren(Entity entity) const
+    {
+        auto found = mChildren.find(entity);
+        return found == mChildren.end() ? mNoChildren : found->second;
+    }
+
+    bool Hierarchy::contain(Entity entity) const
+    {
+        return mParents.find(entity) != mParents.end() || mChildren.find(entity) != mChildren.end();
+    }
+
+    bool Hierarchy::isAncestor(Entity ancestor, Entity entity) const
+    {
+        for (Entity e = entity; e != NULL_ENTITY; e = getParent(e))
+            if (e == ancestor)
+                return true;
+        return false;
+    }
+
+    std::vector<Entity> Hierarchy::removeSubtree(Entity entity)
+    {
+        removeParent(entity);
+        std::vector<Entity> res(1, entity);
+        for (std::size_t i = 0; i < res.size(); ++i)
+        {
+            auto found = mChildren.find(res[i]);
+            if (found == mChildren.end())
+                continue;
+            for (Entity child : found->second)
+            {
+                mParents.erase(child);
+                res.push_back(child);
+            }
+            mChildren.erase(found);
+        }
+        mDirty = true;
+        return res;
+    }
+
+    const std::vector<Entity>& Hierarchy::getDepthOrder()
+    {
+        if (mDirty)
+            rebuild();
+        return mOrder;
+    }
+
+    const std::vector<uint32_t>& Hierarchy::getDepthParents()
+    {
+        if (mDirty)
+            rebuild();
+        return mOrderParents;
+    }
+
+    const std::vector<uint32_t>& Hierarchy::getDepthOffsets()
+    {
+        if (mDirty)
+            rebuild();
+        return mOffsets;
+    }
+
+    std::size_t Hierarchy::getByteSize() const
+    {
+        constexpr std::size_t parentSize = sizeof(std::pair<const Entity, Entity>) + sizeof(void*);
+        constexpr std::size_t childrenSize = sizeof(std::pair<const Entity, std::vector<Entity>>) + sizeof(void*);
+        std::size_t res = mParents.size() * parentSize + mChildren.size() * childrenSize
+            + (mParents.bucket_count() + mChildren.bucket_count()) * sizeof(void*)
+            + mNoChildren.capacity() * sizeof(Entity) + mOrder.capacity() * sizeof(Entity)
+            + (mOrderParents.capacity() + mOffsets.capacity()) * sizeof(uint32_t);
+        for (const auto& pr : mChildren)
+            res += pr.second.capacity() * sizeof(Entity);
+        return res;
+    }
+
+    void Hierarchy::rebuild()
+    {
+        mOrder.clear();
+        mOrderParents.clear();
+        mOffsets.assign(1, 0);
+
+        // Roots are sorted so the order does not depend on hashing
+        for (const auto& pr : mChildren)
+            if (mParents.find(pr.first) == mParents.end())
+                mOrder.push_back(pr.first);
+        std::sort(mOrder.begin(), mOrder.end());
+        mOrderParents.assign(mOrder.size(), NO_PARENT);
+
+        // Breadth-first, one depth per iteration
+        uint32_t begin = 0;
+        while (begin < mOrder.size())
+        {
+            uint32_t end = (uint32_t)mOrder.size();
+            mOffsets.push_back(end);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                auto found = mChildren.find(mOrder[i]);
+                if (found == mChildren.end())
+                    continue;
+                for (Entity child : found->second)
+                {
+                    mOrder.push_back(child);
+                    mOrderParents.push_back(i);
+                }
+            }
+            begin = end;
+        }
+        mDirty = false;
+    }
+}
@@ -5,4 +5,36 @@ namespace ECS
     IDGenerator::IDGenerator()
         : mAvailableType(0)
     { }
+
+    ComponentType IDGenerator::registerName(const char* name)
+    {
+        ECS_ASSERT(haveName(name) == false, ((std::string)"Component type " + name + " registered twice in IDGenerator"));
+        ECS_ASSERT(mAvailableType < MAX_COMPONENT_TYPE, ((std::string)"Too much component types registered in IDGenerator"));
+        mTypeNumber.emplace(name, mAvailableType);
+        return mAvailableType++;
+    }
+
+    ComponentType IDGenerator::getType(const char* name) const
+    {
+        ECS_ASSERT(haveName(name), ((std::string)"Component type " + name + " was not registered in IDGenerator"));
+        return mTypeNumber.at(name);
+    }
+
+    bool IDGenerator::haveName(const char* name) const
+    {
+        return mTypeNumber.find(name) != mTypeNumber.end();
+    }
+
+    std::vector<ComponentType> IDGenerator::getRemap(const IDGenerator& other) const
+    {
+        std::vector<ComponentType> res(other.mAvailableType, MAX_COMPONENT_TYPE);
+        for (const auto& pr : other.mTypeNumber)
+        {
+            auto found = mTypeNumber.find(pr.first);
+            ECS_ASSERT(found != mTypeNumber.end(), ((std::string)"Component type " + pr.first + " was not registered in IDGenerator but remapped"));
+            if (found != mTypeNumber.end())
+                res[pr.second] = found->second;
+        }
+        return res;
+    }
 }
@@ -1,27 +1,59 @@
 #include "../include/ECS/Identifier.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
 namespace ECS
 {
+    namespace
+    {
+        // Well mixed hash of one component type. The identifier's hash is the xor
+        // of those of its types, so adding and removing a type is O(1)
+        uint64_t hashType(ComponentType t)
+        {
+            uint64_t x = (uint64_t)t + 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+    }
+
     Identifier::Identifier()
-        : mValue()
-        , mTypes()
+        : mInline()
+        , mOverflow()
+        , mSize(0)
+        , mHash(0)
     { }
 
     Identifier::Identifier(const std::vector<ComponentType>& ts)
+        : Identifier()
     {
         setType(ts);
     }
 
-    void Identifier::setType(ComponentType t1)
+    bool Identifier::setType(ComponentType t1)
     {
-        ECS_ASSERT(t1 < MAX_COMPONENT_TYPE, ((std::string)"Identifier::setType parameter out of bounds: t1 = " + std::to_string(t1)));
-        ECS_ASSERT(mValue.test(t1) == false, ((std::string)"Component ID " + std::to_string(t1) + " set in identifier already"));
+        ECS_ASSERT_OR_RETURN(t1 < MAX_COMPONENT_TYPE, ((std::string)"Identifier::setType parameter out of bounds: t1 = " + std::to_string(t1)), false);
+        // The search for the type's place also finds it if it is already set
+        std::size_t pos = std::lower_bound(begin(), end(), t1) - begin();
+        if (pos != mSize && begin()[pos] == t1)
+            return false;
 
-        mValue.set(t1);
-        mTypes.insert(t1);
+        if (mSize == INLINE_CAPACITY)
+            mOverflow.assign(mInline.begin(), mInline.end());
+        if (mSize >= INLINE_CAPACITY)
+            mOverflow.push_back(t1);
+        else
+            mInline[mSize] = t1;
+        ++mSize;
+
+        // Keep types sorted by moving the new one to its place
+        ComponentType* types = data();
+        std::copy_backward(types + pos, types + mSize - 1, types + mSize);
+        types[pos] = t1;
+        mHash ^= hashType(t1);
+        return true;
     }
 
     void Identifier::setType(const std::vector<ComponentType>& ts)
@@ -30,30 +62,76 @@ namespace ECS
             setType(i);
     }
 
-    void Identifier::removeType(ComponentType t1)
+    bool Identifier::removeType(ComponentType t1)
+    {
+        ComponentType* types = data();
+        ComponentType* found = std::lower_bound(types, types + mSize, t1);
+        if (found == types + mSize || *found != t1)
+            return false;
+
+        std::copy(found + 1, types + mSize, found);
+        --mSize;
+        if (mSize >= INLINE_CAPACITY)
+            mOverflow.pop_back();
+        if (mSize == INLINE_CAPACITY)
+        {
+            std::copy(mOverflow.begin(), mOverflow.end(), mInline.begin());
+            mOverflow.clear();
+        }
+        mHash ^= hashType(t1);
+        return true;
+    }
+
+    bool Identifier::haveType(ComponentType t) const
     {
-        mValue.set(t1, false);
-        mTypes.erase(t1);
+        return std::binary_search(begin(), end(), t);
     }
 
     bool Identifier::contain(const Identifier& id) const
     {
-        return (mValue & id.mValue) == id.mValue;
+        return std::includes(begin(), end(), id.begin(), id.end());
+    }
+
+    uint64_t Identifier::getHash() const
+    {
+        return mHash;
     }
 
-    const std::bitset<MAX_COMPONENT_TYPE>& Identifier::getValue() const
+    std::size_t Identifier::getSize() const
     {
-        return mValue;
+        return mSize;
     }
 
-    const std::unordered_set<ComponentType>& Identifier::getAllType() const
+    const ComponentType* Identifier::begin() const
     {
-        return mTypes;
+        return mSize > INLINE_CAPACITY ? mOverflow.data() : mInline.data();
+    }
+
+    const ComponentType* Identifier::end() const
+    {
+        return begin() + mSize;
+    }
+
+    bool Identifier::operator == (const Identifier& id) const
+    {
+        return mHash == id.mHash && mSize == id.mSize && std::equal(begin(), end(), id.begin());
+    }
+
+    bool Identifier::operator != (const Identifier& id) const
+    {
+        return !(*this == id);
     }
 
     void Identifier::swap(Identifier& obj)
     {
-        std::swap(mValue, obj.mValue);
-        mTypes.swap(obj.mTypes);
+        std::swap(mInline, obj.mInline);
+        mOverflow.swap(obj.mOverflow);
+        std::swap(mSize, obj.mSize);
+        std::swap(mHash, obj.mHash);
+    }
+
+    ComponentType* Identifier::data()
+    {
+        return mSize > INLINE_CAPACITY ? mOverflow.data() : mInline.data();
     }
 }
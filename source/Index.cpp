@@ -0,0 +1,10 @@
+#include "../include/ECS/Index.hpp"
+
+namespace ECS
+{
+    IComponentIndex::IComponentIndex()
+    { }
+
+    IComponentIndex::~IComponentIndex()
+    { }
+}
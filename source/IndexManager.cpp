@@ -0,0 +1,32 @@
+#include "../include/ECS/IndexManager.hpp"
+
+namespace ECS
+{
+    IndexManager::IndexManager()
+    { }
+
+    void IndexManager::removeEntity(Entity entity)
+    {
+        for (const auto& pr : mIndices)
+            for (const auto& index : pr.second)
+                index->removeEntity(entity);
+    }
+
+    void IndexManager::setEntity(const char* typeName, Entity entity, const void* component)
+    {
+        auto found = mIndices.find(typeName);
+        if (found == mIndices.end())
+            return;
+        for (const auto& index : found->second)
+            index->setEntityRaw(entity, component);
+    }
+
+    std::size_t IndexManager::getByteSize() const
+    {
+        std::size_t res = 0;
+        for (const auto& pr : mIndices)
+            for (const auto& index : pr.second)
+                res += index->getByteSize();
+        return res;
+    }
+}
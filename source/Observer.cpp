@@ -0,0 +1,123 @@
+#include "../include/ECS/Observer.hpp"
+
+#include <string>
+
+namespace ECS
+{
+    ReactiveQuery::ReactiveQuery(const Identifier& id, ObserverEvent events)
+        : mID(id)
+        , mEvents(events)
+    { }
+
+    const std::vector<Entity>& ReactiveQuery::getEntities() const
+    {
+        return mEntities;
+    }
+
+    bool ReactiveQuery::haveEntity(Entity entity) const
+    {
+        return mPositions.find(entity) != mPositions.end();
+    }
+
+    void ReactiveQuery::clear()
+    {
+        mEntities.clear();
+        mPositions.clear();
+    }
+
+    const Identifier& ReactiveQuery::getIdentifier() const
+    {
+        return mID;
+    }
+
+    void ReactiveQuery::notify(ObserverEvent event, Entity entity, const Identifier& entityID)
+    {
+        if (event == ObserverEvent::Remove)
+        {
+            // The entity leaves the query unless losing the type is what it waits for
+            if (haveEvent(mEvents, ObserverEvent::Remove))
+                push(entity);
+            else
+                drop(entity);
+        }
+        else if (haveEvent(mEvents, event) && entityID.contain(mID))
+            push(entity);
+    }
+
+    void ReactiveQuery::push(Entity entity)
+    {
+        if (haveEntity(entity))
+            return;
+        mPositions[entity] = (uint32_t)mEntities.size();
+        mEntities.push_back(entity);
+    }
+
+    void ReactiveQuery::drop(Entity entity)
+    {
+        auto found = mPositions.find(entity);
+        if (found == mPositions.end())
+            return;
+        uint32_t pos = found->second;
+        mPositions.erase(found);
+        if (pos != mEntities.size() - 1)
+        {
+            mEntities[pos] = mEntities.back();
+            mPositions[mEntities[pos]] = pos;
+        }
+        mEntities.pop_back();
+    }
+
+    ObserverManager::ObserverManager()
+        : mEmpty(true)
+    { }
+
+    void ObserverManager::addObserver(ComponentType type, ObserverEvent event, Callback callback)
+    {
+        ECS_ASSERT(event == ObserverEvent::Add || event == ObserverEvent::Remove || event == ObserverEvent::Set, ((std::string)"Observer of component type " + std::to_string(type) + " must watch exactly one event"));
+        if (event == ObserverEvent::Add)
+            mOnAdd[type].push_back(std::move(callback));
+        else if (event == ObserverEvent::Remove)
+            mOnRemove[type].push_back(std::move(callback));
+        else
+            mOnSet[type].push_back(std::move(callback));
+        mEmpty = false;
+    }
+
+    std::shared_ptr<ReactiveQuery> ObserverManager::addQuery(const Identifier& id, ObserverEvent events)
+    {
+        auto res = std::make_shared<ReactiveQuery>(id, events);
+        mQueries.push_back(res);
+        for (ComponentType type : id)
+            mTypeQueries[type].push_back(res.get());
+        mEmpty = false;
+        return res;
+    }
+
+    void ObserverManager::removeEntity(Entity entity)
+    {
+        for (auto& query : mQueries)
+            query->drop(entity);
+    }
+
+    void ObserverManager::addExcludedType(ComponentType type)
+    {
+        mExcludedTypes.push_back(type);
+    }
+
+    void ObserverManager::dispatch(ComponentType type, ObserverEvent event, Entity entity, const Identifier& entityID)
+    {
+        for (ComponentType excluded : mExcludedTypes)
+            if (entityID.haveType(excluded))
+                return;
+        auto& callbacks = event == ObserverEvent::Add ? mOnAdd : event == ObserverEvent::Remove ? mOnRemove : mOnSet;
+        auto found = callbacks.find(type);
+        if (found != callbacks.end())
+            for (const auto& callback : found->second)
+                callback(entity);
+
+        auto queries = mTypeQueries.find(type);
+        if (queries != mTypeQueries.end())
+            for (ReactiveQuery* query : queries->second)
+                query->notify(event, entity, entityID);
+    }
+}
@@ -0,0 +1,114 @@
+#include "../include/ECS/Parallel.hpp"
+
+#include <algorithm>
+
+namespace ECS
+{
+    ParallelExecutor::ParallelExecutor(Engine& engine, unsigned threads, std::size_t partitionSize)
+        : mEngine(engine)
+        , mPartitionSize(partitionSize)
+        , mGeneration(0)
+        , mBusy(0)
+        , mStop(false)
+        , mTask(nullptr)
+        , mTaskCount(0)
+        , mNextTask(0)
+    {
+        ECS_ASSERT(threads > 0, "Parallel executor without thread");
+        ECS_ASSERT(partitionSize > 0, "Parallel executor with partitions of 0 rows");
+        for (unsigned i = 1; i < threads; ++i)
+            mWorkers.emplace_back(&ParallelExecutor::work, this);
+    }
+
+    ParallelExecutor::~ParallelExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        for (auto& worker : mWorkers)
+            worker.join();
+    }
+
+    unsigned ParallelExecutor::getThreadCount() const
+    {
+        return (unsigned)mWorkers.size() + 1;
+    }
+
+    std::size_t ParallelExecutor::getPartitionSize() const
+    {
+        return mPartitionSize;
+    }
+
+    void ParallelExecutor::partition(const Identifier& id)
+    {
+        mEngine.restoreOrders();
+        mRanges.clear();
+        // Archetypes come in slot order
+        for (Archetype* arch : mEngine.getArchetypeRefs(id))
+        {
+            std::size_t size = arch->getEntities().size();
+            for (std::size_t begin = 0; begin < size; begin += mPartitionSize)
+                mRanges.push_back({ arch, begin, std::min(mPartitionSize, size - begin) });
+        }
+        if (mCommands.size() < mRanges.size())
+            mCommands.resize(mRanges.size());
+    }
+
+    void ParallelExecutor::run(std::size_t count, const std::function<void(std::size_t)>& task)
+    {
+        if (mWorkers.empty() || count < 2)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTask = &task;
+            mTaskCount = count;
+            mNextTask.store(0, std::memory_order_relaxed);
+            mBusy = (unsigned)mWorkers.size();
+            mGeneration++;
+        }
+        mWake.notify_all();
+        drain();
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]() { return mBusy == 0; });
+        mTask = nullptr;
+    }
+
+    void ParallelExecutor::drain()
+    {
+        for (std::size_t i = mNextTask.fetch_add(1, std::memory_order_relaxed); i < mTaskCount;
+             i = mNextTask.fetch_add(1, std::memory_order_relaxed))
+            (*mTask)(i);
+    }
+
+    void ParallelExecutor::work()
+    {
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mWake.wait(lock, [this, generation]() { return mStop || mGeneration != generation; });
+            if (mStop)
+                return;
+            generation = mGeneration;
+            lock.unlock();
+            drain();
+            lock.lock();
+            if (--mBusy == 0)
+                mDone.notify_one();
+        }
+    }
+
+    void ParallelExecutor::applyCommands()
+    {
+        // Partition order, whatever order the partitions ran in
+        for (std::size_t i = 0; i < mRanges.size(); ++i)
+            if (mCommands[i].empty() == false)
+                mCommands[i].apply(mEngine);
+    }
+}
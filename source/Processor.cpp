@@ -1,21 +1,161 @@
 #include "../include/ECS/Processor.hpp"
 #include "../include/ECS/Engine.hpp"
 
+#include <algorithm>
+
 namespace ECS
 {
     Processor::Processor(Engine& engine)
         : mEngine(engine)
-    { }
+        , mResources(engine.getResources())
+        , mArchetypeVersion(UINT64_MAX)
+        , mCursorArchetype(0)
+        , mCursorRow(0)
+        , mSliceLeft(0)
+        , mSliceVisited(0)
+        , mPassDone(false)
+    {
+        ECS_PROFILE(mName = "Processor");
+    }
 
     void Processor::setIdentifier(const Identifier& id)
     {
         mID = id;
+        mArchetypeVersion = UINT64_MAX;
+        resetCursor();
     }
 
     std::vector<Archetype*>& Processor::getData()
     {
-        if (mEngine.archetypesChanged())
-            mArchetypeRefs = mEngine.getArchetypeRefs(mID);
+        updateRefs();
+        mEngine.restoreOrders();
+        #ifdef ARCHETYPE_PROFILE
+        std::size_t visited = 0;
+        for (const auto arch : mArchetypeRefs)
+            visited += arch->getEntities().size();
+        mEngine.getProfiler().addEntitiesVisited(mName, visited);
+        #endif
         return mArchetypeRefs;
     }
+
+    void Processor::setBudget(const SliceBudget& budget)
+    {
+        ECS_ASSERT(budget.granularity > 0, "Slice budget with granularity 0");
+        mBudget = budget;
+    }
+
+    void Processor::resetCursor()
+    {
+        mCursorArchetype = 0;
+        mCursorRow = 0;
+        mCursorID = Identifier();
+    }
+
+    bool Processor::updateRefs()
+    {
+        if (mArchetypeVersion == mEngine.getArchetypeVersion())
+            return false;
+        mArchetypeRefs = mEngine.getArchetypeRefs(mID);
+        mArchetypeVersion = mEngine.getArchetypeVersion();
+        return true;
+    }
+
+    void Processor::beginSlice()
+    {
+        if (updateRefs() && (mCursorArchetype != 0 || mCursorRow != 0))
+        {
+            // Find the archetype the cursor was in, or start the one now at its position
+            auto found = std::find_if(mArchetypeRefs.begin(), mArchetypeRefs.end(), [this](const Archetype* arch)
+            {
+                return arch->getIdentifier() == mCursorID;
+            });
+            if (found == mArchetypeRefs.end())
+                mCursorRow = 0;
+            else
+                mCursorArchetype = found - mArchetypeRefs.begin();
+        }
+        mCursorArchetype = std::min(mCursorArchetype, mArchetypeRefs.size());
+        mEngine.restoreOrders();
+        mSliceLeft = mBudget.entities;
+        mSliceVisited = 0;
+        mPassDone = false;
+        if (mBudget.microseconds > 0)
+            mSliceStart = std::chrono::steady_clock::now();
+    }
+
+    bool Processor::nextSlice(Archetype*& arch, std::size_t& begin, std::size_t& end)
+    {
+        while (mCursorArchetype < mArchetypeRefs.size() && mCursorRow >= mArchetypeRefs[mCursorArchetype]->getEntities().size())
+        {
+            ++mCursorArchetype;
+            mCursorRow = 0;
+        }
+        if (mCursorArchetype == mArchetypeRefs.size())
+        {
+            resetCursor();
+            mPassDone = true;
+            return false;
+        }
+        if (mSliceLeft == 0)
+            return false;
+        // At least one range per call so slow processors still progress
+        if (mBudget.microseconds > 0 && mSliceVisited > 0
+            && std::chrono::steady_clock::now() - mSliceStart >= std::chrono::microseconds(mBudget.microseconds))
+            return false;
+
+        arch = mArchetypeRefs[mCursorArchetype];
+        std::size_t count = std::min(arch->getEntities().size() - mCursorRow, mSliceLeft);
+        if (mBudget.microseconds > 0)
+            count = std::min(count, mBudget.granularity);
+        begin = mCursorRow;
+        end = begin + count;
+        mCursorRow = end;
+        mSliceLeft -= count;
+        mSliceVisited += count;
+        return true;
+    }
+
+    bool Processor::endSlice()
+    {
+        if (mCursorArchetype < mArchetypeRefs.size())
+            mCursorID = mArchetypeRefs[mCursorArchetype]->getIdentifier();
+        ECS_PROFILE(mEngine.getProfiler().addEntitiesVisited(mName, mSliceVisited));
+        return mPassDone;
+    }
+
+    bool Processor::conflictsWith(const Processor& other) const
+    {
+        auto intersect = [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+        {
+            for (auto i = a.begin(), j = b.begin(); i != a.end() && j != b.end();)
+            {
+                if (*i == *j)
+                    return true;
+                if (*i < *j)
+                    ++i;
+                else
+                    ++j;
+            }
+            return false;
+        };
+        // Writes are also reads
+        return intersect(mWrites, other.mReads) || intersect(mReads, other.mWrites);
+    }
+
+    #ifdef ARCHETYPE_PROFILE
+    void Processor::setName(const char* name)
+    {
+        mName = name;
+    }
+
+    const char* Processor::getName() const
+    {
+        return mName;
+    }
+
+    Profiler& Processor::getProfiler()
+    {
+        return mEngine.getProfiler();
+    }
+    #endif
 }
@@ -0,0 +1,167 @@
+#include "../include/ECS/Profiler.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace ECS
+{
+    namespace
+    {
+        const char* counterName(ProfileCounter counter)
+        {
+            switch (counter)
+            {
+            case ProfileCounter::ArchetypeTransition: return "archetype_transition";
+            case ProfileCounter::FlushEmpty: return "flush_empty";
+            case ProfileCounter::ArchetypeCreated: return "archetype_created";
+            case ProfileCounter::ArchetypeRecycled: return "archetype_recycled";
+            case ProfileCounter::ArchetypeRemoved: return "archetype_removed";
+            default: return "unknown";
+            }
+        }
+
+        // Type names are written as JSON strings
+        void writeEscaped(std::ostream& os, const char* str)
+        {
+            os << '"';
+            for (; *str != '\0'; ++str)
+            {
+                if (*str == '"' || *str == '\\')
+                    os << '\\';
+                os << *str;
+            }
+            os << '"';
+        }
+
+        // Chrome trace timestamps are in microseconds
+        void writeMicroseconds(std::ostream& os, int64_t ns)
+        {
+            os << ns / 1000 << '.' << std::to_string(1000 + ns % 1000).substr(1);
+        }
+    }
+
+    Profiler::Profiler()
+    {
+        reset();
+    }
+
+    void Profiler::reset()
+    {
+        mOrigin = Clock::now();
+        mCounters.fill(0);
+        mProcessors.clear();
+        mEvents.clear();
+        mRuns = 0;
+    }
+
+    void Profiler::count(ProfileCounter counter, uint64_t amount)
+    {
+        ECS_ASSERT(counter < ProfileCounter::Count, "Invalid profile counter");
+        mCounters[(std::size_t)counter] += amount;
+    }
+
+    void Profiler::addEntitiesVisited(const char* name, std::size_t amount)
+    {
+        ProcessorStats& stats = mProcessors[name];
+        stats.name = name;
+        stats.entitiesVisited += amount;
+    }
+
+    void Profiler::addRun(const char* name, Clock::time_point start, Clock::time_point end, bool isProcessor)
+    {
+        int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(start - mOrigin).count();
+        Event event{ name, offset, duration };
+        if (mEvents.size() < MAX_TRACE_EVENTS)
+            mEvents.push_back(event);
+        else
+            mEvents[mRuns % MAX_TRACE_EVENTS] = event;
+        mRuns++;
+
+        if (isProcessor == false)
+            return;
+        ProcessorStats& stats = mProcessors[name];
+        stats.name = name;
+        stats.runs++;
+        stats.totalTime += duration;
+        stats.maxTime = std::max(stats.maxTime, (uint64_t)duration);
+    }
+
+    uint64_t Profiler::getCounter(ProfileCounter counter) const
+    {
+        ECS_ASSERT(counter < ProfileCounter::Count, "Invalid profile counter");
+        return mCounters[(std::size_t)counter];
+    }
+
+    const std::unordered_map<const char*, ProcessorStats>& Profiler::getProcessorStats() const
+    {
+        return mProcessors;
+    }
+
+    uint64_t Profiler::getRunCount() const
+    {
+        return mRuns;
+    }
+
+    void Profiler::writeChromeTrace(std::ostream& os, const std::vector<ArchetypeStats>& archetypes) const
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mOrigin).count();
+
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        // Oldest first, the ring starts at the next slot written once it is full
+        std::size_t oldest = mEvents.size() < MAX_TRACE_EVENTS ? 0 : mRuns % MAX_TRACE_EVENTS;
+        for (std::size_t i = 0; i < mEvents.size(); ++i)
+        {
+            const Event& e = mEvents[(oldest + i) % mEvents.size()];
+            os << (first ? "\n" : ",\n") << "{\"name\":";
+            writeEscaped(os, e.name);
+            os << ",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":";
+            writeMicroseconds(os, e.start);
+            os << ",\"dur\":";
+            writeMicroseconds(os, e.duration);
+            os << '}';
+            first = false;
+        }
+
+        // Counters and archetype sizes are sampled once at the time of writing
+        os << (first ? "\n" : ",\n") << "{\"name\":\"structural_changes\",\"ph\":\"C\",\"pid\":0,\"ts\":";
+        writeMicroseconds(os, now);
+        os << ",\"args\":{";
+        for (std::size_t i = 0; i < mCounters.size(); ++i)
+            os << (i == 0 ? "" : ",") << '"' << counterName((ProfileCounter)i) << "\":" << mCounters[i];
+        os << "}}";
+
+        os << ",\n{\"name\":\"archetype_bytes\",\"ph\":\"C\",\"pid\":0,\"ts\":";
+        writeMicroseconds(os, now);
+        os << ",\"args\":{";
+        for (std::size_t i = 0; i < archetypes.size(); ++i)
+            os << (i == 0 ? "" : ",") << "\"archetype_" << archetypes[i].index << "\":" << archetypes[i].bytes;
+        os << "}}";
+
+        os << ",\n{\"name\":\"processor_entities_visited\",\"ph\":\"C\",\"pid\":0,\"ts\":";
+        writeMicroseconds(os, now);
+        os << ",\"args\":{";
+        first = true;
+        for (const auto& pr : mProcessors)
+        {
+            os << (first ? "" : ",");
+            writeEscaped(os, pr.first);
+            os << ':' << pr.second.entitiesVisited;
+            first = false;
+        }
+        os << "}}\n]}\n";
+    }
+
+    ProfileScope::ProfileScope(Profiler& profiler, const char* name, bool isProcessor)
+        : mProfiler(profiler)
+        , mName(name)
+        , mIsProcessor(isProcessor)
+        , mStart(Profiler::Clock::now())
+    { }
+
+    ProfileScope::~ProfileScope()
+    {
+        mProfiler.addRun(mName, mStart, Profiler::Clock::now(), mIsProcessor);
+    }
+}
@@ -0,0 +1,309 @@
+#include "../include/ECS/RawComponent.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+
+namespace ECS
+{
+    std::size_t RawComponentInfo::getStride() const
+    {
+        return std::max<std::size_t>((size + alignment - 1) / alignment * alignment, 1);
+    }
+
+    bool RawComponentInfo::isTriviallyCopyable() const
+    {
+        return destruct == nullptr && move == nullptr && copy == nullptr;
+    }
+
+    const char* internComponentName(const std::string& name)
+    {
+        // Nodes of an unordered_set never move, so their strings' data stay valid
+        static std::mutex mutex;
+        static std::unordered_set<std::string> names;
+        std::lock_guard<std::mutex> lock(mutex);
+        return names.insert(name).first->c_str();
+    }
+
+    RawComponentVector::RawComponentVector(const char* name, const RawComponentInfo& info)
+        : mName(name)
+        , mInfo(info)
+        , mStride(info.getStride())
+        , mAlignment(std::max(info.alignment, COMPONENT_ALIGNMENT))
+        , mData(nullptr)
+        , mSize(0)
+        , mCapacity(0)
+    {
+        ECS_ASSERT(info.alignment > 0 && (info.alignment & (info.alignment - 1)) == 0, ((std::string)"Runtime component type " + name + " has alignment " + std::to_string(info.alignment) + ", not a power of 2"));
+        ECS_ASSERT(info.destruct == nullptr || info.move != nullptr, ((std::string)"Runtime component type " + name + " has a destructor but no move function"));
+    }
+
+    RawComponentVector::~RawComponentVector()
+    {
+        if (mInfo.destruct != nullptr)
+            for (std::size_t i = 0; i < mSize; ++i)
+                mInfo.destruct(at(i));
+        ::operator delete(mData, std::align_val_t(mAlignment));
+    }
+
+    std::shared_ptr<IComponentVector> RawComponentVector::createClone() const
+    {
+        return std::make_shared<RawComponentVector>(mName, mInfo);
+    }
+
+    void RawComponentVector::removeEntity(Entity entity)
+    {
+        if (haveData(entity))
+            removeData(entity);
+    }
+
+    void RawComponentVector::addDefaultData(Entity entity)
+    {
+        unsigned char* slot = pushSlot(entity);
+        if (mInfo.construct != nullptr)
+            mInfo.construct(slot);
+        else
+            std::memset(slot, 0, mStride);
+    }
+
+    void RawComponentVector::moveData(Entity entity, IComponentVector& newVec)
+    {
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT(found != mOutIn.end(), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + mName + " to transfer"));
+        unsigned char* src = at(found->second);
+        unsigned char* dst = static_cast<RawComponentVector&>(newVec).pushSlot(entity);
+        // The source is destroyed when it is removed
+        if (mInfo.move != nullptr)
+            mInfo.move(dst, src);
+        else
+            std::memcpy(dst, src, mStride);
+    }
+
+    void RawComponentVector::fillData(const Entity* entities, std::size_t count, const IComponentVector& source, Entity sourceEntity)
+    {
+        const auto& casted = static_cast<const RawComponentVector&>(source);
+        ECS_ASSERT(casted.haveData(sourceEntity), ((std::string)"No data of entity " + std::to_string(sourceEntity) + " in vector of type " + mName + " to copy"));
+        ECS_ASSERT(isCopyable(), ((std::string)"Runtime component type " + mName + " has no copy function but copied in bulk"));
+        if (isCopyable() == false)
+            return;
+        if (mSize + count > mCapacity)
+            reallocate(std::max(mSize + count, mCapacity * 2));
+        const unsigned char* value = casted.at(casted.mOutIn.at(sourceEntity));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            unsigned char* slot = pushSlot(entities[i]);
+            if (mInfo.copy != nullptr)
+                mInfo.copy(slot, value);
+            else
+                std::memcpy(slot, value, mStride);
+        }
+    }
+
+    const void* RawComponentVector::getRawData(Entity entity) const
+    {
+        auto found = mOutIn.find(entity);
+        return found == mOutIn.end() ? nullptr : at(found->second);
+    }
+
+    void RawComponentVector::appendFrom(IComponentVector& source, const std::vector<Entity>& remap)
+    {
+        auto& casted = static_cast<RawComponentVector&>(source);
+        if (mSize + casted.mSize > mCapacity)
+            reallocate(std::max(mSize + casted.mSize, mCapacity * 2));
+        mOutIn.reserve(mOutIn.size() + casted.mSize);
+        for (std::size_t i = 0; i < casted.mSize; ++i)
+        {
+            Entity entity = remap[casted.mInOut[i]];
+            ECS_ASSERT(haveData(entity) == false, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + mName));
+            relocate(pushSlot(entity), casted.at(i));
+        }
+        casted.mSize = 0;
+        casted.mInOut.clear();
+        casted.mOutIn.clear();
+    }
+
+    void RawComponentVector::setRowTable(const uint32_t*)
+    { }
+
+    void RawComponentVector::permute(const std::vector<uint32_t>& order)
+    {
+        ECS_ASSERT(order.size() == mSize, ((std::string)"Permutation of " + std::to_string(order.size()) + " elements applied to vector of type " + mName + " holding " + std::to_string(mSize)));
+        unsigned char* sorted = allocate(mCapacity);
+        std::vector<Entity> entities(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            relocate(sorted + i * mStride, at(order[i]));
+            entities[i] = mInOut[order[i]];
+        }
+        ::operator delete(mData, std::align_val_t(mAlignment));
+        mData = sorted;
+        mInOut.swap(entities);
+        // Only entities whose position changed need their mapping updated
+        for (std::size_t i = 0; i < order.size(); ++i)
+            if (order[i] != i)
+                mOutIn[mInOut[i]] = (Entity)i;
+    }
+
+    bool RawComponentVector::getRawColumn(const void*& data, std::size_t& elementSize) const
+    {
+        if (mInfo.isTriviallyCopyable() == false)
+            return false;
+        data = mData;
+        elementSize = mStride;
+        return true;
+    }
+
+    std::size_t RawComponentVector::getByteSize() const
+    {
+        // A map node holds the pair and a next pointer, buckets are one pointer each
+        constexpr std::size_t nodeSize = sizeof(std::pair<const Entity, Entity>) + sizeof(void*);
+        return (mCapacity * mStride + mAlignment - 1) / mAlignment * mAlignment
+            + mInOut.capacity() * sizeof(Entity)
+            + mOutIn.size() * nodeSize + mOutIn.bucket_count() * sizeof(void*);
+    }
+
+    std::size_t RawComponentVector::getWastedBytes() const
+    {
+        return (mCapacity - mSize) * mStride;
+    }
+
+    void RawComponentVector::shrinkToFit()
+    {
+        if (mCapacity != mSize)
+            reallocate(mSize);
+        mInOut.shrink_to_fit();
+        mOutIn.rehash(0);
+    }
+
+    void RawComponentVector::reserve(std::size_t capacity)
+    {
+        if (capacity > mCapacity)
+            reallocate(capacity);
+        mInOut.reserve(capacity);
+        mOutIn.reserve(capacity);
+    }
+
+    void RawComponentVector::assignRawColumn(const std::vector<Entity>& entities, const void* data)
+    {
+        ECS_ASSERT(mInfo.isTriviallyCopyable(), ((std::string)"Runtime component type " + mName + " is not trivially copyable but assigned raw bytes"));
+        mSize = 0;
+        mInOut.clear();
+        mOutIn.clear();
+        if (entities.empty())
+            return;
+        if (entities.size() > mCapacity)
+            reallocate(entities.size());
+        std::memcpy(mData, data, entities.size() * mStride);
+        mSize = entities.size();
+        mInOut = entities;
+        mOutIn.reserve(entities.size());
+        for (std::size_t i = 0; i < entities.size(); ++i)
+            mOutIn.emplace(entities[i], (Entity)i);
+    }
+
+    void RawComponentVector::markDirty(std::size_t, std::size_t)
+    { }
+
+    bool RawComponentVector::isCopyable() const
+    {
+        return mInfo.copy != nullptr || mInfo.destruct == nullptr;
+    }
+
+    bool RawComponentVector::isDefaultConstructible() const
+    {
+        return true;
+    }
+
+    void* RawComponentVector::operator [](Entity entity)
+    {
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT(found != mOutIn.end(), ((std::string)"No data of entity " + std::to_string(entity) + " in vector of type " + mName));
+        return at(found->second);
+    }
+
+    bool RawComponentVector::haveData(Entity entity) const
+    {
+        return mOutIn.find(entity) != mOutIn.end();
+    }
+
+    void RawComponentVector::removeData(Entity entity)
+    {
+        auto found = mOutIn.find(entity);
+        ECS_ASSERT(found != mOutIn.end(), ((std::string)"Data of entity " + std::to_string(entity) + " in vector of type " + mName + " not added yet but query removal"));
+        Entity rmIndex = found->second, last = (Entity)mSize - 1,
+               swappedEntity = mInOut[last];
+
+        if (mInfo.destruct != nullptr)
+            mInfo.destruct(at(rmIndex));
+        if (rmIndex != last)
+            relocate(at(rmIndex), at(last));
+        --mSize;
+
+        mOutIn[swappedEntity] = rmIndex;
+        mInOut[rmIndex] = swappedEntity;
+
+        mInOut.pop_back();
+        mOutIn.erase(entity);
+    }
+
+    void* RawComponentVector::data()
+    {
+        return mData;
+    }
+
+    std::size_t RawComponentVector::getSize() const
+    {
+        return mSize;
+    }
+
+    std::size_t RawComponentVector::getStride() const
+    {
+        return mStride;
+    }
+
+    unsigned char* RawComponentVector::at(std::size_t index) const
+    {
+        return mData + index * mStride;
+    }
+
+    unsigned char* RawComponentVector::pushSlot(Entity entity)
+    {
+        [[maybe_unused]] bool inserted = mOutIn.emplace(entity, (Entity)mSize).second;
+        ECS_ASSERT(inserted, ((std::string)"Data of entity " + std::to_string(entity) + " added twice in vector of type " + mName));
+        if (mSize == mCapacity)
+            reallocate(std::max<std::size_t>(mCapacity * 2, 8));
+        mInOut.push_back(entity);
+        return at(mSize++);
+    }
+
+    unsigned char* RawComponentVector::allocate(std::size_t capacity) const
+    {
+        // Padded like AlignedAllocator's blocks
+        std::size_t bytes = (capacity * mStride + mAlignment - 1) / mAlignment * mAlignment;
+        return bytes == 0 ? nullptr : static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(mAlignment)));
+    }
+
+    void RawComponentVector::relocate(unsigned char* dst, unsigned char* src) const
+    {
+        if (mInfo.move == nullptr)
+        {
+            std::memcpy(dst, src, mStride);
+            return;
+        }
+        mInfo.move(dst, src);
+        if (mInfo.destruct != nullptr)
+            mInfo.destruct(src);
+    }
+
+    void RawComponentVector::reallocate(std::size_t capacity)
+    {
+        unsigned char* data = allocate(capacity);
+        for (std::size_t i = 0; i < mSize; ++i)
+            relocate(data + i * mStride, at(i));
+        ::operator delete(mData, std::align_val_t(mAlignment));
+        mData = data;
+        mCapacity = capacity;
+    }
+}
@@ -4,73 +4,181 @@
 namespace ECS
 {
     Record::Record()
+        : mRowCount(0)
     {
-        for (auto& i : mTable)
-            i.reset();
-        for (uint32_t i = 0; i < MAX_ARCHETYPE; ++i)
-        {
-            mAvailableRow.push(i);
-            mRowList.set(i, false);
-        }
-    }
-
-    bool Record::isFull() const
-    {
-        return !mAvailableRow.empty();
+        ECS_PROFILE(mProfiler = nullptr);
     }
 
     uint32_t Record::addRow(const Identifier& ID)
     {
-        ECS_ASSERT(mAvailableRow.empty() == false, "Too much archetypes added to record");
-        auto res = mAvailableRow.top();
-        mAvailableRow.pop();
-        mRowList.set(res, true);
-        for (const auto& i : ID.getAllType())
+        auto res = takeRow();
+        for (const auto& i : ID)
         {
             ECS_ASSERT(i < MAX_COMPONENT_TYPE, ((std::string)"Out of bounds component ID: " + std::to_string(i)));
-            mTable[i].set(res, true);
+            setBit(getColumn(i), res, true);
         }
         return res;
     }
 
     uint32_t Record::addRow(const std::vector<ComponentType>& cs)
     {
-        ECS_ASSERT(mAvailableRow.empty() == false, "Too much archetypes added to record");
-        auto res = mAvailableRow.top();
-        mAvailableRow.pop();
-        mRowList.set(res, true);
+        auto res = takeRow();
         for (const auto& i : cs)
         {
             ECS_ASSERT(i < MAX_COMPONENT_TYPE, ((std::string)"Out of bounds component ID: " + std::to_string(i)));
-            mTable[i].set(res, true);
+            setBit(getColumn(i), res, true);
         }
         return res;
     }
 
     void Record::removeRow(uint32_t row, const Identifier& ID)
     {
-        ECS_ASSERT(row < MAX_ARCHETYPE, ((std::string)"Invalid row index of table: " + std::to_string(row)));
-        ECS_ASSERT(mRowList.test(row), ((std::string)"Row not added yet: " + std::to_string(row)));
-        mAvailableRow.push(row);
-        mRowList.set(row, false);
-        for (const auto& i : ID.getAllType())
+        ECS_ASSERT(row < mRowCount, ((std::string)"Invalid row index of table: " + std::to_string(row)));
+        ECS_ASSERT(haveRow(row), ((std::string)"Row not added yet: " + std::to_string(row)));
+        mAvailableRow.push_back(row);
+        setBit(mRowList, row, false);
+        #ifdef ARCHETYPE_PROFILE
+        if (mProfiler != nullptr)
+            mProfiler->count(ProfileCounter::ArchetypeRemoved);
+        #endif
+        for (const auto& i : ID)
         {
-            ECS_ASSERT(i < MAX_COMPONENT_TYPE, ((std::string)"Out of bounds component ID: " + std::to_string(i)));
-            mTable[i].set(row, false);
+            ECS_ASSERT(i < mTable.size(), ((std::string)"Out of bounds component ID: " + std::to_string(i)));
+            setBit(mTable[i], row, false);
         }
     }
 
-    std::vector<uint32_t> Record::getIntersection(const std::unordered_set<ComponentType>& cs) const
+    bool Record::haveRow(uint32_t row) const
     {
-        return allSetBit<MAX_ARCHETYPE>(getAndBitset(cs));
+        return testBit(mRowList, row);
     }
 
-    std::bitset<MAX_ARCHETYPE> Record::getAndBitset(const std::unordered_set<ComponentType>& cs) const
+    std::vector<uint32_t> Record::getIntersection(const Identifier& ID) const
     {
-        std::bitset<MAX_ARCHETYPE> bs;
-        bs.set();
-        for (const auto& i : cs)
-            bs &= mTable[i];
+        return allSetBit(getAndBitset(ID));
+    }
+
+    std::vector<uint32_t> Record::getIntersection(const Identifier& ID, const Identifier& excluded) const
+    {
+        Bits bs = getAndBitset(ID);
+        for (const auto& i : excluded)
+        {
+            if (i >= mTable.size())
+                continue;
+            const Bits& column = mTable[i];
+            for (std::size_t w = 0; w < bs.size() && w < column.size(); ++w)
+                bs[w] &= ~column[w];
+        }
+        return allSetBit(bs);
+    }
+
+    uint32_t Record::getRowCount() const
+    {
+        return mRowCount;
+    }
+
+    uint32_t Record::getFreeRowCount() const
+    {
+        return (uint32_t)mAvailableRow.size();
+    }
+
+    std::size_t Record::getByteSize() const
+    {
+        std::size_t res = mTable.capacity() * sizeof(Bits) + mAvailableRow.capacity() * sizeof(uint32_t)
+            + mRowList.capacity() * sizeof(uint64_t);
+        for (const auto& column : mTable)
+            res += column.capacity() * sizeof(uint64_t);
+        return res;
+    }
+
+    #ifdef ARCHETYPE_PROFILE
+    void Record::setProfiler(Profiler* profiler)
+    {
+        mProfiler = profiler;
+    }
+    #endif
+
+    uint32_t Record::takeRow()
+    {
+        uint32_t res;
+        if (mAvailableRow.empty())
+            res = mRowCount++;
+        else
+        {
+            res = mAvailableRow.back();
+            mAvailableRow.pop_back();
+        }
+        setBit(mRowList, res, true);
+        #ifdef ARCHETYPE_PROFILE
+        if (mProfiler != nullptr)
+            mProfiler->count(testBit(mUsedRow, res) ? ProfileCounter::ArchetypeRecycled : ProfileCounter::ArchetypeCreated);
+        setBit(mUsedRow, res, true);
+        #endif
+        return res;
+    }
+
+    Record::Bits Record::getAndBitset(const Identifier& ID) const
+    {
+        // Free rows never match, even for an empty identifier
+        Bits bs = mRowList;
+        for (const auto& i : ID)
+        {
+            if (i >= mTable.size())
+                return Bits();
+            const Bits& column = mTable[i];
+            if (column.size() < bs.size())
+                bs.resize(column.size());
+            for (std::size_t w = 0; w < bs.size(); ++w)
+                bs[w] &= column[w];
+        }
         return bs;
     }
+
+    Record::Bits& Record::getColumn(ComponentType c)
+    {
+        if (c >= mTable.size())
+            mTable.resize((std::size_t)c + 1);
+        return mTable[c];
+    }
+
+    void Record::setBit(Bits& bits, uint32_t i, bool value)
+    {
+        if (i / 64 >= bits.size())
+        {
+            if (value == false)
+                return;
+            bits.resize(i / 64 + 1, 0);
+        }
+        if (value)
+            bits[i / 64] |= (uint64_t)1 << (i % 64);
+        else
+            bits[i / 64] &= ~((uint64_t)1 << (i % 64));
+    }
+
+    bool Record::testBit(const Bits& bits, uint32_t i)
+    {
+        return i / 64 < bits.size() && (bits[i / 64] >> (i % 64) & 1) != 0;
+    }
+
+    std::vector<uint32_t> Record::allSetBit(const Bits& bits)
+    {
+        std::vector<uint32_t> res;
+        for (std::size_t w = 0; w < bits.size(); ++w)
+        {
+            uint64_t word = bits[w];
+            while (word != 0)
+            {
+                #ifdef __GNUC__
+                uint32_t bit = (uint32_t)__builtin_ctzll(word);
+                #else
+                uint32_t bit = 0;
+                while ((word >> bit & 1) == 0)
+                    ++bit;
+                #endif // __GNUC__
+                res.push_back((uint32_t)(w * 64 + bit));
+                word &= word - 1;
+            }
+        }
+        return res;
+    }
 }
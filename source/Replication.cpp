@@ -0,0 +1,498 @@
+#include "../include/ECS/Replication.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace ECS
+{
+    namespace
+    {
+        // Bits per group of a variable length integer, each group is followed by a continuation bit
+        constexpr uint32_t VARINT_GROUP = 4;
+        constexpr uint32_t NO_ROW = UINT32_MAX;
+
+        const ReplicationSnapshot::Column EMPTY_COLUMN;
+
+        // Appends values of up to 32 bits to a byte vector, least significant bit first
+        class BitWriter
+        {
+        public:
+            explicit BitWriter(std::vector<uint8_t>& out)
+                : mOut(out)
+                , mAccumulator(0)
+                , mBits(0)
+            { }
+
+            void write(uint32_t value, uint32_t bits)
+            {
+                mAccumulator |= (uint64_t)value << mBits;
+                mBits += bits;
+                while (mBits >= 8)
+                {
+                    mOut.push_back((uint8_t)mAccumulator);
+                    mAccumulator >>= 8;
+                    mBits -= 8;
+                }
+            }
+
+            void writeVarint(uint32_t value)
+            {
+                do
+                {
+                    uint32_t group = value & ((1u << VARINT_GROUP) - 1);
+                    value >>= VARINT_GROUP;
+                    write(group | (value != 0 ? 1u << VARINT_GROUP : 0), VARINT_GROUP + 1);
+                } while (value != 0);
+            }
+
+            // Write the last incomplete byte
+            void finish()
+            {
+                if (mBits > 0)
+                    mOut.push_back((uint8_t)mAccumulator);
+                mAccumulator = 0;
+                mBits = 0;
+            }
+        private:
+            std::vector<uint8_t>& mOut;
+            uint64_t mAccumulator;
+            uint32_t mBits;
+        };
+
+        // Reads what BitWriter wrote, every read fails once the data is exhausted
+        class BitReader
+        {
+        public:
+            BitReader(const uint8_t* data, std::size_t size)
+                : mData(data)
+                , mSize(size)
+                , mPos(0)
+                , mAccumulator(0)
+                , mBits(0)
+            { }
+
+            bool read(uint32_t bits, uint32_t& value)
+            {
+                while (mBits < bits)
+                {
+                    if (mPos == mSize)
+                        return false;
+                    mAccumulator |= (uint64_t)mData[mPos++] << mBits;
+                    mBits += 8;
+                }
+                value = (uint32_t)(mAccumulator & ((1ull << bits) - 1));
+                mAccumulator >>= bits;
+                mBits -= bits;
+                return true;
+            }
+
+            bool readVarint(uint32_t& value)
+            {
+                value = 0;
+                for (uint32_t shift = 0; shift < 32; shift += VARINT_GROUP)
+                {
+                    uint32_t group;
+                    if (read(VARINT_GROUP + 1, group) == false)
+                        return false;
+                    value |= (group & ((1u << VARINT_GROUP) - 1)) << shift;
+                    if ((group >> VARINT_GROUP) == 0)
+                        return true;
+                }
+                return false;
+            }
+        private:
+            const uint8_t* mData;
+            std::size_t mSize;
+            std::size_t mPos;
+            uint64_t mAccumulator;
+            uint32_t mBits;
+        };
+
+        uint32_t getWordCount(uint32_t size)
+        {
+            return (size + 3) / 4;
+        }
+
+        // Bytes of value in [4 * word, 4 * word + 4), zero-padded past size
+        uint32_t loadWord(const uint8_t* value, uint32_t size, uint32_t word)
+        {
+            uint32_t res = 0;
+            std::memcpy(&res, value + 4 * word, std::min<uint32_t>(4, size - 4 * word));
+            return res;
+        }
+
+        void storeWord(uint8_t* value, uint32_t size, uint32_t word, uint32_t bits)
+        {
+            std::memcpy(value + 4 * word, &bits, std::min<uint32_t>(4, size - 4 * word));
+        }
+
+        // Entities are written as the gap from the one after the previous entity
+        void writeEntity(BitWriter& writer, Entity entity, Entity& next)
+        {
+            writer.writeVarint(entity - next);
+            next = entity + 1;
+        }
+
+        bool readEntity(BitReader& reader, Entity& entity, Entity& next)
+        {
+            uint32_t gap;
+            if (reader.readVarint(gap) == false || gap >= MAX_ENTITY || next + gap >= MAX_ENTITY)
+                return false;
+            entity = next + gap;
+            next = entity + 1;
+            return true;
+        }
+
+        // Removed entities, then entities added or changed with their new words
+        void writeDelta(BitWriter& writer, const ReplicationSnapshot::Column& base, const ReplicationSnapshot::Column& current, uint32_t size)
+        {
+            constexpr std::size_t BLOCK_SIZE = Replicator::BLOCK_SIZE;
+            std::size_t baseSize = base.entities.size();
+            std::size_t currentSize = current.entities.size();
+
+            std::vector<Entity> removed;
+            // (row in current, row in base or NO_ROW)
+            std::vector<std::pair<uint32_t, uint32_t>> changed;
+            std::size_t i = 0, j = 0, blockEnd = 0;
+            while (i < baseSize || j < currentSize)
+            {
+                // Blocks holding the same entities and values are skipped at once
+                if (j >= blockEnd)
+                {
+                    if (i + BLOCK_SIZE <= baseSize && j + BLOCK_SIZE <= currentSize
+                        && std::memcmp(&base.entities[i], &current.entities[j], BLOCK_SIZE * sizeof(Entity)) == 0
+                        && std::memcmp(&base.values[i * size], &current.values[j * size], BLOCK_SIZE * size) == 0)
+                    {
+                        i += BLOCK_SIZE;
+                        j += BLOCK_SIZE;
+                        blockEnd = j;
+                        continue;
+                    }
+                    blockEnd = j + BLOCK_SIZE;
+                }
+                Entity b = i < baseSize ? base.entities[i] : NULL_ENTITY;
+                Entity c = j < currentSize ? current.entities[j] : NULL_ENTITY;
+                if (b < c)
+                {
+                    removed.push_back(b);
+                    ++i;
+                }
+                else if (c < b)
+                {
+                    changed.emplace_back((uint32_t)j, NO_ROW);
+                    ++j;
+                }
+                else
+                {
+                    if (std::memcmp(&base.values[i * size], &current.values[j * size], size) != 0)
+                        changed.emplace_back((uint32_t)j, (uint32_t)i);
+                    ++i;
+                    ++j;
+                }
+            }
+
+            Entity next = 0;
+            writer.writeVarint((uint32_t)removed.size());
+            for (Entity entity : removed)
+                writeEntity(writer, entity, next);
+
+            uint32_t words = getWordCount(size);
+            next = 0;
+            writer.writeVarint((uint32_t)changed.size());
+            for (const auto& pr : changed)
+            {
+                const uint8_t* value = &current.values[pr.first * size];
+                writeEntity(writer, current.entities[pr.first], next);
+                writer.write(pr.second == NO_ROW ? 1 : 0, 1);
+                if (pr.second == NO_ROW)
+                {
+                    for (uint32_t w = 0; w < words; ++w)
+                        writer.write(loadWord(value, size, w), 32);
+                    continue;
+                }
+                const uint8_t* old = &base.values[pr.second * size];
+                for (uint32_t w = 0; w < words; ++w)
+                    writer.write(loadWord(value, size, w) != loadWord(old, size, w) ? 1 : 0, 1);
+                for (uint32_t w = 0; w < words; ++w)
+                {
+                    uint32_t word = loadWord(value, size, w);
+                    if (word != loadWord(old, size, w))
+                        writer.write(word, 32);
+                }
+            }
+        }
+
+        // Build column from base and what writeDelta() wrote
+        bool readDelta(BitReader& reader, const ReplicationSnapshot::Column& base, uint32_t size, ReplicationSnapshot::Column& column)
+        {
+            uint32_t count;
+            Entity next = 0;
+            if (reader.readVarint(count) == false || count > MAX_ENTITY)
+                return false;
+            std::vector<Entity> removed(count);
+            for (Entity& entity : removed)
+                if (readEntity(reader, entity, next) == false)
+                    return false;
+
+            // Words of every changed entity and whether each of them was sent
+            uint32_t words = getWordCount(size);
+            next = 0;
+            if (reader.readVarint(count) == false || count > MAX_ENTITY)
+                return false;
+            std::vector<Entity> changed(count);
+            std::vector<uint8_t> isNew(count), sent((std::size_t)count * words, 1);
+            std::vector<uint32_t> values((std::size_t)count * words);
+            for (uint32_t k = 0; k < count; ++k)
+            {
+                uint32_t flag;
+                if (readEntity(reader, changed[k], next) == false || reader.read(1, flag) == false)
+                    return false;
+                isNew[k] = (uint8_t)flag;
+                uint8_t* mask = &sent[(std::size_t)k * words];
+                for (uint32_t w = 0; w < words && flag == 0; ++w)
+                {
+                    uint32_t bit;
+                    if (reader.read(1, bit) == false)
+                        return false;
+                    mask[w] = (uint8_t)bit;
+                }
+                for (uint32_t w = 0; w < words; ++w)
+                    if (mask[w] && reader.read(32, values[(std::size_t)k * words + w]) == false)
+                        return false;
+            }
+
+            // Merge base, less removed entities, with the changed ones
+            std::size_t baseSize = base.entities.size();
+            column.entities.clear();
+            column.values.clear();
+            column.entities.reserve(baseSize + count);
+            column.values.reserve((baseSize + count) * size);
+            std::size_t i = 0, k = 0, r = 0;
+            while (i < baseSize || k < count)
+            {
+                Entity b = i < baseSize ? base.entities[i] : NULL_ENTITY;
+                Entity c = k < count ? changed[k] : NULL_ENTITY;
+                if (b < c)
+                {
+                    while (r < removed.size() && removed[r] < b)
+                        ++r;
+                    if (r == removed.size() || removed[r] != b)
+                    {
+                        column.entities.push_back(b);
+                        column.values.insert(column.values.end(), &base.values[i * size], &base.values[i * size] + size);
+                    }
+                    ++i;
+                    continue;
+                }
+                // Only new entities may be missing from base
+                if (c < b && isNew[k] == 0)
+                    return false;
+                column.entities.push_back(c);
+                column.values.resize(column.values.size() + size);
+                uint8_t* value = column.values.data() + column.values.size() - size;
+                if (c == b)
+                {
+                    std::memcpy(value, &base.values[i * size], size);
+                    ++i;
+                }
+                for (uint32_t w = 0; w < words; ++w)
+                    if (sent[k * words + w])
+                        storeWord(value, size, w, values[k * words + w]);
+                ++k;
+            }
+            return true;
+        }
+    }
+
+    Replicator::Replicator(Engine& engine)
+        : mEngine(engine)
+    { }
+
+    ReplicationServer::ReplicationServer(Engine& engine)
+        : Replicator(engine)
+        , mSequence(REPLICATION_NO_SEQUENCE)
+    { }
+
+    uint32_t ReplicationServer::addClient()
+    {
+        mBaselines.push_back(nullptr);
+        return (uint32_t)mBaselines.size() - 1;
+    }
+
+    uint32_t ReplicationServer::capture()
+    {
+        std::shared_ptr<ReplicationSnapshot> snapshot;
+        if (mHistory.size() == REPLICATION_HISTORY)
+        {
+            if (mHistory.front().use_count() == 1)
+                snapshot = std::move(mHistory.front());
+            mHistory.pop_front();
+        }
+        if (snapshot == nullptr)
+            snapshot = std::make_shared<ReplicationSnapshot>();
+        snapshot->sequence = ++mSequence;
+        snapshot->columns.resize(mTypes.size());
+        for (std::size_t t = 0; t < mTypes.size(); ++t)
+            mTypes[t].capture(mEngine, snapshot->columns[t]);
+        mHistory.push_back(std::move(snapshot));
+        return mSequence;
+    }
+
+    void ReplicationServer::encode(uint32_t client, std::vector<uint8_t>& out) const
+    {
+        ECS_ASSERT(client < mBaselines.size(), ((std::string)"Replication client " + std::to_string(client) + " does not exist"));
+        ECS_ASSERT(mHistory.empty() == false, "Replication message encoded before any capture");
+
+        // Baselines older than the history may have been dropped by the client
+        const ReplicationSnapshot& current = *mHistory.back();
+        const ReplicationSnapshot* base = mBaselines[client].get();
+        if (base != nullptr && current.sequence - base->sequence >= REPLICATION_HISTORY)
+            base = nullptr;
+
+        out.clear();
+        BitWriter writer(out);
+        writer.write(current.sequence, 32);
+        writer.write(base != nullptr ? base->sequence : REPLICATION_NO_SEQUENCE, 32);
+        writer.writeVarint((uint32_t)mTypes.size());
+        for (const auto& type : mTypes)
+            writer.writeVarint(type.size);
+        for (std::size_t t = 0; t < mTypes.size(); ++t)
+            writeDelta(writer, base != nullptr ? base->columns[t] : EMPTY_COLUMN, current.columns[t], mTypes[t].size);
+        writer.finish();
+    }
+
+    void ReplicationServer::acknowledge(uint32_t client, uint32_t sequence)
+    {
+        ECS_ASSERT(client < mBaselines.size(), ((std::string)"Replication client " + std::to_string(client) + " does not exist"));
+        auto snapshot = findSnapshot(sequence);
+        auto& baseline = mBaselines[client];
+        if (snapshot != nullptr && (baseline == nullptr || snapshot->sequence > baseline->sequence))
+            baseline = std::move(snapshot);
+    }
+
+    std::shared_ptr<const ReplicationSnapshot> ReplicationServer::findSnapshot(uint32_t sequence) const
+    {
+        for (const auto& snapshot : mHistory)
+            if (snapshot->sequence == sequence)
+                return snapshot;
+        return nullptr;
+    }
+
+    ReplicationClient::ReplicationClient(Engine& engine)
+        : Replicator(engine)
+    { }
+
+    bool ReplicationClient::apply(const uint8_t* data, std::size_t size)
+    {
+        auto snapshot = std::make_shared<ReplicationSnapshot>();
+        uint32_t baseline;
+        if (decode(data, size, *snapshot, baseline) == false)
+            return false;
+        if (mApplied == nullptr || snapshot->sequence > mApplied->sequence)
+        {
+            sync(*snapshot);
+            mApplied = snapshot;
+        }
+        mHistory.push_back(std::move(snapshot));
+        if (mHistory.size() > REPLICATION_HISTORY)
+            mHistory.pop_front();
+        return true;
+    }
+
+    uint32_t ReplicationClient::getSequence() const
+    {
+        return mApplied != nullptr ? mApplied->sequence : REPLICATION_NO_SEQUENCE;
+    }
+
+    Entity ReplicationClient::getEntity(Entity serverEntity) const
+    {
+        auto found = mEntities.find(serverEntity);
+        return found == mEntities.end() ? NULL_ENTITY : found->second;
+    }
+
+    bool ReplicationClient::decode(const uint8_t* data, std::size_t size, ReplicationSnapshot& snapshot, uint32_t& baseline) const
+    {
+        BitReader reader(data, size);
+        uint32_t typeCount;
+        if (reader.read(32, snapshot.sequence) == false || snapshot.sequence == REPLICATION_NO_SEQUENCE
+            || reader.read(32, baseline) == false || reader.readVarint(typeCount) == false || typeCount != mTypes.size())
+            return false;
+        for (const auto& type : mTypes)
+        {
+            uint32_t typeSize;
+            if (reader.readVarint(typeSize) == false || typeSize != type.size)
+                return false;
+        }
+
+        const ReplicationSnapshot* base = nullptr;
+        if (baseline != REPLICATION_NO_SEQUENCE)
+        {
+            for (const auto& s : mHistory)
+                if (s->sequence == baseline)
+                    base = s.get();
+            if (base == nullptr)
+                return false;
+        }
+
+        snapshot.columns.resize(mTypes.size());
+        for (std::size_t t = 0; t < mTypes.size(); ++t)
+            if (readDelta(reader, base != nullptr ? base->columns[t] : EMPTY_COLUMN, mTypes[t].size, snapshot.columns[t]) == false)
+                return false;
+        return true;
+    }
+
+    void ReplicationClient::sync(const ReplicationSnapshot& snapshot)
+    {
+        // Server entities that lost a type, destroyed if they have none left
+        std::vector<Entity> lost;
+        for (std::size_t t = 0; t < mTypes.size(); ++t)
+        {
+            const Type& type = mTypes[t];
+            const auto& old = mApplied != nullptr ? mApplied->columns[t] : EMPTY_COLUMN;
+            const auto& current = snapshot.columns[t];
+            std::size_t i = 0, j = 0;
+            while (i < old.entities.size() || j < current.entities.size())
+            {
+                Entity o = i < old.entities.size() ? old.entities[i] : NULL_ENTITY;
+                Entity c = j < current.entities.size() ? current.entities[j] : NULL_ENTITY;
+                if (o < c)
+                {
+                    type.remove(mEngine, mEntities.at(o));
+                    lost.push_back(o);
+                    ++i;
+                    continue;
+                }
+                const uint8_t* value = &current.values[j * type.size];
+                if (c < o)
+                {
+                    auto found = mEntities.find(c);
+                    if (found == mEntities.end())
+                        found = mEntities.emplace(c, mEngine.createEntity()).first;
+                    type.write(mEngine, found->second, value);
+                }
+                else
+                {
+                    if (std::memcmp(&old.values[i * type.size], value, type.size) != 0)
+                        type.write(mEngine, mEntities.at(c), value);
+                    ++i;
+                }
+                ++j;
+            }
+        }
+
+        for (Entity entity : lost)
+        {
+            auto found = mEntities.find(entity);
+            if (found == mEntities.end())
+                continue;
+            bool replicated = false;
+            for (const auto& column : snapshot.columns)
+                replicated = replicated || std::binary_search(column.entities.begin(), column.entities.end(), entity);
+            if (replicated == false)
+            {
+                mEngine.destroyEntity(found->second);
+                mEntities.erase(found);
+            }
+        }
+    }
+}
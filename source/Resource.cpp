@@ -0,0 +1,15 @@
+#include "../include/ECS/Resource.hpp"
+
+#include <atomic>
+
+namespace ECS
+{
+    ResourceManager::ResourceManager()
+    { }
+
+    uint32_t ResourceManager::nextTypeIndex()
+    {
+        static std::atomic<uint32_t> next(0);
+        return next++;
+    }
+}
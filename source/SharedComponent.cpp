@@ -0,0 +1,10 @@
+#include "../include/ECS/SharedComponent.hpp"
+
+namespace ECS
+{
+    ISharedPool::ISharedPool()
+    { }
+
+    ISharedPool::~ISharedPool()
+    { }
+}